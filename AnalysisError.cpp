@@ -0,0 +1,120 @@
+/*
+  @file AnalysisError.cpp
+
+  Implementation of errors of invalid analysis requests and their diagnostics
+*/
+
+#include "AnalysisError.hpp"
+
+/**
+ * Diagnostic message of an error
+ *
+ * @param error Error of a request
+ * @retval Message, e.g., "Extension not supported"
+ * @retval Empty for AnalysisError::NONE
+ */
+std::string_view analysisErrorMessage(AnalysisError error) {
+
+    switch (error) {
+    case AnalysisError::STDIN_LANGUAGE:
+        return "Using stdin requires a declared language";
+    case AnalysisError::EXTENSION:
+        return "Extension not supported";
+    case AnalysisError::STREAMING_METADATA:
+        return "Streaming input requires a provided hash and LOC";
+    case AnalysisError::UTF8:
+        return "Content is not valid UTF-8";
+    case AnalysisError::UNREADABLE:
+        return "File cannot be read";
+    default:
+        return std::string_view();
+    }
+}
+
+/**
+ * Add the diagnostic of an invalid request
+ *
+ * @param error Error of the request
+ * @param source Filename of the request, empty for none
+ */
+void DiagnosticLog::add(AnalysisError error, std::string_view source) {
+
+    add(error, source, analysisErrorMessage(error));
+}
+
+/**
+ * Add a diagnostic with its own message, e.g., of a failed read
+ *
+ * @param error Error of the request
+ * @param source Filename of the request, empty for none
+ * @param message Message of the diagnostic
+ */
+void DiagnosticLog::add(AnalysisError error, std::string_view source, std::string_view message) {
+
+    Diagnostic diagnostic{ error, std::string(source), std::string(message) };
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.push_back(std::move(diagnostic));
+    ++counts[static_cast<std::size_t>(error)];
+}
+
+/** Number of diagnostics */
+std::size_t DiagnosticLog::size() const {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return entries.size();
+}
+
+/**
+ * Number of diagnostics for an error
+ *
+ * @param error Error of the requests
+ */
+std::size_t DiagnosticLog::count(AnalysisError error) const {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return counts[static_cast<std::size_t>(error)];
+}
+
+/** Copy of the diagnostics, in the order they were added */
+std::vector<DiagnosticLog::Diagnostic> DiagnosticLog::diagnostics() const {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return entries;
+}
+
+/**
+ * Write each diagnostic as a line, "source: message", in a single write
+ *
+ * @param out Destination of the diagnostics, e.g., std::cerr
+ */
+void DiagnosticLog::report(std::ostream& out) const {
+
+    std::string text;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& diagnostic : entries) {
+            if (!diagnostic.source.empty()) {
+                text += diagnostic.source;
+                text += ": ";
+            }
+            text += diagnostic.message;
+            text += '\n';
+        }
+    }
+
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    out.flush();
+}
+
+/** Remove all diagnostics */
+void DiagnosticLog::clear() {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    for (auto& count : counts)
+        count = 0;
+}
@@ -0,0 +1,152 @@
+/*
+  @file AnalysisError.hpp
+
+  Errors of invalid analysis requests, results that carry them, and
+  collection of diagnostics for reporting once a batch is complete
+*/
+
+#ifndef INCLUDED_ANALYSISERROR_HPP
+#define INCLUDED_ANALYSISERROR_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/** Reason a request does not form a unit */
+enum class AnalysisError {
+    NONE,               // valid request
+    STDIN_LANGUAGE,     // stdin without a declared language
+    EXTENSION,          // language cannot be determined from the extension
+    STREAMING_METADATA, // streamed content with a computed hash or LOC
+    UTF8,               // content is not valid UTF-8
+    UNREADABLE,         // source file cannot be read
+    COUNT
+};
+
+/**
+ * Diagnostic message of an error
+ *
+ * @param error Error of a request
+ * @retval Message, e.g., "Extension not supported"
+ * @retval Empty for AnalysisError::NONE
+ */
+std::string_view analysisErrorMessage(AnalysisError error);
+
+/**
+ * Value of a request, or the error that prevented it
+ *
+ * Errors are returned, not thrown or reported, so callers decide how and
+ * when to report them.
+ */
+template<typename T>
+class AnalysisResult {
+public:
+
+    /**
+     * @param value Value of a valid request
+     */
+    AnalysisResult(T value) : result(std::move(value)) {}
+
+    /**
+     * @param error Error of an invalid request, not AnalysisError::NONE
+     */
+    AnalysisResult(AnalysisError error) : failure(error) {}
+
+    /** Whether the request was valid */
+    bool has_value() const { return failure == AnalysisError::NONE; }
+
+    explicit operator bool() const { return has_value(); }
+
+    /**
+     * Value of the request
+     *
+     * @pre has_value()
+     */
+    T& value() & { return result; }
+    const T& value() const& { return result; }
+    T&& value() && { return std::move(result); }
+
+    T& operator*() & { return result; }
+    const T& operator*() const& { return result; }
+
+    /** Error of the request, AnalysisError::NONE when valid */
+    AnalysisError error() const { return failure; }
+
+    /** Diagnostic message of the error, empty when valid */
+    std::string_view message() const { return analysisErrorMessage(failure); }
+
+private:
+    T result{};
+    AnalysisError failure = AnalysisError::NONE;
+};
+
+/**
+ * Diagnostics collected from the threads of a batch, reported once
+ * the batch is complete instead of as each request fails
+ *
+ * All methods may be called from multiple threads.
+ */
+class DiagnosticLog {
+public:
+
+    /** Diagnostic of a single request */
+    struct Diagnostic {
+        AnalysisError error;
+        std::string source;     // filename of the request, empty for none
+        std::string message;
+    };
+
+    /**
+     * Add the diagnostic of an invalid request
+     *
+     * @param error Error of the request
+     * @param source Filename of the request, empty for none
+     */
+    void add(AnalysisError error, std::string_view source);
+
+    /**
+     * Add a diagnostic with its own message, e.g., of a failed read
+     *
+     * @param error Error of the request
+     * @param source Filename of the request, empty for none
+     * @param message Message of the diagnostic
+     */
+    void add(AnalysisError error, std::string_view source, std::string_view message);
+
+    /** Number of diagnostics */
+    std::size_t size() const;
+
+    /** Whether there are no diagnostics */
+    bool empty() const { return size() == 0; }
+
+    /**
+     * Number of diagnostics for an error
+     *
+     * @param error Error of the requests
+     */
+    std::size_t count(AnalysisError error) const;
+
+    /** Copy of the diagnostics, in the order they were added */
+    std::vector<Diagnostic> diagnostics() const;
+
+    /**
+     * Write each diagnostic as a line, "source: message", in a single write
+     *
+     * @param out Destination of the diagnostics, e.g., std::cerr
+     */
+    void report(std::ostream& out) const;
+
+    /** Remove all diagnostics */
+    void clear();
+
+private:
+    mutable std::mutex mutex;
+    std::vector<Diagnostic> entries;
+    std::size_t counts[static_cast<std::size_t>(AnalysisError::COUNT)] = {};
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+  @file AnalysisErrorTest.cpp
+
+  Test program for analysis errors and diagnostics
+*/
+
+#include "AnalysisError.hpp"
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cassert>
+
+int main() {
+
+    // results carry a value or an error
+    {
+        const AnalysisResult<std::string> valid(std::string("<unit/>"));
+        assert(valid && valid.has_value());
+        assert(valid.value() == "<unit/>");
+        assert(valid.error() == AnalysisError::NONE);
+        assert(valid.message().empty());
+
+        AnalysisResult<std::string> invalid(AnalysisError::EXTENSION);
+        assert(!invalid && !invalid.has_value());
+        assert(invalid.error() == AnalysisError::EXTENSION);
+        assert(invalid.message() == "Extension not supported");
+
+        AnalysisResult<std::string> moved(std::string(100, 'x'));
+        const std::string value = std::move(moved).value();
+        assert(value == std::string(100, 'x'));
+    }
+
+    // messages
+    {
+        assert(analysisErrorMessage(AnalysisError::NONE).empty());
+        assert(analysisErrorMessage(AnalysisError::STDIN_LANGUAGE) == "Using stdin requires a declared language");
+        assert(analysisErrorMessage(AnalysisError::UTF8) == "Content is not valid UTF-8");
+    }
+
+    // diagnostics are counted, and reported in the order added
+    {
+        DiagnosticLog log;
+        assert(log.empty());
+        log.add(AnalysisError::EXTENSION, "README.md");
+        log.add(AnalysisError::UTF8, "");
+        log.add(AnalysisError::UNREADABLE, "", "missing.cpp: No such file or directory");
+        assert(log.size() == 3);
+        assert(log.count(AnalysisError::EXTENSION) == 1);
+        assert(log.count(AnalysisError::STDIN_LANGUAGE) == 0);
+        assert(log.diagnostics()[0].source == "README.md");
+
+        std::ostringstream out;
+        log.report(out);
+        assert(out.str() == "README.md: Extension not supported\n"
+                            "Content is not valid UTF-8\n"
+                            "missing.cpp: No such file or directory\n");
+
+        log.clear();
+        assert(log.empty() && log.count(AnalysisError::EXTENSION) == 0);
+    }
+
+    // diagnostics from multiple threads
+    {
+        DiagnosticLog log;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i)
+            threads.emplace_back([&log]{
+                for (int j = 0; j < 1000; ++j)
+                    log.add(AnalysisError::EXTENSION, "a.txt");
+            });
+        for (auto& thread : threads)
+            thread.join();
+        assert(log.count(AnalysisError::EXTENSION) == 4000);
+    }
+
+    return 0;
+}
@@ -0,0 +1,487 @@
+/*
+  @file AnalysisPipeline.cpp
+
+  Implementation of the pipeline of threads that read, analyze, and write source files
+*/
+
+#include "AnalysisPipeline.hpp"
+#include "BinaryUnits.hpp"
+#include "BoundedQueue.hpp"
+#include "CodeAnalysis.hpp"
+#include "DirectoryWalker.hpp"
+#include "FilenameToLanguage.hpp"
+#include "ResultCache.hpp"
+#include "ShardedArchive.hpp"
+#include "SHA1.hpp"
+#include "SourceFile.hpp"
+#include "TarReader.hpp"
+#include "ThreadPool.hpp"
+#include "XMLWrapper.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <thread>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    // source file moving through the pipeline, reused for later files
+    struct Job {
+        std::size_t index = 0;
+        AnalysisRequest request;
+        SourceFile file;
+        std::string content;    // content of archive entries and stdin, instead of the file
+        bool loaded = false;    // content is loaded instead of in the file
+        bool failed = false;    // file could not be read
+        std::string readError;  // diagnostic of the failed read
+        std::string unit;       // generated XML or binary unit
+        bool valid = false;
+        AnalysisError error = AnalysisError::NONE;
+        SourceFile cached;      // unit from the cache, instead of the generated unit
+        bool hit = false;
+        struct stat status;     // status of the file before it was read
+        bool recordable = false;    // status is known, so the file can be added to the manifest
+        SHA1::HexDigest contentHash;
+        bool hashed = false;
+    };
+    using JobPtr = std::unique_ptr<Job>;
+
+    // closes the file descriptor on all paths
+    struct FileDescriptor {
+        int fd;
+        ~FileDescriptor() { ::close(fd); }
+    };
+
+    // tar archive by its extension
+    bool isTarArchive(const std::string& path) {
+
+        auto endsWith = [&path](std::string_view suffix) {
+            return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+        };
+
+        return endsWith(".tar") || endsWith(".tar.gz") || endsWith(".tgz");
+    }
+
+    // read the file descriptor to its end
+    void readAll(int fd, std::string& content) {
+
+        content.clear();
+        char chunk[64 * 1024];
+        while (true) {
+            const ssize_t count = ::read(fd, chunk, sizeof(chunk));
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::system_error(errno, std::generic_category(), "read");
+            }
+            if (count == 0)
+                break;
+            content.append(chunk, static_cast<std::size_t>(count));
+        }
+    }
+
+    class Pipeline {
+    public:
+
+        // output to a sink, or to shards
+        Pipeline(const PipelineOptions& options, OutputSink* sink, ShardedArchive* shards)
+            : options(options), sink(sink), shards(shards), binary(options.binary && !shards),
+              capacity(options.capacity > 0 ? options.capacity : 1), cache(binary ? nullptr : options.cache),
+              diagnostics(options.diagnostics ? *options.diagnostics : ownDiagnostics),
+              freeJobs(capacity), readQueue(capacity), renderQueue(capacity), slots(capacity) {
+
+            // only capacity jobs exist, so a full pipeline waits for the writer
+            for (std::size_t i = 0; i < capacity; ++i)
+                freeJobs.push(std::make_unique<Job>());
+        }
+
+        // diagnostics without a log of the caller are reported once, even on failure
+        ~Pipeline() {
+
+            if (&diagnostics == &ownDiagnostics) {
+                try {
+                    ownDiagnostics.report(std::cerr);
+                } catch (...) {}
+            }
+        }
+
+        std::size_t run(const std::vector<std::string>& inputs) {
+
+            const unsigned int readerCount = options.readers > 0 ? options.readers : 1;
+            unsigned int workerCount = options.workers > 0 ? options.workers : std::thread::hardware_concurrency();
+            if (workerCount == 0)
+                workerCount = 1;
+
+            activeReaders = readerCount;
+            std::vector<std::thread> threads;
+            threads.emplace_back(&Pipeline::expand, this, std::cref(inputs));
+            for (unsigned int i = 0; i < readerCount; ++i)
+                threads.emplace_back(&Pipeline::read, this);
+            for (unsigned int i = 0; i < workerCount; ++i)
+                threads.emplace_back(&Pipeline::render, this);
+
+            std::size_t count = 0;
+            try {
+                count = write();
+            } catch (...) {
+                // stop all stages, whichever queue they wait on
+                freeJobs.close();
+                readQueue.close();
+                renderQueue.close();
+                for (auto& thread : threads)
+                    thread.join();
+                throw;
+            }
+
+            for (auto& thread : threads)
+                thread.join();
+            if (failure)
+                std::rethrow_exception(failure);
+
+            return count;
+        }
+
+    private:
+
+        // job for the next source file, waiting while the pipeline is full
+        JobPtr take() {
+
+            JobPtr job;
+            if (!freeJobs.pop(job))
+                return nullptr;
+
+            job->index = nextIndex++;
+            job->request = options.defaults;
+            job->loaded = false;
+            job->failed = false;
+            job->valid = false;
+            job->error = AnalysisError::NONE;
+            job->hit = false;
+            job->recordable = false;
+            job->hashed = false;
+
+            return job;
+        }
+
+        // expand the inputs into jobs for each source file
+        void expand(const std::vector<std::string>& inputs) {
+
+            for (const auto& input : inputs) {
+                try {
+                    if (!expandInput(input))
+                        break;
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(slotMutex);
+                    if (!failure)
+                        failure = std::current_exception();
+                }
+            }
+
+            readQueue.close();
+            {
+                std::lock_guard<std::mutex> lock(slotMutex);
+                total = nextIndex.load();
+                expanded = true;
+            }
+            slotReady.notify_all();
+        }
+
+        // expand a single input, false when the pipeline is stopped
+        bool expandInput(const std::string& input) {
+
+            // stdin is source code
+            if (input == "-") {
+                JobPtr job = take();
+                if (!job)
+                    return false;
+                job->request.diskFilename = "-";
+                job->request.entryFilename = "data";
+                readAll(STDIN_FILENO, job->content);
+                job->loaded = true;
+                return renderQueue.push(std::move(job));
+            }
+
+            struct stat status;
+            if (::stat(input.c_str(), &status) < 0)
+                throw std::system_error(errno, std::generic_category(), input);
+
+            // files of directories are walked in parallel, with each file read by the readers
+            if (S_ISDIR(status.st_mode)) {
+                std::atomic<bool> stopped{false};
+                ThreadPool walkers(options.readers);
+                walkDirectory(input, walkers, [&](AnalysisRequest&& request) {
+                    JobPtr job = take();
+                    if (!job) {
+                        stopped = true;
+                        return;
+                    }
+                    job->request.diskFilename = std::move(request.diskFilename);
+                    if (!readQueue.push(std::move(job)))
+                        stopped = true;
+                }, diagnostics);
+                walkers.wait();
+                return !stopped;
+            }
+
+            // entries of tar archives are read in order, and only for supported extensions
+            if (isTarArchive(input)) {
+                const int fd = ::open(input.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0)
+                    throw std::system_error(errno, std::generic_category(), input);
+                const FileDescriptor file{fd};
+
+                TarReader reader(fd);
+                while (reader.next()) {
+                    if (filenameToLanguage(reader.name()).empty())
+                        continue;
+
+                    JobPtr job = take();
+                    if (!job)
+                        return false;
+                    job->request.diskFilename = input;
+                    job->request.entryFilename = reader.name();
+                    job->content.assign(reader.content());
+                    job->loaded = true;
+                    if (!renderQueue.push(std::move(job)))
+                        return false;
+                }
+                return true;
+            }
+
+            JobPtr job = take();
+            if (!job)
+                return false;
+            job->request.diskFilename = input;
+            return readQueue.push(std::move(job));
+        }
+
+        // load the content of source files
+        void read() {
+
+            JobPtr job;
+            while (readQueue.pop(job)) {
+                if (cache && loadUnchanged(*job)) {
+                    if (!renderQueue.push(std::move(job)))
+                        break;
+                    continue;
+                }
+                try {
+                    job->file.open(job->request.diskFilename);
+                } catch (const std::system_error& error) {
+                    job->readError = error.what();
+                    job->failed = true;
+                }
+                if (!renderQueue.push(std::move(job)))
+                    break;
+            }
+
+            // last reader ends the rendering
+            if (--activeReaders == 0)
+                renderQueue.close();
+        }
+
+        // unit of a file unchanged since it was recorded, without reading the file
+        bool loadUnchanged(Job& job) {
+
+            if (::stat(job.request.diskFilename.c_str(), &job.status) < 0)
+                return false;
+            job.recordable = S_ISREG(job.status.st_mode);
+            if (!job.recordable || !cache->unchanged(job.request.diskFilename, job.status, job.contentHash))
+                return false;
+            job.hashed = true;
+
+            job.hit = cache->load(ResultCache::key(job.request, job.contentHash), job.cached);
+
+            return job.hit;
+        }
+
+        // unit from the cache for the content, or generated and stored
+        void renderCached(Job& job, AnalysisRequestView request) {
+
+            if (!job.hashed)
+                job.contentHash = sha1Hex(request.sourceCode);
+            if (job.recordable)
+                cache->record(job.request.diskFilename, job.status, job.contentHash);
+
+            const ResultCache::Key key = ResultCache::key(request, job.contentHash);
+            job.hit = cache->load(key, job.cached);
+            if (job.hit)
+                return;
+
+            // content is already hashed
+            if (request.computeHash && request.optionHash.empty())
+                request.optionHash = std::string_view(job.contentHash.data(), job.contentHash.size());
+
+            job.error = tryFormatAnalysisUnitXMLInto(request, job.unit);
+            job.valid = job.error == AnalysisError::NONE;
+            if (job.valid)
+                cache->store(key, job.unit);
+        }
+
+        // generate units, and pass them to the writer
+        void render() {
+
+            JobPtr job;
+            while (renderQueue.pop(job)) {
+                if (!job->failed && !job->hit) {
+                    AnalysisRequestView request(job->request);
+                    request.sourceCode = job->loaded ? std::string_view(job->content) : job->file.content();
+                    if (binary) {
+                        job->error = tryFormatAnalysisBinaryInto(request, job->unit);
+                        job->valid = job->error == AnalysisError::NONE;
+                    } else if (cache) {
+                        renderCached(*job, request);
+                    } else {
+                        // the hash is computed first for the index of the shards
+                        if (shards && request.computeHash && request.optionHash.empty()) {
+                            job->contentHash = sha1Hex(request.sourceCode);
+                            job->hashed = true;
+                            request.optionHash = std::string_view(job->contentHash.data(), job->contentHash.size());
+                        }
+                        job->error = tryFormatAnalysisUnitXMLInto(request, job->unit);
+                        job->valid = job->error == AnalysisError::NONE;
+                    }
+                }
+                job->file.close();
+
+                const std::size_t slot = job->index % capacity;
+                {
+                    std::lock_guard<std::mutex> lock(slotMutex);
+                    slots[slot] = std::move(job);
+                }
+                slotReady.notify_all();
+            }
+        }
+
+        // write the units in order, returning each job for reuse
+        std::size_t write() {
+
+            // binary units with a trailing index, an archive unit, or shards
+            std::optional<BinaryUnitWriter> binaryWriter;
+            std::optional<XMLWrapper> archive;
+            if (binary) {
+                binaryWriter.emplace(*sink);
+            } else if (!shards) {
+                archive.emplace(CODE_UNIT_DOCUMENT, *sink);
+                archive->addContent("\n");
+            }
+
+            std::size_t count = 0;
+            for (std::size_t index = 0; ; ++index) {
+
+                JobPtr job;
+                {
+                    JobPtr& slot = slots[index % capacity];
+                    std::unique_lock<std::mutex> lock(slotMutex);
+                    slotReady.wait(lock, [&]{ return slot || (expanded && index >= total); });
+                    if (!slot)
+                        break;
+                    job = std::move(slot);
+                }
+
+                if (job->hit || job->valid) {
+                    const std::string_view unit = job->hit ? job->cached.content() : std::string_view(job->unit);
+                    if (binaryWriter)
+                        binaryWriter->add(unit);
+                    else if (shards)
+                        shards->add(unit, formatAnalysisFilename(job->request), unitHash(*job));
+                    else
+                        sink->write(unit);
+                    ++count;
+                } else if (job->failed) {
+                    diagnostics.add(AnalysisError::UNREADABLE, "", job->readError);
+                } else if (job->error != AnalysisError::NONE) {
+                    diagnostics.add(job->error, formatAnalysisFilename(job->request));
+                }
+                job->cached.close();
+                job->content.clear();
+                freeJobs.push(std::move(job));
+            }
+
+            if (binaryWriter)
+                binaryWriter->finish();
+            else if (archive)
+                archive->endElement();
+
+            return count;
+        }
+
+        // hash attribute of the unit of the job, empty for none
+        static std::string_view unitHash(const Job& job) {
+
+            if (!job.request.optionHash.empty())
+                return job.request.optionHash;
+            if (job.request.computeHash && job.hashed)
+                return std::string_view(job.contentHash.data(), job.contentHash.size());
+
+            return std::string_view();
+        }
+
+        const PipelineOptions& options;
+        OutputSink* const sink;
+        ShardedArchive* const shards;
+        const bool binary;
+        const std::size_t capacity;
+        ResultCache* const cache;   // only for XML units
+
+        // diagnostics of unreadable files and invalid requests, in input order
+        DiagnosticLog ownDiagnostics;
+        DiagnosticLog& diagnostics;
+
+        // unused jobs, and jobs waiting to be read and rendered
+        BoundedQueue<JobPtr> freeJobs;
+        BoundedQueue<JobPtr> readQueue;
+        BoundedQueue<JobPtr> renderQueue;
+        std::atomic<std::size_t> nextIndex{0};
+        std::atomic<unsigned int> activeReaders{0};
+
+        // rendered jobs by index, and the number of jobs once expanded
+        std::vector<JobPtr> slots;
+        std::mutex slotMutex;
+        std::condition_variable slotReady;
+        std::size_t total = 0;
+        bool expanded = false;
+        std::exception_ptr failure;
+    };
+}
+
+/**
+ * Write an archive of source analysis XML for the inputs through a pipeline
+ * Each source file forms a unit nested in an outer archive unit.
+ *
+ * @param inputs Source files, directories, tar archives, and "-" for stdin
+ * @param options Settings of the pipeline
+ * @param sink Destination of the XML
+ * @retval Number of units written
+ * @throw The first error of an input, e.g., a missing directory, once the other inputs are written
+ */
+std::size_t runAnalysisPipeline(const std::vector<std::string>& inputs, const PipelineOptions& options, OutputSink& sink) {
+
+    Pipeline pipeline(options, &sink, nullptr);
+
+    return pipeline.run(inputs);
+}
+
+/**
+ * Write the units for the inputs through a pipeline to a sharded archive
+ *
+ * @param inputs Source files, directories, tar archives, and "-" for stdin
+ * @param options Settings of the pipeline
+ * @param shards Destination of the units
+ * @retval Number of units written
+ * @throw The first error of an input, e.g., a missing directory, once the other inputs are written
+ */
+std::size_t runAnalysisPipeline(const std::vector<std::string>& inputs, const PipelineOptions& options, ShardedArchive& shards) {
+
+    Pipeline pipeline(options, nullptr, &shards);
+
+    return pipeline.run(inputs);
+}
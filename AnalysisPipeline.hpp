@@ -0,0 +1,78 @@
+/*
+  @file AnalysisPipeline.hpp
+
+  Pipeline of threads that read, analyze, and write source files
+*/
+
+#ifndef INCLUDED_ANALYSISPIPELINE_HPP
+#define INCLUDED_ANALYSISPIPELINE_HPP
+
+#include "AnalysisRequest.hpp"
+#include "AnalysisError.hpp"
+#include "OutputSink.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class ResultCache;
+class ShardedArchive;
+
+/**
+ * Settings of the analysis pipeline
+ */
+struct PipelineOptions {
+    unsigned int readers = 2;   // threads reading files
+    unsigned int workers = 0;   // threads generating units, 0 for the hardware concurrency
+    std::size_t capacity = 64;  // units read but not yet written
+    AnalysisRequest defaults;   // fields of every request, e.g., optionURL
+    ResultCache* cache = nullptr;   // units of earlier runs, reused for unchanged content
+    bool binary = false;        // binary units with an index instead of XML, without the cache
+    DiagnosticLog* diagnostics = nullptr;   // unreadable files and invalid requests, reported to std::cerr at the end when null
+
+    // no LOC unless provided or computed
+    PipelineOptions() { defaults.optionLOC = -1; }
+};
+
+/**
+ * Write an archive of source analysis XML for the inputs through a pipeline
+ * Each source file forms a unit nested in an outer archive unit.
+ *
+ * Inputs are expanded into source files in order, with directories walked
+ * in parallel, and tar archives read entry by entry. Reader threads load the
+ * files, worker threads generate the units, and the calling thread writes
+ * them in the order they were expanded. All stages overlap, and at most
+ * capacity units are in the pipeline, so a slow stage slows the others
+ * instead of growing memory. Invalid requests are skipped. Their diagnostics,
+ * and those of unreadable files, are added to the log in input order, or
+ * without a log, reported to std::cerr in a single write at the end.
+ * The sink is not flushed.
+ *
+ * With a cache, files unchanged since an earlier run are not read, and
+ * units for content and options seen before are not generated again.
+ * With binary output, the units are written as in BinaryUnits.hpp instead
+ * of nested in an archive unit.
+ *
+ * @param inputs Source files, directories, tar archives, and "-" for stdin
+ * @param options Settings of the pipeline
+ * @param sink Destination of the XML
+ * @retval Number of units written
+ * @throw The first error of an input, e.g., a missing directory, once the other inputs are written
+ */
+std::size_t runAnalysisPipeline(const std::vector<std::string>& inputs, const PipelineOptions& options, OutputSink& sink);
+
+/**
+ * Write the units for the inputs through a pipeline to a sharded archive
+ *
+ * As for the single archive, with the units added to the shards in order
+ * along with their filename and hash for the index. Units are always XML.
+ * The shards are not finished.
+ *
+ * @param inputs Source files, directories, tar archives, and "-" for stdin
+ * @param options Settings of the pipeline
+ * @param shards Destination of the units
+ * @retval Number of units written
+ * @throw The first error of an input, e.g., a missing directory, once the other inputs are written
+ */
+std::size_t runAnalysisPipeline(const std::vector<std::string>& inputs, const PipelineOptions& options, ShardedArchive& shards);
+
+#endif
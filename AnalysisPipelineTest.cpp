@@ -0,0 +1,234 @@
+/*
+  @file AnalysisPipelineTest.cpp
+
+  Test program for runAnalysisPipeline()
+*/
+
+#include "AnalysisPipeline.hpp"
+#include "CodeAnalysis.hpp"
+#include "ResultCache.hpp"
+#include "ShardedArchive.hpp"
+#include "SHA1.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <iterator>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <cassert>
+
+int main() {
+
+    const std::filesystem::path root = "AnalysisPipelineTest.tree";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "src");
+
+    // source files, with some unsupported, invalid, or large
+    std::vector<std::string> inputs;
+    std::vector<AnalysisRequest> requests;
+    for (int i = 0; i < 40; ++i) {
+        const std::string extension = i % 7 == 3 ? ".txt" : i % 2 ? ".java" : ".cpp";
+        const std::string path = (root / ("file" + std::to_string(i) + extension)).string();
+        std::string content = i % 11 == 5 ? "invalid \xFF\n" : "if (a < b && c) a = " + std::to_string(i) + ";\n";
+        if (i % 13 == 0)
+            content = std::string(100000, 'x') + content;
+        std::ofstream(path, std::ios::binary) << content;
+
+        inputs.push_back(path);
+        AnalysisRequest request;
+        request.sourceCode   = content;
+        request.diskFilename = path;
+        request.optionLOC    = -1;
+        request.computeLOC   = true;
+        request.computeHash  = true;
+        request.optionURL    = "https://mlcollard.net";
+        requests.push_back(request);
+    }
+
+    // units in the order of the inputs, for any number of threads and capacity
+    const std::string expected = formatAnalysisArchiveXML(requests, 2);
+    for (unsigned int workers = 1; workers <= 3; ++workers) {
+        for (std::size_t capacity : { 1, 3, 64 }) {
+            PipelineOptions options;
+            options.readers = workers;
+            options.workers = workers;
+            options.capacity = capacity;
+            options.defaults.computeLOC  = true;
+            options.defaults.computeHash = true;
+            options.defaults.optionURL   = "https://mlcollard.net";
+
+            std::string xml;
+            StringSink sink(xml);
+            runAnalysisPipeline(inputs, options, sink);
+            assert(xml == expected);
+        }
+    }
+
+    // diagnostics of invalid requests are logged in input order, as for an archive
+    {
+        DiagnosticLog archiveLog;
+        std::string archive;
+        StringSink archiveSink(archive);
+        formatAnalysisArchiveXML(requests, archiveSink, 2, &archiveLog);
+        assert(archiveLog.count(AnalysisError::EXTENSION) == 6);
+        assert(archiveLog.count(AnalysisError::UTF8) == 3);
+
+        PipelineOptions options;
+        options.workers = 3;
+        options.defaults.computeLOC  = true;
+        options.defaults.computeHash = true;
+        options.defaults.optionURL   = "https://mlcollard.net";
+        DiagnosticLog pipelineLog;
+        options.diagnostics = &pipelineLog;
+        std::string xml;
+        StringSink sink(xml);
+        runAnalysisPipeline(inputs, options, sink);
+        assert(xml == archive);
+
+        std::ostringstream archiveReport;
+        archiveLog.report(archiveReport);
+        std::ostringstream pipelineReport;
+        pipelineLog.report(pipelineReport);
+        assert(pipelineReport.str() == archiveReport.str());
+        assert(pipelineReport.str().find((root / "file3.txt").string() + ": Extension not supported\n") == 0);
+    }
+
+    // binary units convert to the same archive
+    {
+        PipelineOptions options;
+        options.binary = true;
+        options.defaults.computeLOC  = true;
+        options.defaults.computeHash = true;
+        options.defaults.optionURL   = "https://mlcollard.net";
+
+        std::string binary;
+        StringSink binarySink(binary);
+        runAnalysisPipeline(inputs, options, binarySink);
+
+        std::string xml;
+        StringSink sink(xml);
+        formatAnalysisBinaryXML(binary, sink);
+        assert(xml == expected);
+    }
+
+    // shards hold the units in order, with their filename and hash in the index
+    {
+        PipelineOptions options;
+        options.defaults.computeLOC  = true;
+        options.defaults.computeHash = true;
+        options.defaults.optionURL   = "https://mlcollard.net";
+
+        const std::string prefix = (root / "shard").string();
+        ShardedArchive shards(prefix, 0, 8);
+        [[maybe_unused]] const std::size_t count = runAnalysisPipeline(inputs, options, shards);
+        const std::size_t shardCount = shards.finish();
+        assert(shardCount == (count + 7) / 8);
+
+        // the units of the shards form the units of the single archive
+        const std::string header = expected.substr(0, expected.find('\n', expected.find("<code:unit")) + 1);
+        const std::string footer = "</code:unit>\n";
+        std::string units;
+        for (std::size_t shard = 0; shard < shardCount; ++shard) {
+            std::ifstream in(ShardedArchive::shardPath(prefix, shard), std::ios::binary);
+            const std::string xml((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            assert(xml.compare(0, header.size(), header) == 0);
+            assert(xml.compare(xml.size() - footer.size(), footer.size(), footer) == 0);
+            units += xml.substr(header.size(), xml.size() - header.size() - footer.size());
+        }
+        assert(header + units + footer == expected);
+
+        // index has a line for each unit, with its filename and hash
+        std::ifstream index(prefix + ".index");
+        std::string line;
+        std::size_t lines = 0;
+        while (std::getline(index, line)) {
+            std::vector<std::string> fields;
+            std::istringstream in(line);
+            for (std::string field; std::getline(in, field, '\t'); )
+                fields.push_back(field);
+            assert(fields.size() == 5);
+
+            [[maybe_unused]] const auto request = std::find_if(requests.begin(), requests.end(), [&](const AnalysisRequest& request) {
+                return request.diskFilename == fields[3];
+            });
+            assert(request != requests.end());
+            assert(fields[4] == std::string(sha1Hex(request->sourceCode).data(), SHA1::HEX_SIZE));
+            ++lines;
+        }
+        assert(lines == count);
+    }
+
+    // cached units match generated units, and are reused for unchanged files
+    {
+        const std::string cacheDirectory = (root / "cache").string();
+        PipelineOptions options;
+        options.defaults.computeLOC  = true;
+        options.defaults.computeHash = true;
+        options.defaults.optionURL   = "https://mlcollard.net";
+
+        for (int run = 0; run < 2; ++run) {
+            ResultCache cache(cacheDirectory);
+            options.cache = &cache;
+
+            std::string xml;
+            StringSink sink(xml);
+            runAnalysisPipeline(inputs, options, sink);
+            assert(xml == expected);
+        }
+
+        // a stored unit is used instead of reading the unchanged file
+        const std::string marked = "<code:unit>marked</code:unit>\n";
+        const auto key = ResultCache::key(requests[0], sha1Hex(requests[0].sourceCode));
+        std::ofstream(root / "cache" / "units" / std::string(key.data(), key.size()), std::ios::binary) << marked;
+
+        // a changed file is read again
+        requests[2].sourceCode = "changed = 1;\n";
+        std::ofstream(inputs[2], std::ios::binary) << requests[2].sourceCode;
+
+        ResultCache cache(cacheDirectory);
+        options.cache = &cache;
+        std::string xml;
+        StringSink sink(xml);
+        runAnalysisPipeline(inputs, options, sink);
+        assert(xml.find(marked) != std::string::npos);
+        assert(xml.find("changed = 1;") != std::string::npos);
+
+        std::filesystem::remove_all(root / "cache");
+    }
+
+    // directories are expanded into their source files
+    {
+        std::ofstream(root / "src" / "main.cpp") << "a = b;\n";
+        std::ofstream(root / "src" / "notes.txt") << "notes\n";
+
+        std::string xml;
+        StringSink sink(xml);
+        assert(runAnalysisPipeline({ (root / "src").string() }, PipelineOptions(), sink) == 1);
+        assert(xml == R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<code:unit xmlns:code="http://mlcollard.net/code">
+<code:unit language="C++" filename="AnalysisPipelineTest.tree/src/main.cpp">a = b;
+</code:unit>
+</code:unit>
+)");
+    }
+
+    // errors in inputs are reported after the other inputs are written
+    {
+        std::string xml;
+        StringSink sink(xml);
+        [[maybe_unused]] bool thrown = false;
+        try {
+            runAnalysisPipeline({ "AnalysisPipelineTest.missing", (root / "src").string() }, PipelineOptions(), sink);
+        } catch (const std::system_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(xml.find("main.cpp") != std::string::npos);
+    }
+
+    std::filesystem::remove_all(root);
+
+    return 0;
+}
@@ -8,19 +8,106 @@
 #define INCLUDED_ANALYSISREQUEST_HPP
 
 #include <string>
+#include <string_view>
+#include <memory_resource>
+#include <utility>
 
-struct AnalysisRequest {
-    std::string sourceCode;
-    std::string diskFilename;
-    std::string entryFilename;
-    std::string optionFilename;
-    std::string sourceURL;
-    std::string optionURL;
-    std::string optionLanguage;
-    std::string defaultLanguage;
-    std::string optionHash;
+/**
+ * Request that owns its data in strings of type String
+ *
+ * An aggregate, so positional initializers list the fields in order.
+ * Fields added later are declared after timestamp.
+ */
+template<typename String>
+struct BasicAnalysisRequest {
+    String sourceCode;
+    String diskFilename;
+    String entryFilename;
+    String optionFilename;
+    String sourceURL;
+    String optionURL;
+    String optionLanguage;
+    String defaultLanguage;
+    String optionHash;
     int optionLOC = 0;
-    std::string timestamp;
+    String timestamp;
+    bool computeHash = false;   // hash of sourceCode when optionHash is empty
+    bool computeLOC = false;    // lines of sourceCode when optionLOC is negative
+};
+
+using AnalysisRequest = BasicAnalysisRequest<std::string>;
+
+/**
+ * Request with strings that allocate from a memory resource
+ *
+ * A batch of requests can come from a single arena. The allocator
+ * is propagated to the strings by uses-allocator construction,
+ * e.g., when held in a std::pmr::vector.
+ */
+struct PmrAnalysisRequest : BasicAnalysisRequest<std::pmr::string> {
+    using allocator_type = std::pmr::string::allocator_type;
+
+    PmrAnalysisRequest() = default;
+    PmrAnalysisRequest(const PmrAnalysisRequest&) = default;
+    PmrAnalysisRequest(PmrAnalysisRequest&&) = default;
+    PmrAnalysisRequest& operator=(const PmrAnalysisRequest&) = default;
+    PmrAnalysisRequest& operator=(PmrAnalysisRequest&&) = default;
+
+    explicit PmrAnalysisRequest(const allocator_type& allocator)
+        : BasicAnalysisRequest{ std::pmr::string(allocator), std::pmr::string(allocator), std::pmr::string(allocator),
+                                std::pmr::string(allocator), std::pmr::string(allocator), std::pmr::string(allocator),
+                                std::pmr::string(allocator), std::pmr::string(allocator), std::pmr::string(allocator),
+                                0, std::pmr::string(allocator), false, false } {}
+
+    PmrAnalysisRequest(const PmrAnalysisRequest& other, const allocator_type& allocator)
+        : BasicAnalysisRequest{ std::pmr::string(other.sourceCode, allocator), std::pmr::string(other.diskFilename, allocator),
+                                std::pmr::string(other.entryFilename, allocator), std::pmr::string(other.optionFilename, allocator),
+                                std::pmr::string(other.sourceURL, allocator), std::pmr::string(other.optionURL, allocator),
+                                std::pmr::string(other.optionLanguage, allocator), std::pmr::string(other.defaultLanguage, allocator),
+                                std::pmr::string(other.optionHash, allocator), other.optionLOC,
+                                std::pmr::string(other.timestamp, allocator), other.computeHash, other.computeLOC } {}
+
+    PmrAnalysisRequest(PmrAnalysisRequest&& other, const allocator_type& allocator)
+        : BasicAnalysisRequest{ std::pmr::string(std::move(other.sourceCode), allocator), std::pmr::string(std::move(other.diskFilename), allocator),
+                                std::pmr::string(std::move(other.entryFilename), allocator), std::pmr::string(std::move(other.optionFilename), allocator),
+                                std::pmr::string(std::move(other.sourceURL), allocator), std::pmr::string(std::move(other.optionURL), allocator),
+                                std::pmr::string(std::move(other.optionLanguage), allocator), std::pmr::string(std::move(other.defaultLanguage), allocator),
+                                std::pmr::string(std::move(other.optionHash), allocator), other.optionLOC,
+                                std::pmr::string(std::move(other.timestamp), allocator), other.computeHash, other.computeLOC } {}
+};
+
+/**
+ * Request that refers to its data instead of owning it,
+ * e.g., source code in a memory-mapped SourceFile
+ *
+ * The referenced data must outlive the view.
+ */
+struct AnalysisRequestView {
+    std::string_view sourceCode;
+    std::string_view diskFilename;
+    std::string_view entryFilename;
+    std::string_view optionFilename;
+    std::string_view sourceURL;
+    std::string_view optionURL;
+    std::string_view optionLanguage;
+    std::string_view defaultLanguage;
+    std::string_view optionHash;
+    int optionLOC = 0;
+    std::string_view timestamp;
+    bool computeHash = false;   // hash of sourceCode when optionHash is empty
+    bool computeLOC = false;    // lines of sourceCode when optionLOC is negative
+
+    AnalysisRequestView() = default;
+
+    template<typename String>
+    AnalysisRequestView(const BasicAnalysisRequest<String>& request)
+        : sourceCode(request.sourceCode), diskFilename(request.diskFilename),
+          entryFilename(request.entryFilename), optionFilename(request.optionFilename),
+          sourceURL(request.sourceURL), optionURL(request.optionURL),
+          optionLanguage(request.optionLanguage), defaultLanguage(request.defaultLanguage),
+          optionHash(request.optionHash), optionLOC(request.optionLOC),
+          timestamp(request.timestamp), computeHash(request.computeHash),
+          computeLOC(request.computeLOC) {}
 };
 
 #endif
@@ -0,0 +1,793 @@
+/*
+  @file AnalysisServer.cpp
+
+  Implementation of the analysis server and its client
+*/
+
+#include "AnalysisServer.hpp"
+#include "CodeAnalysis.hpp"
+#include "ResultCache.hpp"
+#include "SHA1.hpp"
+#include "SourceFile.hpp"
+#include "XMLWrapper.hpp"
+#include <algorithm>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    constexpr std::uint32_t COMPUTE_HASH = 1;
+    constexpr std::uint32_t COMPUTE_LOC = 2;
+    constexpr std::uint32_t READ_FILE = 4;
+
+    // fields of a request, in the order of their sizes and bytes
+    constexpr std::string_view AnalysisRequestView::* FIELDS[] = {
+        &AnalysisRequestView::sourceCode,
+        &AnalysisRequestView::diskFilename,
+        &AnalysisRequestView::entryFilename,
+        &AnalysisRequestView::optionFilename,
+        &AnalysisRequestView::sourceURL,
+        &AnalysisRequestView::optionURL,
+        &AnalysisRequestView::optionLanguage,
+        &AnalysisRequestView::defaultLanguage,
+        &AnalysisRequestView::optionHash,
+        &AnalysisRequestView::timestamp,
+    };
+    constexpr std::size_t FIELD_COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+    // size, id, flags, loc, and the size of each field
+    constexpr std::size_t REQUEST_HEADER_SIZE = 16 + 4 * FIELD_COUNT;
+
+    // size, id, and error
+    constexpr std::size_t RESPONSE_HEADER_SIZE = 12;
+
+    // bytes read from a connection at once
+    constexpr std::size_t READ_SIZE = 64 * 1024;
+
+    // unsent output kept allocated between responses
+    constexpr std::size_t OUTPUT_RETAINED = 1024 * 1024;
+
+    // append an integer in little-endian order
+    template<typename Integer>
+    void appendInteger(std::string& out, Integer value) {
+
+        const auto bits = static_cast<std::uint64_t>(value);
+        for (std::size_t i = 0; i < sizeof(Integer); ++i)
+            out += static_cast<char>((bits >> (8 * i)) & 0xFF);
+    }
+
+    // store an integer in little-endian order
+    void storeInteger(char* out, std::uint32_t value) {
+
+        for (std::size_t i = 0; i < sizeof(value); ++i)
+            out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+
+    // integer in little-endian order
+    template<typename Integer>
+    Integer readInteger(std::string_view data, std::size_t offset) {
+
+        std::uint64_t bits = 0;
+        for (std::size_t i = 0; i < sizeof(Integer); ++i)
+            bits |= std::uint64_t(static_cast<unsigned char>(data[offset + i])) << (8 * i);
+
+        return static_cast<Integer>(bits);
+    }
+
+    // append the frame of a request
+    void appendRequest(const AnalysisRequestView& request, std::uint32_t id, std::uint32_t flags, std::string& out) {
+
+        std::size_t size = REQUEST_HEADER_SIZE - 4;
+        for (const auto field : FIELDS)
+            size += (request.*field).size();
+
+        appendInteger(out, static_cast<std::uint32_t>(size));
+        appendInteger(out, id);
+        appendInteger(out, flags);
+        appendInteger(out, static_cast<std::int32_t>(request.optionLOC));
+        for (const auto field : FIELDS)
+            appendInteger(out, static_cast<std::uint32_t>((request.*field).size()));
+        for (const auto field : FIELDS)
+            out += request.*field;
+    }
+
+    // request of a complete frame, referring to the frame
+    bool decodeRequest(std::string_view frame, std::uint32_t& id, std::uint32_t& flags, AnalysisRequestView& request) {
+
+        if (frame.size() < REQUEST_HEADER_SIZE || readInteger<std::uint32_t>(frame, 0) != frame.size() - 4)
+            return false;
+
+        std::uint64_t size = REQUEST_HEADER_SIZE;
+        for (std::size_t i = 0; i < FIELD_COUNT; ++i)
+            size += readInteger<std::uint32_t>(frame, 16 + 4 * i);
+        if (size != frame.size())
+            return false;
+
+        id = readInteger<std::uint32_t>(frame, 4);
+        flags = readInteger<std::uint32_t>(frame, 8);
+        request.optionLOC = readInteger<std::int32_t>(frame, 12);
+        request.computeHash = flags & COMPUTE_HASH;
+        request.computeLOC = flags & COMPUTE_LOC;
+        std::size_t offset = REQUEST_HEADER_SIZE;
+        for (std::size_t i = 0; i < FIELD_COUNT; ++i) {
+            const auto fieldSize = readInteger<std::uint32_t>(frame, 16 + 4 * i);
+            request.*FIELDS[i] = frame.substr(offset, fieldSize);
+            offset += fieldSize;
+        }
+
+        return true;
+    }
+
+    // send as much of the pieces as the socket takes, without blocking, trimming the pieces sent
+    std::size_t sendPieces(int fd, iovec* pieces, std::size_t count, bool& failed) {
+
+        std::size_t total = 0;
+        std::size_t first = 0;
+        while (first < count) {
+
+            msghdr message{};
+            message.msg_iov = pieces + first;
+            message.msg_iovlen = count - first;
+            const ssize_t sent = ::sendmsg(fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (sent < 0) {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    failed = true;
+                break;
+            }
+            total += static_cast<std::size_t>(sent);
+
+            // skip the pieces sent, and trim a partially sent piece
+            auto written = static_cast<std::size_t>(sent);
+            while (first < count && written >= pieces[first].iov_len) {
+                written -= pieces[first].iov_len;
+                ++first;
+            }
+            if (written > 0) {
+                pieces[first].iov_base = static_cast<char*>(pieces[first].iov_base) + written;
+                pieces[first].iov_len -= written;
+            }
+        }
+
+        return total;
+    }
+
+    // address of a socket path
+    sockaddr_un socketAddress(const std::string& path) {
+
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path))
+            throw std::system_error(ENAMETOOLONG, std::generic_category(), path);
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        return address;
+    }
+
+    // read exactly size bytes
+    void readAll(int fd, char* data, std::size_t size) {
+
+        while (size > 0) {
+            const ssize_t count = ::read(fd, data, size);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count < 0)
+                throw std::system_error(errno, std::generic_category(), "read");
+            if (count == 0)
+                throw std::system_error(ECONNRESET, std::generic_category(), "read");
+            data += count;
+            size -= static_cast<std::size_t>(count);
+        }
+    }
+}
+
+/** Connection of a client, shared by the event thread and the workers with its requests */
+struct AnalysisServer::Connection {
+    int fd = -1;
+    std::string input;          // received bytes of incomplete requests, only for the event thread
+
+    std::mutex mutex;           // guards the rest
+    std::string output;         // responses the socket did not take
+    std::size_t sent = 0;       // part of the output already sent
+    std::size_t pending = 0;    // requests with a worker
+    std::size_t queued = 0;     // bytes of the requests with a worker
+    bool hangup = false;        // client sends no more requests
+    bool failed = false;        // socket error, or invalid request
+    bool closed = false;
+    std::uint32_t events = EPOLLIN;     // events watched
+
+    // whether the event thread is needed to send output, or to close
+    bool needsEventThread() const {
+        return !output.empty() || failed || (hangup && pending == 0);
+    }
+
+    // whether requests in progress and unsent responses are beyond the limit
+    bool backlogged(std::size_t maxBacklog) const {
+        return queued + (output.size() - sent) > maxBacklog;
+    }
+
+    // update the events of the connection, with the mutex held
+    void watch(int epollFd, std::size_t maxBacklog) {
+
+        // input at its end stays readable, so is no longer watched, and the
+        // input of a backlogged connection waits in the socket
+        const bool reading = !hangup && !backlogged(maxBacklog);
+        const std::uint32_t wanted = (reading ? std::uint32_t(EPOLLIN) : 0u) | (needsEventThread() ? std::uint32_t(EPOLLOUT) : 0u);
+        if (closed || wanted == events)
+            return;
+
+        events = wanted;
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+        ::epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+    }
+};
+
+/**
+ * Listen on a socket, replacing a stale socket file
+ *
+ * Only the user may connect, as requests may read any file the server can.
+ *
+ * @param path Path of the socket
+ * @param options Settings of the server
+ * @throw std::system_error if the socket cannot be created, another server is listening, or the path is another kind of file
+ */
+AnalysisServer::AnalysisServer(const std::string& path, const ServerOptions& options)
+    : path(path), options(options), readBuffer(READ_SIZE), pool(options.workers) {
+
+    const sockaddr_un address = socketAddress(path);
+    const auto addressSize = static_cast<socklen_t>(sizeof(address));
+    try {
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0)
+            throw std::system_error(errno, std::generic_category(), "socket");
+
+        // a socket file without a server is left from one that did not exit cleanly
+        if (::bind(listenFd, reinterpret_cast<const sockaddr*>(&address), addressSize) < 0) {
+            if (errno != EADDRINUSE)
+                throw std::system_error(errno, std::generic_category(), path);
+
+            const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            const bool listening = probe >= 0 && ::connect(probe, reinterpret_cast<const sockaddr*>(&address), addressSize) == 0;
+            if (probe >= 0)
+                ::close(probe);
+            if (listening)
+                throw std::system_error(EADDRINUSE, std::generic_category(), path);
+
+            // only a socket is replaced, never another kind of file at the path
+            struct stat status;
+            if (::lstat(path.c_str(), &status) < 0)
+                throw std::system_error(errno, std::generic_category(), path);
+            if (!S_ISSOCK(status.st_mode))
+                throw std::system_error(EADDRINUSE, std::generic_category(), path);
+
+            ::unlink(path.c_str());
+            if (::bind(listenFd, reinterpret_cast<const sockaddr*>(&address), addressSize) < 0)
+                throw std::system_error(errno, std::generic_category(), path);
+        }
+
+        // set before listening, so no connection is accepted with a wider mode
+        if (::chmod(path.c_str(), S_IRUSR | S_IWUSR) < 0)
+            throw std::system_error(errno, std::generic_category(), path);
+        if (::listen(listenFd, SOMAXCONN) < 0)
+            throw std::system_error(errno, std::generic_category(), path);
+
+        epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0)
+            throw std::system_error(errno, std::generic_category(), "epoll_create1");
+        wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeFd < 0)
+            throw std::system_error(errno, std::generic_category(), "eventfd");
+
+        for (const int fd : { listenFd, wakeFd }) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+                throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+        }
+    } catch (...) {
+        for (const int fd : { listenFd, epollFd, wakeFd })
+            if (fd >= 0)
+                ::close(fd);
+        throw;
+    }
+}
+
+/** Closes the connections, and removes the socket file */
+AnalysisServer::~AnalysisServer() {
+
+    try {
+        pool.wait();
+    } catch (...) {
+    }
+
+    for (const auto& entry : connections)
+        close(*entry.second);
+
+    ::close(listenFd);
+    ::close(epollFd);
+    ::close(wakeFd);
+    ::unlink(path.c_str());
+}
+
+/**
+ * Handle connections until stop(), then wait for the requests in progress
+ *
+ * Responses not yet sent when stopped are dropped.
+ *
+ * @throw std::system_error if waiting for events fails
+ */
+void AnalysisServer::run() {
+
+    constexpr int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+    while (!stopping) {
+
+        const int count = ::epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::generic_category(), "epoll_wait");
+        }
+
+        for (int i = 0; i < count; ++i) {
+
+            const int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                accept();
+                continue;
+            }
+            if (fd == wakeFd) {
+                std::uint64_t value;
+                while (::read(wakeFd, &value, sizeof(value)) > 0)
+                    ;
+                continue;
+            }
+
+            const auto found = connections.find(fd);
+            if (found == connections.end())
+                continue;
+            const ConnectionPtr connection = found->second;
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                std::lock_guard<std::mutex> lock(connection->mutex);
+                connection->failed = true;
+            }
+            if (events[i].events & EPOLLIN)
+                receive(connection);
+            if (events[i].events & EPOLLOUT)
+                flush(*connection);
+            closeIfDone(connection);
+        }
+    }
+
+    pool.wait();
+    for (const auto& entry : connections)
+        close(*entry.second);
+    connections.clear();
+}
+
+/**
+ * End run(). May be called from any thread, or a signal handler.
+ */
+void AnalysisServer::stop() {
+
+    stopping = true;
+    const std::uint64_t value = 1;
+    [[maybe_unused]] const ssize_t written = ::write(wakeFd, &value, sizeof(value));
+}
+
+// accept waiting connections
+void AnalysisServer::accept() {
+
+    while (true) {
+        const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            // out of descriptors, the waiting connections are accepted as others close
+            return;
+        }
+
+        auto connection = std::make_shared<Connection>();
+        connection->fd = fd;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            ::close(fd);
+            continue;
+        }
+        connections[fd] = std::move(connection);
+    }
+}
+
+// read from the connection, and queue its complete requests
+void AnalysisServer::receive(const ConnectionPtr& connection) {
+
+    bool hangup = false;
+    bool failed = false;
+    while (true) {
+
+        // requests of a backlogged connection wait in the socket
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            if (connection->backlogged(options.maxBacklog))
+                break;
+        }
+
+        const ssize_t count = ::read(connection->fd, readBuffer.data(), readBuffer.size());
+        if (count > 0) {
+            connection->input.append(readBuffer.data(), static_cast<std::size_t>(count));
+            failed = !queueRequests(connection);
+            if (failed || static_cast<std::size_t>(count) < readBuffer.size())
+                break;
+            continue;
+        }
+        if (count == 0)
+            hangup = true;
+        else if (errno == EINTR)
+            continue;
+        else if (errno != EAGAIN && errno != EWOULDBLOCK)
+            failed = true;
+        break;
+    }
+
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    connection->hangup = connection->hangup || hangup || failed;
+    connection->failed = connection->failed || failed;
+    connection->watch(epollFd, options.maxBacklog);
+}
+
+// queue the complete requests of the input, false for an invalid request
+bool AnalysisServer::queueRequests(const ConnectionPtr& connection) {
+
+    // a buffer of exactly one request is moved to the worker instead of copied
+    std::string& input = connection->input;
+    bool valid = true;
+    std::size_t consumed = 0;
+    while (input.size() - consumed >= 4) {
+
+        const std::uint64_t size = 4 + std::uint64_t(readInteger<std::uint32_t>(input, consumed));
+        if (size < REQUEST_HEADER_SIZE || size > options.maxFrame) {
+            valid = false;
+            break;
+        }
+        // storage grows with the bytes received, so a header alone cannot allocate a large frame
+        const std::size_t received = input.size() - consumed;
+        if (received < size) {
+            input.reserve(consumed + static_cast<std::size_t>(std::min<std::uint64_t>(size, std::max(2 * received, READ_SIZE))));
+            break;
+        }
+
+        std::string frame;
+        if (consumed == 0 && input.size() == size) {
+            frame = std::move(input);
+            input.clear();
+        } else {
+            frame.assign(input, consumed, size);
+            consumed += size;
+        }
+
+        std::uint32_t id;
+        std::uint32_t flags;
+        AnalysisRequestView request;
+        if (!decodeRequest(frame, id, flags, request)) {
+            valid = false;
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            ++connection->pending;
+            connection->queued += frame.size();
+        }
+        pool.submit([this, connection, frame = std::move(frame)] {
+            respond(*connection, frame);
+        });
+    }
+    if (consumed > 0 && !input.empty())
+        input.erase(0, consumed);
+
+    return valid;
+}
+
+// send the unsent part of the responses
+void AnalysisServer::flush(Connection& connection) {
+
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    if (!connection.output.empty() && !connection.failed) {
+        iovec piece{ connection.output.data() + connection.sent, connection.output.size() - connection.sent };
+        connection.sent += sendPieces(connection.fd, &piece, 1, connection.failed);
+        if (connection.sent == connection.output.size()) {
+            connection.output.clear();
+            connection.sent = 0;
+            if (connection.output.capacity() > OUTPUT_RETAINED)
+                connection.output.shrink_to_fit();
+        }
+    }
+    connection.watch(epollFd, options.maxBacklog);
+}
+
+// generate and send the response to a request
+void AnalysisServer::respond(Connection& connection, const std::string& frame) {
+
+    // reused by each request the thread handles
+    thread_local std::string unit;
+    thread_local SourceFile file;
+    thread_local SourceFile cached;
+
+    std::uint32_t id = 0;
+    std::uint32_t flags = 0;
+    AnalysisRequestView request;
+    decodeRequest(frame, id, flags, request);
+
+    AnalysisError error = AnalysisError::NONE;
+    std::string message;
+    bool hit = false;
+    ResultCache* const cache = options.cache;
+    SHA1::HexDigest contentHash;
+    bool hashed = false;
+    struct stat status;
+    bool recordable = false;
+    const std::string diskFilename(flags & READ_FILE ? request.diskFilename : std::string_view());
+
+    // unit of a file unchanged since it was recorded, without reading the file
+    if ((flags & READ_FILE) && cache && ::stat(diskFilename.c_str(), &status) == 0) {
+        recordable = S_ISREG(status.st_mode);
+        if (recordable && cache->unchanged(diskFilename, status, contentHash)) {
+            hashed = true;
+            hit = cache->load(ResultCache::key(request, contentHash), cached);
+        }
+    }
+    if ((flags & READ_FILE) && !hit) {
+        try {
+            file.open(diskFilename);
+            request.sourceCode = file.content();
+        } catch (const std::system_error& failure) {
+            error = AnalysisError::UNREADABLE;
+            message = failure.what();
+        }
+    }
+
+    // unit from the cache for the content, or generated and stored
+    if (!hit && error == AnalysisError::NONE) {
+        if (cache) {
+            if (!hashed)
+                contentHash = sha1Hex(request.sourceCode);
+            if (recordable)
+                cache->record(diskFilename, status, contentHash);
+
+            const ResultCache::Key key = ResultCache::key(request, contentHash);
+            hit = cache->load(key, cached);
+            if (!hit) {
+                // content is already hashed
+                if (request.computeHash && request.optionHash.empty())
+                    request.optionHash = std::string_view(contentHash.data(), contentHash.size());
+
+                error = tryFormatAnalysisUnitXMLInto(request, unit);
+                if (error == AnalysisError::NONE)
+                    cache->store(key, unit);
+            }
+        } else {
+            error = tryFormatAnalysisUnitXMLInto(request, unit);
+        }
+    }
+
+    // units are nested units, so the start of a document replaces the start of a nested unit
+    iovec pieces[3];
+    std::size_t count = 0;
+    char header[RESPONSE_HEADER_SIZE];
+    pieces[count++] = { header, sizeof(header) };
+    if (error == AnalysisError::NONE) {
+        std::string_view xml = hit ? cached.content() : std::string_view(unit);
+        if (xml.substr(0, CODE_UNIT_FRAGMENT.start.size()) == CODE_UNIT_FRAGMENT.start) {
+            pieces[count++] = { const_cast<char*>(CODE_UNIT_DOCUMENT.start.data()), CODE_UNIT_DOCUMENT.start.size() };
+            xml.remove_prefix(CODE_UNIT_FRAGMENT.start.size());
+        }
+        pieces[count++] = { const_cast<char*>(xml.data()), xml.size() };
+    } else {
+        if (message.empty())
+            message = analysisErrorMessage(error);
+        pieces[count++] = { message.data(), message.size() };
+    }
+
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < count; ++i)
+        size += pieces[i].iov_len;
+    storeInteger(header, static_cast<std::uint32_t>(size - 4));
+    storeInteger(header + 4, id);
+    storeInteger(header + 8, static_cast<std::uint32_t>(error));
+
+    // sent directly unless earlier responses are waiting, with the rest left for the event thread
+    {
+        std::lock_guard<std::mutex> lock(connection.mutex);
+        --connection.pending;
+        connection.queued -= frame.size();
+        if (!connection.closed && !connection.failed) {
+            iovec unsent[3];
+            std::copy(pieces, pieces + count, unsent);
+            std::size_t skip = connection.output.empty() ? sendPieces(connection.fd, unsent, count, connection.failed) : 0;
+            for (std::size_t i = 0; i < count && !connection.failed; ++i) {
+                const std::size_t length = pieces[i].iov_len;
+                if (skip >= length) {
+                    skip -= length;
+                    continue;
+                }
+                connection.output.append(static_cast<const char*>(pieces[i].iov_base) + skip, length - skip);
+                skip = 0;
+            }
+        }
+        connection.watch(epollFd, options.maxBacklog);
+    }
+    ++requests;
+
+    file.close();
+    cached.close();
+}
+
+// close the connection if it failed, or ended with all responses sent
+void AnalysisServer::closeIfDone(const ConnectionPtr& connection) {
+
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        if (!connection->failed && !(connection->hangup && connection->pending == 0 && connection->output.empty()))
+            return;
+    }
+
+    close(*connection);
+    connections.erase(connection->fd);
+}
+
+void AnalysisServer::close(Connection& connection) {
+
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    if (connection.closed)
+        return;
+
+    connection.closed = true;
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+    ::close(connection.fd);
+}
+
+/**
+ * @param path Path of the socket of the server
+ * @throw std::system_error if the server cannot be connected
+ */
+AnalysisClient::AnalysisClient(const std::string& path) {
+
+    const sockaddr_un address = socketAddress(path);
+    fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "socket");
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), path);
+    }
+}
+
+/** Closes the connection */
+AnalysisClient::~AnalysisClient() {
+
+    ::close(fd);
+}
+
+/**
+ * Unit for a request, as from tryFormatAnalysisXML()
+ *
+ * @param request Data that forms the request
+ * @retval Source analysis XML, or the error of the request
+ * @throw std::system_error if the connection fails
+ */
+AnalysisResult<std::string> AnalysisClient::analyze(const AnalysisRequestView& request) {
+
+    send(request, 0);
+    std::uint32_t id;
+
+    return receive(id);
+}
+
+/**
+ * Unit for a file read by the server, which skips reading an unchanged
+ * file with a cache
+ *
+ * @param request Data that forms the request, with the path in diskFilename,
+ *        except for the sourceCode
+ * @retval Source analysis XML, or the error of the request
+ * @throw std::system_error if the connection fails
+ */
+AnalysisResult<std::string> AnalysisClient::analyzeFile(const AnalysisRequestView& request) {
+
+    send(request, 0, true);
+    std::uint32_t id;
+
+    return receive(id);
+}
+
+/**
+ * Send a request without waiting for its response
+ *
+ * @param request Data that forms the request
+ * @param id Id of the request, returned with its response
+ * @param readFile Whether the server reads the sourceCode from the diskFilename
+ * @throw std::system_error if the connection fails
+ */
+void AnalysisClient::send(const AnalysisRequestView& request, std::uint32_t id, bool readFile) {
+
+    std::uint32_t flags = 0;
+    if (request.computeHash)
+        flags |= COMPUTE_HASH;
+    if (request.computeLOC)
+        flags |= COMPUTE_LOC;
+    AnalysisRequestView sent = request;
+    if (readFile) {
+        flags |= READ_FILE;
+        sent.sourceCode = std::string_view();
+    }
+
+    frame.clear();
+    appendRequest(sent, id, flags, frame);
+
+    std::size_t offset = 0;
+    while (offset < frame.size()) {
+        const ssize_t count = ::send(fd, frame.data() + offset, frame.size() - offset, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            throw std::system_error(errno, std::generic_category(), "send");
+        offset += static_cast<std::size_t>(count);
+    }
+}
+
+/**
+ * Wait for the next response
+ *
+ * @param id Id of the request of the response
+ * @retval Source analysis XML, or the error of the request
+ * @throw std::system_error if the connection fails or is closed
+ */
+AnalysisResult<std::string> AnalysisClient::receive(std::uint32_t& id) {
+
+    char header[RESPONSE_HEADER_SIZE];
+    readAll(fd, header, sizeof(header));
+    const std::string_view fields(header, sizeof(header));
+    const auto size = readInteger<std::uint32_t>(fields, 0);
+    if (size < RESPONSE_HEADER_SIZE - 4)
+        throw std::system_error(EPROTO, std::generic_category(), "read");
+    id = readInteger<std::uint32_t>(fields, 4);
+    const auto error = static_cast<AnalysisError>(readInteger<std::uint32_t>(fields, 8));
+
+    std::string body(size - (RESPONSE_HEADER_SIZE - 4), '\0');
+    readAll(fd, body.data(), body.size());
+    if (error != AnalysisError::NONE)
+        return error;
+
+    return body;
+}
+
+/**
+ * Send no more requests. The responses to the requests sent are still
+ * received, and the server then closes the connection.
+ *
+ * @throw std::system_error if the connection fails
+ */
+void AnalysisClient::finish() {
+
+    if (::shutdown(fd, SHUT_WR) < 0)
+        throw std::system_error(errno, std::generic_category(), "shutdown");
+}
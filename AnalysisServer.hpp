@@ -0,0 +1,214 @@
+/*
+  @file AnalysisServer.hpp
+
+  Long-running analysis server on a Unix domain socket, and its client
+*/
+
+#ifndef INCLUDED_ANALYSISSERVER_HPP
+#define INCLUDED_ANALYSISSERVER_HPP
+
+#include "AnalysisRequest.hpp"
+#include "AnalysisError.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ResultCache;
+
+/*
+  Protocol, with all integers little endian:
+
+    request   u32 size of the rest of the frame
+              u32 id, chosen by the client and returned in the response
+              u32 flags, 1 compute the hash, 2 compute the LOC, 4 read the
+                  source code from the diskFilename instead of the frame
+              i32 optionLOC, negative for none
+              u32 sizes of the sourceCode, diskFilename, entryFilename,
+                  optionFilename, sourceURL, optionURL, optionLanguage,
+                  defaultLanguage, optionHash, and timestamp
+              bytes of the fields
+    response  u32 size of the rest of the frame
+              u32 id of the request
+              u32 AnalysisError, 0 for a unit
+              bytes of the unit, as from formatAnalysisXML(), or of the
+              diagnostic message
+
+  Requests on a connection may be sent without waiting for their responses,
+  which then arrive in the order they complete, not the order they were sent.
+  Beyond ServerOptions::maxBacklog, the server reads no more requests until
+  the client reads responses.
+*/
+
+/**
+ * Settings of the analysis server
+ */
+struct ServerOptions {
+    unsigned int workers = 0;       // threads generating units, 0 for the hardware concurrency
+    ResultCache* cache = nullptr;   // units of earlier requests, reused for unchanged files and content
+    std::size_t maxFrame = 256 * 1024 * 1024;   // largest request, larger closes the connection
+    std::size_t maxBacklog = 64 * 1024 * 1024;  // requests in progress and unsent responses of a connection,
+                                                // beyond which its requests wait in the socket
+};
+
+/**
+ * Server that keeps its threads, buffers, and cache warm between requests,
+ * so a request costs a round trip on a socket instead of a process
+ *
+ * A single thread accepts connections and reads requests with epoll. Worker
+ * threads generate the units and send the responses themselves, leaving any
+ * part the socket cannot take for the event thread to send when it can.
+ */
+class AnalysisServer {
+public:
+
+    /**
+     * Listen on a socket, replacing a stale socket file
+     *
+     * Only the user may connect, as requests may read any file the server can.
+     *
+     * @param path Path of the socket
+     * @param options Settings of the server
+     * @throw std::system_error if the socket cannot be created, another server is listening, or the path is another kind of file
+     */
+    explicit AnalysisServer(const std::string& path, const ServerOptions& options = ServerOptions());
+
+    /** Closes the connections, and removes the socket file */
+    ~AnalysisServer();
+
+    AnalysisServer(const AnalysisServer&) = delete;
+    AnalysisServer& operator=(const AnalysisServer&) = delete;
+
+    /**
+     * Handle connections until stop(), then wait for the requests in progress
+     *
+     * Responses not yet sent when stopped are dropped.
+     *
+     * @throw std::system_error if waiting for events fails
+     */
+    void run();
+
+    /**
+     * End run(). May be called from any thread, or a signal handler.
+     */
+    void stop();
+
+    /**
+     * Number of requests handled
+     */
+    std::size_t handled() const { return requests.load(); }
+
+private:
+
+    struct Connection;
+    using ConnectionPtr = std::shared_ptr<Connection>;
+
+    // accept waiting connections
+    void accept();
+
+    // read from the connection, and queue its complete requests
+    void receive(const ConnectionPtr& connection);
+
+    // queue the complete requests of the input, false for an invalid request
+    bool queueRequests(const ConnectionPtr& connection);
+
+    // send the unsent part of the responses
+    void flush(Connection& connection);
+
+    // generate and send the response to a request
+    void respond(Connection& connection, const std::string& frame);
+
+    // close the connection if it failed, or ended with all responses sent
+    void closeIfDone(const ConnectionPtr& connection);
+
+    void close(Connection& connection);
+
+    std::string path;
+    ServerOptions options;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> stopping{false};
+    std::atomic<std::size_t> requests{0};
+    std::unordered_map<int, ConnectionPtr> connections;
+    std::vector<char> readBuffer;
+
+    // last, so tasks complete before the rest is destroyed
+    ThreadPool pool;
+};
+
+/**
+ * Blocking client of an AnalysisServer, for a single thread
+ */
+class AnalysisClient {
+public:
+
+    /**
+     * @param path Path of the socket of the server
+     * @throw std::system_error if the server cannot be connected
+     */
+    explicit AnalysisClient(const std::string& path);
+
+    /** Closes the connection */
+    ~AnalysisClient();
+
+    AnalysisClient(const AnalysisClient&) = delete;
+    AnalysisClient& operator=(const AnalysisClient&) = delete;
+
+    /**
+     * Unit for a request, as from tryFormatAnalysisXML()
+     *
+     * @param request Data that forms the request
+     * @retval Source analysis XML, or the error of the request
+     * @throw std::system_error if the connection fails
+     */
+    AnalysisResult<std::string> analyze(const AnalysisRequestView& request);
+
+    /**
+     * Unit for a file read by the server, which skips reading an unchanged
+     * file with a cache
+     *
+     * @param request Data that forms the request, with the path in diskFilename,
+     *        except for the sourceCode
+     * @retval Source analysis XML, or the error of the request
+     * @throw std::system_error if the connection fails
+     */
+    AnalysisResult<std::string> analyzeFile(const AnalysisRequestView& request);
+
+    /**
+     * Send a request without waiting for its response
+     *
+     * @param request Data that forms the request
+     * @param id Id of the request, returned with its response
+     * @param readFile Whether the server reads the sourceCode from the diskFilename
+     * @throw std::system_error if the connection fails
+     */
+    void send(const AnalysisRequestView& request, std::uint32_t id, bool readFile = false);
+
+    /**
+     * Wait for the next response
+     *
+     * @param id Id of the request of the response
+     * @retval Source analysis XML, or the error of the request
+     * @throw std::system_error if the connection fails or is closed
+     */
+    AnalysisResult<std::string> receive(std::uint32_t& id);
+
+    /**
+     * Send no more requests. The responses to the requests sent are still
+     * received, and the server then closes the connection.
+     *
+     * @throw std::system_error if the connection fails
+     */
+    void finish();
+
+private:
+    int fd = -1;
+    std::string frame;
+};
+
+#endif
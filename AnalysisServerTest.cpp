@@ -0,0 +1,325 @@
+/*
+  @file AnalysisServerTest.cpp
+
+  Test program for AnalysisServer and AnalysisClient
+*/
+
+#include "AnalysisServer.hpp"
+#include "CodeAnalysis.hpp"
+#include "ResultCache.hpp"
+#include "SHA1.hpp"
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    AnalysisRequest makeRequest(const std::string& sourceCode, const std::string& diskFilename) {
+
+        AnalysisRequest request;
+        request.sourceCode   = sourceCode;
+        request.diskFilename = diskFilename;
+        request.optionLOC    = -1;
+        request.computeLOC   = true;
+        request.computeHash  = true;
+        request.optionURL    = "https://mlcollard.net/?a=1&b=2";
+
+        return request;
+    }
+
+    // socket connected to the server, for frames that the client does not send
+    int connectSocket(const std::string& path) {
+
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        path.copy(address.sun_path, path.size());
+        [[maybe_unused]] const int connected = ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+        assert(connected == 0);
+
+        return fd;
+    }
+
+    // server on its own thread for the lifetime of the object
+    struct RunningServer {
+        AnalysisServer server;
+        std::thread thread;
+
+        RunningServer(const std::string& path, const ServerOptions& options = ServerOptions())
+            : server(path, options), thread([this]{ server.run(); }) {}
+
+        ~RunningServer() {
+            server.stop();
+            thread.join();
+        }
+    };
+}
+
+int main() {
+
+    const std::filesystem::path root = "AnalysisServerTest.tree";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    const std::string path = (root / "server.sock").string();
+
+    // units match those generated directly, and invalid requests return their error
+    {
+        RunningServer running(path);
+        AnalysisClient client(path);
+
+        // only the user may connect
+        [[maybe_unused]] const auto permissions = std::filesystem::status(path).permissions();
+        assert(permissions == (std::filesystem::perms::owner_read | std::filesystem::perms::owner_write));
+
+        for (const auto& request : { makeRequest("if (a < b && c) a = b;\n", "main.cpp"),
+                                     makeRequest("", "empty.java"),
+                                     makeRequest("a = \"b\";\n", "dir/a\"b&<c>.cpp"),
+                                     makeRequest(std::string(3000000, 'x') + "<\n", "large.cpp") }) {
+            const auto result = client.analyze(request);
+            assert(result);
+            assert(result.value() == formatAnalysisXML(request));
+        }
+
+        const auto unsupported = client.analyze(makeRequest("a = b;\n", "notes.txt"));
+        assert(!unsupported);
+        assert(unsupported.error() == AnalysisError::EXTENSION);
+
+        const auto invalid = client.analyze(makeRequest("invalid \xFF\n", "main.cpp"));
+        assert(invalid.error() == AnalysisError::UTF8);
+
+        AnalysisRequest stdinRequest = makeRequest("a = b;\n", "-");
+        stdinRequest.entryFilename = "data";
+        assert(client.analyze(stdinRequest).error() == AnalysisError::STDIN_LANGUAGE);
+        stdinRequest.optionLanguage = "C++";
+        assert(client.analyze(stdinRequest).value() == formatAnalysisXML(stdinRequest));
+    }
+
+    // requests sent without waiting are answered by id, including responses larger than the socket buffers
+    {
+        RunningServer running(path);
+        AnalysisClient client(path);
+
+        std::vector<AnalysisRequest> requests;
+        for (int i = 0; i < 50; ++i) {
+            const std::string content = i % 10 == 0 ? std::string(1000000, '<') : "a = " + std::to_string(i) + ";\n";
+            requests.push_back(makeRequest(content, "file" + std::to_string(i) + ".cpp"));
+        }
+        for (std::uint32_t id = 0; id < requests.size(); ++id)
+            client.send(requests[id], id);
+
+        std::map<std::uint32_t, std::string> responses;
+        for (std::size_t i = 0; i < requests.size(); ++i) {
+            std::uint32_t id = 0;
+            auto result = client.receive(id);
+            assert(result);
+            responses[id] = std::move(result).value();
+        }
+        assert(responses.size() == requests.size());
+        for (std::uint32_t id = 0; id < requests.size(); ++id)
+            assert(responses[id] == formatAnalysisXML(requests[id]));
+        assert(running.server.handled() == requests.size());
+    }
+
+    // requests sent before the client stops sending are answered, then the connection is closed
+    {
+        RunningServer running(path);
+        AnalysisClient client(path);
+
+        std::vector<AnalysisRequest> requests;
+        for (int i = 0; i < 20; ++i)
+            requests.push_back(makeRequest(std::string(100000 * (i % 4 + 1), '<'), "file" + std::to_string(i) + ".cpp"));
+        for (std::uint32_t id = 0; id < requests.size(); ++id)
+            client.send(requests[id], id);
+        client.finish();
+
+        std::map<std::uint32_t, std::string> responses;
+        for (std::size_t i = 0; i < requests.size(); ++i) {
+            std::uint32_t id = 0;
+            auto result = client.receive(id);
+            responses[id] = std::move(result).value();
+        }
+        for (std::uint32_t id = 0; id < requests.size(); ++id)
+            assert(responses[id] == formatAnalysisXML(requests[id]));
+
+        [[maybe_unused]] bool closed = false;
+        try {
+            std::uint32_t id = 0;
+            client.receive(id);
+        } catch (const std::system_error&) {
+            closed = true;
+        }
+        assert(closed);
+    }
+
+    // a client that does not read its responses stops being read, instead of growing the server
+    {
+        ServerOptions options;
+        options.maxBacklog = 1024 * 1024;
+        RunningServer running(path, options);
+
+        // request of sourceCode "<" * 1000000 and diskFilename "big.cpp", with a response four times larger
+        const std::string sourceCode(1000000, '<');
+        const std::string diskFilename = "big.cpp";
+        std::string frame(16 + 4 * 10, '\0');
+        auto store = [&frame](std::size_t offset, std::uint32_t value) {
+            for (int i = 0; i < 4; ++i)
+                frame[offset + i] = static_cast<char>(value >> (8 * i));
+        };
+        store(0, static_cast<std::uint32_t>(frame.size() - 4 + sourceCode.size() + diskFilename.size()));
+        store(12, static_cast<std::uint32_t>(-1));
+        store(16, static_cast<std::uint32_t>(sourceCode.size()));
+        store(20, static_cast<std::uint32_t>(diskFilename.size()));
+        frame += sourceCode;
+        frame += diskFilename;
+
+        // send until the server stops reading
+        const int fd = connectSocket(path);
+        ::fcntl(fd, F_SETFL, O_NONBLOCK);
+        std::size_t total = 0;
+        const std::size_t limit = 40 * frame.size();
+        while (total < limit) {
+            const ssize_t count = ::send(fd, frame.data() + total % frame.size(), frame.size() - total % frame.size(), MSG_NOSIGNAL);
+            if (count > 0) {
+                total += static_cast<std::size_t>(count);
+                continue;
+            }
+            pollfd writable{ fd, POLLOUT, 0 };
+            if (::poll(&writable, 1, 500) == 0)
+                break;
+        }
+        assert(total < 8 * frame.size());
+        ::close(fd);
+
+        // other connections are still served
+        AnalysisClient client(path);
+        const AnalysisRequest request = makeRequest("a = b;\n", "main.cpp");
+        [[maybe_unused]] const std::string unit = client.analyze(request).value();
+        assert(unit == formatAnalysisXML(request));
+    }
+
+    // concurrent clients
+    {
+        RunningServer running(path);
+        std::vector<std::thread> clients;
+        for (int c = 0; c < 4; ++c) {
+            clients.emplace_back([&path, c]{
+                AnalysisClient client(path);
+                for (int i = 0; i < 100; ++i) {
+                    const AnalysisRequest request = makeRequest("a = " + std::to_string(c * 1000 + i) + ";\n", "main.cpp");
+                    assert(client.analyze(request).value() == formatAnalysisXML(request));
+                }
+            });
+        }
+        for (auto& client : clients)
+            client.join();
+    }
+
+    // files read by the server, and reused from the cache while unchanged
+    {
+        const std::string source = (root / "main.cpp").string();
+        std::ofstream(source, std::ios::binary) << "if (a < b) a = b;\n";
+        const AnalysisRequest expected = makeRequest("if (a < b) a = b;\n", source);
+        AnalysisRequest request = expected;
+        request.sourceCode.clear();
+
+        ResultCache cache((root / "cache").string());
+        ServerOptions options;
+        options.cache = &cache;
+        RunningServer running(path, options);
+        AnalysisClient client(path);
+        assert(client.analyzeFile(request).value() == formatAnalysisXML(expected));
+
+        // a stored unit is used instead of reading the unchanged file
+        const auto key = ResultCache::key(request, sha1Hex(expected.sourceCode));
+        std::ofstream(root / "cache" / "units" / std::string(key.data(), key.size()), std::ios::binary) << "<code:unit>marked</code:unit>\n";
+        const std::string marked = client.analyzeFile(request).value();
+        assert(marked.find(R"(<code:unit xmlns:code="http://mlcollard.net/code">marked</code:unit>)") != std::string::npos);
+
+        // content sent in the request shares the cache
+        [[maybe_unused]] const std::string shared = client.analyze(expected).value();
+        assert(shared == marked);
+
+        AnalysisRequest missing = request;
+        missing.diskFilename = (root / "missing.cpp").string();
+        const auto unreadable = client.analyzeFile(missing);
+        assert(unreadable.error() == AnalysisError::UNREADABLE);
+    }
+
+    // invalid frames close the connection, without affecting other connections
+    {
+        RunningServer running(path);
+        AnalysisClient client(path);
+
+        const int fd = connectSocket(path);
+        const char frame[] = { 1, 0, 0, 0, 'x' };
+        [[maybe_unused]] const ssize_t written = ::write(fd, frame, sizeof(frame));
+        assert(written == sizeof(frame));
+        char byte;
+        [[maybe_unused]] const ssize_t received = ::read(fd, &byte, 1);
+        assert(received == 0);
+        ::close(fd);
+
+        const AnalysisRequest request = makeRequest("a = b;\n", "main.cpp");
+        assert(client.analyze(request).value() == formatAnalysisXML(request));
+    }
+
+    // a second server cannot take over the socket, but replaces a stale socket file
+    {
+        {
+            RunningServer running(path);
+            [[maybe_unused]] bool thrown = false;
+            try {
+                AnalysisServer other(path);
+            } catch (const std::system_error&) {
+                thrown = true;
+            }
+            assert(thrown);
+        }
+        assert(!std::filesystem::exists(path));
+
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        path.copy(address.sun_path, path.size());
+        [[maybe_unused]] const int bound = ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+        assert(bound == 0);
+        ::close(fd);
+        assert(std::filesystem::exists(path));
+
+        RunningServer running(path);
+        AnalysisClient client(path);
+        const AnalysisRequest request = makeRequest("a = b;\n", "main.java");
+        assert(client.analyze(request).value() == formatAnalysisXML(request));
+    }
+
+    // a file that is not a socket is never replaced
+    {
+        std::ofstream(path) << "not a socket\n";
+        [[maybe_unused]] bool thrown = false;
+        try {
+            AnalysisServer other(path);
+        } catch (const std::system_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        std::ifstream in(path);
+        [[maybe_unused]] std::string line;
+        std::getline(in, line);
+        assert(line == "not a socket");
+        std::filesystem::remove(path);
+    }
+
+    std::filesystem::remove_all(root);
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+/*
+  @file BinaryUnits.cpp
+
+  Implementation of the binary format of analysis units
+*/
+
+#include "BinaryUnits.hpp"
+#include <stdexcept>
+
+namespace {
+
+    constexpr std::string_view HEADER_MAGIC("CAUNITS\0", 8);
+    constexpr std::string_view TRAILER_MAGIC("CAINDEX\0", 8);
+    constexpr std::uint32_t VERSION = 1;
+
+    constexpr std::size_t HEADER_SIZE = 16;
+    constexpr std::size_t RECORD_HEADER_SIZE = 48;
+    constexpr std::size_t TRAILER_SIZE = 24;
+
+    // number of variable-size fields before the content
+    constexpr std::size_t FIELD_COUNT = 5;
+
+    // append an integer in little-endian order
+    template<typename Integer>
+    void appendInteger(std::string& out, Integer value) {
+
+        const auto bits = static_cast<std::uint64_t>(value);
+        for (std::size_t i = 0; i < sizeof(Integer); ++i)
+            out += static_cast<char>((bits >> (8 * i)) & 0xFF);
+    }
+
+    // integer in little-endian order
+    template<typename Integer>
+    Integer readInteger(std::string_view data, std::size_t offset) {
+
+        std::uint64_t bits = 0;
+        for (std::size_t i = 0; i < sizeof(Integer); ++i)
+            bits |= std::uint64_t(static_cast<unsigned char>(data[offset + i])) << (8 * i);
+
+        return static_cast<Integer>(bits);
+    }
+
+    // size rounded up to a multiple of 8
+    std::uint64_t aligned(std::uint64_t size) {
+
+        return (size + 7) & ~std::uint64_t(7);
+    }
+
+    [[noreturn]] void invalid() {
+
+        throw std::runtime_error("Invalid binary units");
+    }
+}
+
+/**
+ * Append the record of a unit
+ *
+ * @param unit Metadata and content of the unit
+ * @param out String the record is appended to
+ */
+void appendBinaryUnit(const BinaryUnit& unit, std::string& out) {
+
+    const std::string_view fields[FIELD_COUNT] = { unit.language, unit.filename, unit.url, unit.hash, unit.timestamp };
+    std::uint64_t size = RECORD_HEADER_SIZE + unit.content.size();
+    for (const auto field : fields)
+        size += field.size();
+    const std::uint64_t recordSize = aligned(size);
+
+    out.reserve(out.size() + recordSize);
+    appendInteger<std::uint64_t>(out, recordSize);
+    appendInteger<std::uint64_t>(out, unit.content.size());
+    appendInteger<std::int64_t>(out, unit.loc);
+    for (const auto field : fields)
+        appendInteger<std::uint32_t>(out, static_cast<std::uint32_t>(field.size()));
+    appendInteger<std::uint32_t>(out, 0);
+    for (const auto field : fields)
+        out.append(field);
+    out.append(unit.content);
+    out.append(recordSize - size, '\0');
+}
+
+/**
+ * Write the header
+ *
+ * @param sink Destination of the units. Must outlive the writer.
+ */
+BinaryUnitWriter::BinaryUnitWriter(OutputSink& sink)
+    : sink(sink) {
+
+    std::string header(HEADER_MAGIC);
+    appendInteger<std::uint32_t>(header, VERSION);
+    appendInteger<std::uint32_t>(header, 0);
+    sink.write(header);
+    position = header.size();
+}
+
+/**
+ * Write the record of a unit
+ *
+ * @param record Record from appendBinaryUnit()
+ */
+void BinaryUnitWriter::add(std::string_view record) {
+
+    offsets.push_back(position);
+    sink.write(record);
+    position += record.size();
+}
+
+/**
+ * Write the index and trailer. The sink is not flushed.
+ *
+ * @retval Number of units
+ */
+std::size_t BinaryUnitWriter::finish() {
+
+    std::string index;
+    index.reserve(offsets.size() * 8 + TRAILER_SIZE);
+    for (const auto offset : offsets)
+        appendInteger<std::uint64_t>(index, offset);
+    appendInteger<std::uint64_t>(index, position);
+    appendInteger<std::uint64_t>(index, offsets.size());
+    index.append(TRAILER_MAGIC);
+    sink.write(index);
+    position += index.size();
+
+    return offsets.size();
+}
+
+/**
+ * @param data Complete binary units
+ * @throw std::runtime_error if the header, index, or trailer is invalid
+ */
+BinaryUnitReader::BinaryUnitReader(std::string_view data)
+    : data(data) {
+
+    if (data.size() < HEADER_SIZE + TRAILER_SIZE || data.substr(0, HEADER_MAGIC.size()) != HEADER_MAGIC
+        || readInteger<std::uint32_t>(data, HEADER_MAGIC.size()) != VERSION
+        || data.substr(data.size() - TRAILER_MAGIC.size()) != TRAILER_MAGIC)
+        invalid();
+
+    const std::uint64_t trailer = data.size() - TRAILER_SIZE;
+    const auto offset = readInteger<std::uint64_t>(data, trailer);
+    const auto units = readInteger<std::uint64_t>(data, trailer + 8);
+    if (offset < HEADER_SIZE || offset > trailer || (trailer - offset) / 8 != units || (trailer - offset) % 8 != 0)
+        invalid();
+
+    indexOffset = static_cast<std::size_t>(offset);
+    count = static_cast<std::size_t>(units);
+}
+
+/**
+ * Unit by its position, in constant time
+ *
+ * @param index Position of the unit, less than size()
+ * @retval Metadata and content of the unit
+ * @throw std::runtime_error if the record is invalid
+ */
+BinaryUnit BinaryUnitReader::operator[](std::size_t index) const {
+
+    if (index >= count)
+        throw std::out_of_range("Unit past the end of the index");
+
+    // records lie between the header and the index
+    const auto offset = readInteger<std::uint64_t>(data, indexOffset + 8 * index);
+    if (offset < HEADER_SIZE || offset > indexOffset || indexOffset - offset < RECORD_HEADER_SIZE)
+        invalid();
+    const auto recordSize = readInteger<std::uint64_t>(data, offset);
+    if (recordSize < RECORD_HEADER_SIZE || recordSize > indexOffset - offset)
+        invalid();
+
+    std::uint64_t sizes[FIELD_COUNT + 1];
+    std::uint64_t total = RECORD_HEADER_SIZE;
+    for (std::size_t i = 0; i < FIELD_COUNT; ++i) {
+        sizes[i] = readInteger<std::uint32_t>(data, offset + 24 + 4 * i);
+        total += sizes[i];
+    }
+    sizes[FIELD_COUNT] = readInteger<std::uint64_t>(data, offset + 8);
+    if (sizes[FIELD_COUNT] > recordSize || total > recordSize - sizes[FIELD_COUNT])
+        invalid();
+
+    std::string_view fields[FIELD_COUNT + 1];
+    std::size_t position = static_cast<std::size_t>(offset + RECORD_HEADER_SIZE);
+    for (std::size_t i = 0; i <= FIELD_COUNT; ++i) {
+        fields[i] = data.substr(position, static_cast<std::size_t>(sizes[i]));
+        position += fields[i].size();
+    }
+
+    BinaryUnit unit;
+    unit.language = fields[0];
+    unit.filename = fields[1];
+    unit.url = fields[2];
+    unit.hash = fields[3];
+    unit.timestamp = fields[4];
+    unit.loc = readInteger<std::int64_t>(data, offset + 16);
+    unit.content = fields[FIELD_COUNT];
+
+    return unit;
+}
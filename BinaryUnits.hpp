@@ -0,0 +1,127 @@
+/*
+  @file BinaryUnits.hpp
+
+  Compact binary format of analysis units, with an index for random access
+*/
+
+#ifndef INCLUDED_BINARYUNITS_HPP
+#define INCLUDED_BINARYUNITS_HPP
+
+#include "OutputSink.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+  Layout, with all integers little endian, and each part starting at a multiple of 8 bytes:
+
+    header    "CAUNITS\0", u32 version, u32 reserved
+    units     for each unit:
+                u64 size of the record, including padding
+                u64 size of the content
+                i64 loc, or -1 for none
+                u32 sizes of the language, filename, url, hash, and timestamp
+                u32 reserved
+                bytes of the language, filename, url, hash, timestamp, and content
+                zero padding
+    index     u64 offset of each unit from the start
+    trailer   u64 offset of the index, u64 number of units, "CAINDEX\0"
+
+  Content is raw, not escaped, so a memory-mapped file is used in place.
+*/
+
+/**
+ * Metadata and content of a unit, as in the attributes and content of its XML
+ *
+ * Empty fields are absent from the XML.
+ */
+struct BinaryUnit {
+    std::string_view language;
+    std::string_view filename;
+    std::string_view url;
+    std::string_view hash;
+    std::string_view timestamp;
+    std::int64_t loc = -1;      // -1 for none
+    std::string_view content;
+};
+
+/**
+ * Append the record of a unit
+ *
+ * @param unit Metadata and content of the unit
+ * @param out String the record is appended to
+ */
+void appendBinaryUnit(const BinaryUnit& unit, std::string& out);
+
+/**
+ * Writer of binary units to a sink
+ *
+ * Records are written as they are added, and the index when finished.
+ */
+class BinaryUnitWriter {
+public:
+
+    /**
+     * Write the header
+     *
+     * @param sink Destination of the units. Must outlive the writer.
+     */
+    explicit BinaryUnitWriter(OutputSink& sink);
+
+    /**
+     * Write the record of a unit
+     *
+     * @param record Record from appendBinaryUnit()
+     */
+    void add(std::string_view record);
+
+    /**
+     * Write the index and trailer. The sink is not flushed.
+     *
+     * @retval Number of units
+     */
+    std::size_t finish();
+
+private:
+    OutputSink& sink;
+    std::uint64_t position = 0;
+    std::vector<std::uint64_t> offsets;
+};
+
+/**
+ * Random access to the units of binary data, e.g., a memory-mapped SourceFile
+ *
+ * Units refer to the data, which must outlive them.
+ */
+class BinaryUnitReader {
+public:
+
+    /**
+     * @param data Complete binary units
+     * @throw std::runtime_error if the header, index, or trailer is invalid
+     */
+    explicit BinaryUnitReader(std::string_view data);
+
+    /**
+     * Number of units
+     */
+    std::size_t size() const { return count; }
+
+    /**
+     * Unit by its position, in constant time
+     *
+     * @param index Position of the unit, less than size()
+     * @retval Metadata and content of the unit
+     * @throw std::runtime_error if the record is invalid
+     */
+    BinaryUnit operator[](std::size_t index) const;
+
+private:
+    std::string_view data;
+    std::size_t indexOffset = 0;
+    std::size_t count = 0;
+};
+
+#endif
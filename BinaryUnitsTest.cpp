@@ -0,0 +1,115 @@
+/*
+  @file BinaryUnitsTest.cpp
+
+  Test program for binary units
+*/
+
+#include "BinaryUnits.hpp"
+#include <stdexcept>
+#include <string>
+#include <cassert>
+
+int main() {
+
+    // units are read back by position, with records aligned
+    {
+        BinaryUnit first;
+        first.language = "C++";
+        first.filename = "main.cpp";
+        first.hash = "0123456789abcdef0123456789abcdef01234567";
+        first.loc = 2;
+        first.content = "a < b;\n&\n";
+
+        BinaryUnit second;
+        second.language = "Java";
+        second.url = "https://mlcollard.net";
+        second.timestamp = "2024-01-01";
+        second.content = std::string_view("\0raw\xE2\x82\xAC", 7);
+
+        std::string record;
+        std::string data;
+        StringSink sink(data);
+        BinaryUnitWriter writer(sink);
+        appendBinaryUnit(first, record);
+        assert(record.size() % 8 == 0);
+        writer.add(record);
+        record.clear();
+        appendBinaryUnit(second, record);
+        writer.add(record);
+        [[maybe_unused]] const std::size_t units = writer.finish();
+        assert(units == 2);
+        assert(data.size() % 8 == 0);
+
+        const BinaryUnitReader reader(data);
+        assert(reader.size() == 2);
+
+        [[maybe_unused]] const BinaryUnit unit = reader[1];
+        assert(unit.language == "Java");
+        assert(unit.filename.empty());
+        assert(unit.url == "https://mlcollard.net");
+        assert(unit.hash.empty());
+        assert(unit.timestamp == "2024-01-01");
+        assert(unit.loc == -1);
+        assert(unit.content == second.content);
+
+        [[maybe_unused]] const BinaryUnit other = reader[0];
+        assert(other.language == "C++" && other.filename == "main.cpp");
+        assert(other.hash == first.hash);
+        assert(other.loc == 2);
+        assert(other.content == "a < b;\n&\n");
+
+        [[maybe_unused]] bool thrown = false;
+        try {
+            reader[2];
+        } catch (const std::out_of_range&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+
+    // no units
+    {
+        std::string data;
+        StringSink sink(data);
+        BinaryUnitWriter writer(sink);
+        [[maybe_unused]] const std::size_t units = writer.finish();
+        assert(units == 0);
+        assert(BinaryUnitReader(data).size() == 0);
+    }
+
+    // truncated or damaged data is invalid
+    {
+        BinaryUnit unit;
+        unit.language = "C";
+        unit.content = "x;\n";
+        std::string record;
+        appendBinaryUnit(unit, record);
+
+        std::string data;
+        StringSink sink(data);
+        BinaryUnitWriter writer(sink);
+        writer.add(record);
+        writer.finish();
+
+        [[maybe_unused]] auto invalid = [](std::string_view binary, bool access) {
+            try {
+                const BinaryUnitReader reader(binary);
+                if (access)
+                    reader[0];
+            } catch (const std::runtime_error&) {
+                return true;
+            }
+            return false;
+        };
+        assert(!invalid(data, true));
+        assert(invalid(std::string_view(data).substr(0, data.size() - 1), false));
+        assert(invalid("CAUNITS", false));
+
+        // content size past the record
+        std::string damaged = data;
+        damaged[16 + 8] = '\x7F';
+        assert(invalid(damaged, true));
+    }
+
+    return 0;
+}
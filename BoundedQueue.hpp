@@ -0,0 +1,97 @@
+/*
+  @file BoundedQueue.hpp
+
+  Queue between pipeline stages with a limited capacity
+*/
+
+#ifndef INCLUDED_BOUNDEDQUEUE_HPP
+#define INCLUDED_BOUNDEDQUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/**
+ * Queue of items passed between threads, where producers wait while
+ * the queue is full, so a slow consumer slows the producers
+ *
+ * Once closed, consumers receive the remaining items, then no more.
+ */
+template<typename T>
+class BoundedQueue {
+public:
+
+    /**
+     * @param capacity Maximum number of items in the queue
+     */
+    explicit BoundedQueue(std::size_t capacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * Add an item, waiting while the queue is full
+     *
+     * @param item Item to add
+     * @retval false Queue is closed, and the item is not added
+     */
+    bool push(T item) {
+
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this]{ return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+
+        items.push_back(std::move(item));
+        lock.unlock();
+        notEmpty.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Remove the oldest item, waiting while the queue is empty
+     *
+     * @param item Destination of the item
+     * @retval false Queue is closed and empty
+     */
+    bool pop(T& item) {
+
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this]{ return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Close the queue, so no more items are added
+     */
+    void close() {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    const std::size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
+
+#endif
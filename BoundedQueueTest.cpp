@@ -0,0 +1,80 @@
+/*
+  @file BoundedQueueTest.cpp
+
+  Test program for BoundedQueue
+*/
+
+#include "BoundedQueue.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cassert>
+
+int main() {
+
+    // items in order
+    {
+        BoundedQueue<int> queue(3);
+        [[maybe_unused]] bool pushed = queue.push(1);
+        assert(pushed);
+        pushed = queue.push(2);
+        assert(pushed);
+        [[maybe_unused]] int item = 0;
+        [[maybe_unused]] bool popped = queue.pop(item);
+        assert(popped && item == 1);
+        popped = queue.pop(item);
+        assert(popped && item == 2);
+    }
+
+    // remaining items after closing, then none
+    {
+        BoundedQueue<int> queue(2);
+        [[maybe_unused]] bool pushed = queue.push(1);
+        assert(pushed);
+        queue.close();
+        pushed = queue.push(2);
+        assert(!pushed);
+        [[maybe_unused]] int item = 0;
+        [[maybe_unused]] bool popped = queue.pop(item);
+        assert(popped && item == 1);
+        popped = queue.pop(item);
+        assert(!popped);
+    }
+
+    // producers wait for a slow consumer, so the queue never exceeds its capacity
+    {
+        BoundedQueue<int> queue(4);
+        std::atomic<int> pushed{0};
+        std::thread producer([&]{
+            for (int i = 0; i < 1000; ++i) {
+                queue.push(i);
+                ++pushed;
+            }
+            queue.close();
+        });
+
+        int expected = 0;
+        int item = 0;
+        while (queue.pop(item)) {
+            assert(item == expected);
+            assert(pushed <= expected + 1 + 4);
+            ++expected;
+        }
+        assert(expected == 1000);
+        producer.join();
+    }
+
+    // closing wakes waiting producers
+    {
+        BoundedQueue<int> queue(1);
+        queue.push(0);
+        std::thread producer([&]{
+            [[maybe_unused]] const bool pushed = queue.push(1);
+            assert(!pushed);
+        });
+        queue.close();
+        producer.join();
+    }
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+  @file CPUFeatures.cpp
+
+  Implementation of runtime detection of processor features
+*/
+
+#include "CPUFeatures.hpp"
+
+#if defined(CODEANALYSIS_X86_64)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(CODEANALYSIS_ARM64_CRYPTO) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace {
+
+#if defined(CODEANALYSIS_X86_64)
+
+    // registers from cpuid for the leaf and subleaf
+    struct CPUID {
+        unsigned int eax = 0;
+        unsigned int ebx = 0;
+        unsigned int ecx = 0;
+        unsigned int edx = 0;
+    };
+
+    CPUID cpuid(unsigned int leaf, unsigned int subleaf) {
+
+        CPUID registers;
+#if defined(_MSC_VER)
+        int values[4];
+        __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+        registers.eax = static_cast<unsigned int>(values[0]);
+        registers.ebx = static_cast<unsigned int>(values[1]);
+        registers.ecx = static_cast<unsigned int>(values[2]);
+        registers.edx = static_cast<unsigned int>(values[3]);
+#else
+        if (__get_cpuid_max(0, nullptr) < leaf)
+            return registers;
+        __cpuid_count(leaf, subleaf, registers.eax, registers.ebx, registers.ecx, registers.edx);
+#endif
+        return registers;
+    }
+
+    // operating system saves the SSE and AVX register state
+    bool osSavesAVXState() {
+
+        // OSXSAVE
+        if (!(cpuid(1, 0).ecx & (1u << 27)))
+            return false;
+
+#if defined(_MSC_VER)
+        const unsigned long long xcr0 = _xgetbv(0);
+#else
+        unsigned int low = 0;
+        unsigned int high = 0;
+        __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+        const unsigned long long xcr0 = (static_cast<unsigned long long>(high) << 32) | low;
+#endif
+        return (xcr0 & 0x6) == 0x6;
+    }
+
+#endif
+}
+
+/**
+ * Processor and operating system support AVX2
+ *
+ * @retval true AVX2 instructions may be used
+ */
+bool cpuHasAVX2() {
+
+#if defined(CODEANALYSIS_X86_64)
+    static const bool hasAVX2 = osSavesAVXState() && (cpuid(7, 0).ebx & (1u << 5));
+    return hasAVX2;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Processor supports the SHA-1 instructions, i.e., SHA-NI with SSE4.1
+ * on x86-64, or the ARMv8 cryptography extension on AArch64
+ *
+ * @retval true SHA-1 instructions may be used
+ */
+bool cpuHasSHA1() {
+
+#if defined(CODEANALYSIS_X86_64)
+    // SSSE3 and SSE4.1 for byte shuffles and lane extraction, and SHA
+    static const bool hasSHA1 = (cpuid(1, 0).ecx & ((1u << 9) | (1u << 19))) == ((1u << 9) | (1u << 19))
+                             && (cpuid(7, 0).ebx & (1u << 29));
+    return hasSHA1;
+#elif defined(CODEANALYSIS_ARM64_CRYPTO) && defined(__linux__)
+    static const bool hasSHA1 = getauxval(AT_HWCAP) & HWCAP_SHA1;
+    return hasSHA1;
+#elif defined(CODEANALYSIS_ARM64_CRYPTO)
+    // targeted at compile time
+    return true;
+#else
+    return false;
+#endif
+}
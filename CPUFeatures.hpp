@@ -0,0 +1,70 @@
+/*
+  @file CPUFeatures.hpp
+
+  Runtime detection of processor features for kernel dispatch,
+  and bit operations on the masks kernels produce
+*/
+
+#ifndef INCLUDED_CPUFEATURES_HPP
+#define INCLUDED_CPUFEATURES_HPP
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CODEANALYSIS_X86_64 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+#define CODEANALYSIS_ARM64_CRYPTO 1
+#endif
+
+/**
+ * Processor and operating system support AVX2
+ *
+ * @retval true AVX2 instructions may be used
+ */
+bool cpuHasAVX2();
+
+/**
+ * Processor supports the SHA-1 instructions, i.e., SHA-NI with SSE4.1
+ * on x86-64, or the ARMv8 cryptography extension on AArch64
+ *
+ * @retval true SHA-1 instructions may be used
+ */
+bool cpuHasSHA1();
+
+/**
+ * Index of the lowest set bit
+ *
+ * @param mask Non-zero mask
+ * @retval Index of the lowest set bit
+ */
+inline unsigned int lowestBit(unsigned int mask) {
+
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+/**
+ * Number of set bits
+ *
+ * @param mask Any mask
+ * @retval Number of set bits
+ */
+inline unsigned int countBits(unsigned int mask) {
+
+#if defined(_MSC_VER)
+    return __popcnt(mask);
+#else
+    return static_cast<unsigned int>(__builtin_popcount(mask));
+#endif
+}
+
+#endif
@@ -4,97 +4,1167 @@ Implementation of analysis requests
 */
 
 #include "CodeAnalysis.hpp"
+#include "BinaryUnits.hpp"
 #include "FilenameToLanguage.hpp"
 #include "XMLWrapper.hpp"
+#include "SHA1.hpp"
+#include "ContentScanner.hpp"
+#include "ThreadPool.hpp"
+#include "DirectoryWalker.hpp"
+#include "SourceFile.hpp"
+#include "TarReader.hpp"
+#include "Metrics.hpp"
+#include "XMLEscape.hpp"
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <system_error>
+#include <stdexcept>
+#include <cerrno>
+#include <cstdint>
+#include <climits>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
 
-/**
- * Generate source analysis XML based on the request
- * Content is wrapped with an XML element that includes the metadata
- *
- * @param request Data that forms the request
- * @retval Source analysis request in XML format
- * @retval Empty string if invalid
- */
-std::string formatAnalysisXML(const AnalysisRequest& request) {
+namespace {
 
-    // Check for missing language or unsupported extension
-    if (request.optionLanguage.empty() && request.diskFilename != "-") {
-        // Attempt to get the language based on the diskFilename
-        std::string_view language = filenameToLanguage(request.diskFilename);
-        if (language.empty()) {
-            std::cerr << "Extension not supported" << std::endl;
-            return "";
+    // size of the chunks streamed content is read in
+    constexpr std::size_t CHUNK_SIZE = 4 * ContentScanner::BLOCK_SIZE;
+
+    // scan the content of a file descriptor in chunks until its end
+    bool scanStream(int fd, ContentScanner& scanner) {
+
+        const std::unique_ptr<char[]> chunk(new char[CHUNK_SIZE]);
+        while (true) {
+            const ssize_t count = ::read(fd, chunk.get(), CHUNK_SIZE);
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::system_error(errno, std::generic_category(), "read");
+            }
+            if (count == 0)
+                return true;
+            if (!scanner.update(std::string_view(chunk.get(), static_cast<std::size_t>(count))))
+                return false;
         }
-        // If no language is provided, use the detected language
-        language = filenameToLanguage(request.diskFilename);
-    }
-    if (request.diskFilename == "-" && request.optionLanguage.empty()) {
-        std::cerr << "Using stdin requires a declared language" << std::endl;
-        return "";
     }
 
-    // Initialize language and determine its value with if-then logic
-    std::string_view language;
-    if (!request.optionLanguage.empty()) {
-        language = request.optionLanguage;
+    /**
+     * Start and end tags of a unit, with the escaped content only measured,
+     * for content escaped elsewhere
+     */
+    class FrameSink : public OutputSink {
+    public:
+
+        /**
+         * @param frame String the tags are appended to. Must outlive the sink.
+         */
+        explicit FrameSink(std::string& frame) : frame(frame) {}
+
+        void write(std::string_view data) override { frame.append(data); }
+
+        // the content is only measured, so in the same pass as its scan
+        bool measuring() const override { return true; }
+
+        // content is measured before the start tag, so the last write, of no content, is its position
+        void writeEscaped(std::string_view content) override {
+
+            contentStart = frame.size();
+            escaped += escapedSize(content);
+        }
+
+        /**
+         * Size of the start tag, where the content belongs
+         */
+        std::size_t contentPosition() const { return contentStart; }
+
+        /**
+         * Size of the escaped content
+         */
+        std::size_t contentSize() const { return escaped; }
+
+    private:
+        std::string& frame;
+        std::size_t contentStart = 0;
+        std::size_t escaped = 0;
+    };
+
+    /**
+     * Escape content at the start of a buffer in place, moving it to an offset
+     *
+     * Works backward a block at a time, so each byte is moved before its
+     * position is overwritten.
+     *
+     * @param data Buffer with the content at its start, with room for the escaped content at the offset
+     * @param size Size of the content
+     * @param offset Position of the escaped content
+     * @param escaped Size of the escaped content
+     */
+    void escapeInPlace(char* data, std::size_t size, std::size_t offset, std::size_t escaped) {
+
+        std::vector<std::size_t> specials;
+        std::size_t end = size;
+        std::size_t destination = offset + escaped;
+        while (end > 0) {
+
+            // positions of the characters to escape in the block
+            const std::size_t begin = end > ContentScanner::BLOCK_SIZE ? end - ContentScanner::BLOCK_SIZE : 0;
+            const std::string_view block(data + begin, end - begin);
+            specials.clear();
+            for (std::size_t pos = findEscape(block); pos != block.size(); ) {
+                specials.push_back(begin + pos);
+                pos += 1 + findEscape(block.substr(pos + 1));
+            }
+
+            // move each run after a character, then its entity
+            std::size_t runEnd = end;
+            for (auto special = specials.rbegin(); special != specials.rend(); ++special) {
+                const std::size_t run = runEnd - (*special + 1);
+                destination -= run;
+                std::memmove(data + destination, data + *special + 1, run);
+
+                const std::string_view entity = escapeEntity(data[*special]);
+                destination -= entity.size();
+                std::memcpy(data + destination, entity.data(), entity.size());
+                runEnd = *special;
+            }
+            destination -= runEnd - begin;
+            std::memmove(data + destination, data + begin, runEnd - begin);
+
+            end = begin;
+        }
     }
-    if (language.empty()) {
-        language = filenameToLanguage(request.diskFilename);
+
+    /**
+     * Language from the option, or from the extension of the entry filename for
+     * archives, and of the disk filename otherwise
+     *
+     * @param request Data that forms the request
+     * @param error Set to the reason when the language cannot be determined
+     * @retval Language of the unit
+     * @retval Empty if it cannot be determined
+     */
+    std::string_view resolveLanguage(const AnalysisRequestView& request, AnalysisError& error) {
+
+        if (!request.optionLanguage.empty())
+            return request.optionLanguage;
+
+        const bool archive = !request.entryFilename.empty() && !(request.diskFilename == "-" && request.entryFilename == "data");
+        if (!archive && request.diskFilename == "-") {
+            error = AnalysisError::STDIN_LANGUAGE;
+            CODEANALYSIS_METRIC_ADD(ERRORS_STDIN_LANGUAGE, 1);
+            return std::string_view();
+        }
+        const std::string_view language = filenameToLanguage(archive ? request.entryFilename : request.diskFilename);
+        if (language.empty()) {
+            error = AnalysisError::EXTENSION;
+            CODEANALYSIS_METRIC_ADD(ERRORS_EXTENSION, 1);
+        }
+
+        return language;
     }
-    if (language.empty()) {
-        if (request.diskFilename.empty()) {
-            std::cerr << "Using stdin requires a declared language" << std::endl;
-            return "";
+
+    /**
+     * Filename of the unit, empty for none
+     *
+     * @param request Data that forms the request
+     * @retval Filename of the unit
+     */
+    std::string_view resolveFilename(const AnalysisRequestView& request) {
+
+        // Initialize filename and determine its value with if-then logic
+        std::string_view filename = request.diskFilename;
+        if (!request.optionFilename.empty()) {
+            filename = request.optionFilename;
+        }
+        // Special case for stdin input with diskFilename as "-" and entryFilename as "data"
+        if (request.diskFilename == "-" && request.entryFilename == "data" && !request.optionFilename.empty()) {
+            filename = request.optionFilename; // Use optionFilename in this case
+        }
+        if (filename == "-" && !request.entryFilename.empty()) {
+            filename = request.entryFilename;
         }
-        std::cerr << "Extension not supported" << std::endl;
-        return "";
+        if (!request.entryFilename.empty() && filename == request.diskFilename) {
+            filename = request.entryFilename;
+        }
+
+        return filename;
     }
 
-    // Initialize filename and determine its value with if-then logic
-    std::string_view filename = request.diskFilename;
-    if (!request.optionFilename.empty()) {
-        filename = request.optionFilename;
+    /**
+     * Report the error of an invalid request to std::cerr, for the functions
+     * without an error result
+     *
+     * @param error Error of the request
+     * @retval true Valid request
+     * @retval false Invalid request
+     */
+    bool reported(AnalysisError error) {
+
+        if (error == AnalysisError::NONE)
+            return true;
+
+        std::cerr << analysisErrorMessage(error) << '\n';
+
+        return false;
     }
-    // Special case for stdin input with diskFilename as "-" and entryFilename as "data"
-    if (request.diskFilename == "-" && request.entryFilename == "data" && !request.optionFilename.empty()) {
-        filename = request.optionFilename; // Use optionFilename in this case
+
+    /**
+     * Log of the diagnostics of a batch, reported to std::cerr once the batch
+     * is complete when the caller provides no log
+     */
+    class BatchDiagnostics {
+    public:
+
+        /**
+         * @param log Log of the caller, or nullptr for none
+         */
+        explicit BatchDiagnostics(DiagnosticLog* log) : log(log ? log : &own) {}
+
+        ~BatchDiagnostics() {
+
+            if (log == &own) {
+                try {
+                    own.report(std::cerr);
+                } catch (...) {}
+            }
+        }
+
+        BatchDiagnostics(const BatchDiagnostics&) = delete;
+        BatchDiagnostics& operator=(const BatchDiagnostics&) = delete;
+
+        DiagnosticLog& operator*() { return *log; }
+        DiagnosticLog* operator->() { return log; }
+
+    private:
+        DiagnosticLog own;
+        DiagnosticLog* log;
+    };
+
+    // largest content generated into a staging string for sinks that cannot take back output,
+    // with larger content scanned before it is written so memory stays bounded
+    constexpr std::size_t STAGED_CONTENT_LIMIT = 1024 * 1024;
+
+    /**
+     * Values of a unit that do not depend on the content
+     */
+    struct UnitStart {
+        std::string_view language;
+        std::string_view filename;
+        bool computeHash = false;   // hash computed from the content
+        bool computeLOC = false;    // LOC computed from the content
+    };
+
+    /**
+     * Resolve the values of the unit for the request that do not depend on the content
+     *
+     * @param request Data that forms the request
+     * @param start Set to the values of the unit
+     * @retval AnalysisError::NONE Values resolved
+     * @retval Error of an invalid request
+     */
+    AnalysisError resolveUnit(const AnalysisRequestView& request, UnitStart& start) {
+
+        start.language = request.optionLanguage;
+        if (start.language.empty()) {
+            CODEANALYSIS_METRIC_TIMER(LANGUAGE);
+            AnalysisError error = AnalysisError::NONE;
+            start.language = resolveLanguage(request, error);
+            if (start.language.empty())
+                return error;
+        }
+
+        {
+            CODEANALYSIS_METRIC_TIMER(FILENAME);
+            start.filename = resolveFilename(request);
+        }
+
+        // Hash and LOC not provided are computed from the content
+        start.computeHash = request.optionHash.empty() && request.computeHash;
+        start.computeLOC = request.optionLOC < 0 && request.computeLOC;
+
+        return AnalysisError::NONE;
     }
-    if (filename == "-" && !request.entryFilename.empty()) {
-        filename = request.entryFilename;
+
+    /**
+     * Add the attributes of the unit to its start tag
+     *
+     * @param unit Unit with its start tag open
+     * @param request Data that forms the request
+     * @param start Values of the unit
+     * @param loc Computed LOC, when computed
+     * @param hash Computed hash, when computed
+     */
+    void addUnitAttributes(XMLWrapper& unit, const AnalysisRequestView& request, const UnitStart& start, std::string_view loc, std::string_view hash) {
+
+        CODEANALYSIS_METRIC_TIMER(ATTRIBUTES);
+
+        // Output attributes
+        unit.addAttribute("language", start.language);
+        if (!start.filename.empty()) {
+            unit.addAttribute("filename", start.filename);
+        }
+        if (!request.timestamp.empty()) {
+            unit.addAttribute("timestamp", request.timestamp);
+        }
+        if (request.optionLOC >= 0) {
+            unit.addAttribute("loc", std::to_string(request.optionLOC));
+        } else if (start.computeLOC) {
+            unit.addAttribute("loc", loc);
+        }
+        if (!request.optionURL.empty()) {
+            unit.addAttribute("url", request.optionURL);
+        }
+        if (!request.sourceURL.empty() && request.optionURL.empty()) {
+            unit.addAttribute("url", request.sourceURL);
+        }
+        if (!request.optionHash.empty()) {
+            unit.addAttribute("hash", request.optionHash);
+        } else if (start.computeHash) {
+            unit.addAttribute("hash", hash);
+        }
     }
-    if (!request.entryFilename.empty() && filename == request.diskFilename) {
-        filename = request.entryFilename;
+
+    /**
+     * Generate the unit for the request into a reused string, in a single
+     * pass over the content
+     *
+     * The content is hashed, counted, validated, and escaped into the string
+     * in one pass after the start tag. A computed LOC and hash are written as
+     * placeholders, with room for the most digits the content allows, and are
+     * backpatched with the exact values once the content is scanned.
+     *
+     * @param request Data that forms the request
+     * @param out String the XML replaces, empty if invalid
+     * @param scope Whether the unit is a document or nested in an archive
+     * @retval AnalysisError::NONE Unit generated
+     * @retval Error of an invalid request
+     */
+    template<typename String>
+    AnalysisError formatUnitInto(const AnalysisRequestView& request, String& out, XMLWrapper::Scope scope) {
+
+        CODEANALYSIS_METRIC_TIMER(UNIT);
+
+        out.clear();
+
+        UnitStart start;
+        const AnalysisError error = resolveUnit(request, start);
+        if (error != AnalysisError::NONE)
+            return error;
+
+        // there are no more lines than bytes, so the LOC placeholder has room for any count
+        const std::string locPlaceholder(start.computeLOC ? std::to_string(request.sourceCode.size()).size() : 0, '0');
+        const std::string hashPlaceholder(start.computeHash ? SHA1::HEX_SIZE : 0, '0');
+
+        const XMLWrapper::Tags& tags = scope == XMLWrapper::DOCUMENT ? CODE_UNIT_DOCUMENT : CODE_UNIT_FRAGMENT;
+        BasicStringSink<String> sink(out);
+        XMLWrapper unit(tags, sink);
+        addUnitAttributes(unit, request, start, locPlaceholder, hashPlaceholder);
+        unit.addContent("");
+
+        // storage for unescaped content, which grows only for the escaped characters
+        const std::size_t header = out.size();
+        out.reserve(header + request.sourceCode.size() + tags.end.size());
+
+        ContentScanner scanner(start.computeHash, start.computeLOC, &sink);
+        {
+            CODEANALYSIS_METRIC_TIMER(CONTENT);
+            if (!scanner.update(request.sourceCode) || !scanner.finish()) {
+                out.clear();
+                CODEANALYSIS_METRIC_ADD(ERRORS_UTF8, 1);
+                return AnalysisError::UTF8;
+            }
+        }
+
+        unit.endElement();
+
+        // Attribute values are escaped, so a quote only starts a value. The hash is
+        // patched first, as removing unused LOC digits moves it.
+        const std::string_view startTag(out.data(), header);
+        if (start.computeHash) {
+            const std::size_t pos = startTag.find(" hash=\"") + std::strlen(" hash=\"");
+            std::memcpy(out.data() + pos, scanner.hash().data(), scanner.hash().size());
+        }
+        if (start.computeLOC) {
+            const std::size_t pos = startTag.find(" loc=\"") + std::strlen(" loc=\"");
+            const std::string loc = std::to_string(scanner.lines());
+            std::memcpy(out.data() + pos, loc.data(), loc.size());
+            out.erase(pos + loc.size(), locPlaceholder.size() - loc.size());
+        }
+
+        CODEANALYSIS_METRIC_ADD(UNITS, 1);
+
+        return AnalysisError::NONE;
     }
 
-    // Create XML wrapper and add the starting element
-    XMLWrapper unit("code", "http://mlcollard.net/code");
-    unit.startElement("unit");
+    /**
+     * Write the unit for the request to a sink
+     *
+     * Nothing is written for content that is not valid UTF-8, and the
+     * attributes are exact. Content is generated into a staging string in a
+     * single pass, except for a measuring sink, which is passed the content
+     * as it is scanned, and for content over the staging limit, which is
+     * scanned before the start tag is written. Streamed content is only read
+     * once, so it cannot have a computed hash or LOC, and may be partly
+     * written when invalid.
+     *
+     * @param request Data that forms the request
+     * @param sink Destination of the XML
+     * @param scope Whether the unit is a document or nested in an archive
+     * @param fd Source of streamed content instead of the sourceCode, or -1
+     * @retval AnalysisError::NONE Unit written
+     * @retval Error of an invalid request
+     */
+    AnalysisError formatUnit(const AnalysisRequestView& request, OutputSink& sink, XMLWrapper::Scope scope, int fd = -1) {
+
+        if (fd < 0 && !sink.measuring() && request.sourceCode.size() <= STAGED_CONTENT_LIMIT) {
+            thread_local std::string staged;
+            const AnalysisError error = formatUnitInto(request, staged, scope);
+            if (error == AnalysisError::NONE)
+                sink.write(staged);
+
+            return error;
+        }
+
+        CODEANALYSIS_METRIC_TIMER(UNIT);
+
+        UnitStart start;
+        const AnalysisError error = resolveUnit(request, start);
+        if (error != AnalysisError::NONE)
+            return error;
+
+        if (fd >= 0 && (start.computeHash || start.computeLOC))
+            return AnalysisError::STREAMING_METADATA;
+
+        // A measuring sink counts the escaped content in the same pass, since only its size matters
+        SHA1::HexDigest hash{};
+        std::size_t lines = 0;
+        if (fd < 0) {
+            CODEANALYSIS_METRIC_TIMER(CONTENT);
+            ContentScanner scanner(start.computeHash, start.computeLOC, sink.measuring() ? &sink : nullptr);
+            if (!scanner.update(request.sourceCode) || !scanner.finish()) {
+                CODEANALYSIS_METRIC_ADD(ERRORS_UTF8, 1);
+                return AnalysisError::UTF8;
+            }
+            hash = scanner.hash();
+            lines = scanner.lines();
+        }
+
+        // Create XML wrapper and add the starting element
+        XMLWrapper unit(scope == XMLWrapper::DOCUMENT ? CODE_UNIT_DOCUMENT : CODE_UNIT_FRAGMENT, sink);
+        addUnitAttributes(unit, request, start, std::to_string(lines), std::string_view(hash.data(), hash.size()));
+
+        // Add the source code content, already checked unless streamed
+        unit.addContent("");
+        if (!sink.measuring()) {
+            CODEANALYSIS_METRIC_TIMER(CONTENT);
+            ContentScanner content(false, false, &sink, fd >= 0);
+            const bool valid = fd < 0 ? content.update(request.sourceCode) : scanStream(fd, content);
+            if (!valid || !content.finish()) {
+                CODEANALYSIS_METRIC_ADD(ERRORS_UTF8, 1);
+                return AnalysisError::UTF8;
+            }
+        }
+
+        unit.endElement();
+
+        if (!sink.measuring())
+            CODEANALYSIS_METRIC_ADD(UNITS, 1);
 
-    // Output attributes
-    unit.addAttribute("language", language);
-    if (!filename.empty()) {
-        unit.addAttribute("filename", filename);
+        return AnalysisError::NONE;
     }
-    if (!request.timestamp.empty()) {
-        unit.addAttribute("timestamp", request.timestamp);
+
+    /**
+     * Write an archive of the requests to a sink, generating units in parallel
+     *
+     * @param requests Data that forms each request
+     * @param sink Destination of the XML
+     * @param threads Number of threads generating units, 0 for the hardware concurrency
+     * @param diagnostics Log of invalid requests
+     * @retval Number of units written
+     */
+    template<typename Requests>
+    std::size_t formatArchive(const Requests& requests, OutputSink& sink, unsigned int threads, DiagnosticLog& diagnostics) {
+
+        // units generated by the pool, each written once complete
+        struct Unit {
+            std::string xml;
+            bool valid = false;
+            AnalysisError error = AnalysisError::NONE;
+            std::atomic<bool> complete{false};
+        };
+        const std::unique_ptr<Unit[]> units(new Unit[requests.size()]);
+
+        // the unit the writer is waiting for
+        std::atomic<std::size_t> writing{0};
+        std::mutex writerMutex;
+        std::condition_variable unitComplete;
+
+        // generate a single unit, waking the writer if it is waiting for it
+        auto generate = [&](std::size_t index) {
+
+            Unit& unit = units[index];
+            std::exception_ptr failure;
+            try {
+                unit.error = formatUnitInto(requests[index], unit.xml, XMLWrapper::FRAGMENT);
+                unit.valid = unit.error == AnalysisError::NONE;
+            } catch (...) {
+                failure = std::current_exception();
+            }
+
+            unit.complete.store(true);
+            if (writing.load() == index) {
+                {
+                    std::lock_guard<std::mutex> lock(writerMutex);
+                }
+                unitComplete.notify_one();
+            }
+
+            if (failure)
+                std::rethrow_exception(failure);
+        };
+
+        // split ranges so idle threads steal large halves, not single units
+        std::function<void(std::size_t, std::size_t)> generateRange;
+        ThreadPool pool(threads);
+        generateRange = [&](std::size_t first, std::size_t last) {
+
+            while (last - first > 1) {
+                const std::size_t middle = first + (last - first) / 2;
+                pool.submit([&generateRange, middle, last]{ generateRange(middle, last); });
+                last = middle;
+            }
+            generate(first);
+        };
+        if (!requests.empty())
+            pool.submit([&generateRange, &requests]{ generateRange(0, requests.size()); });
+
+        // archive unit contains the units
+        XMLWrapper archive(CODE_UNIT_DOCUMENT, sink);
+        archive.addContent("\n");
+
+        // write units in request order as they complete
+        std::size_t count = 0;
+        for (std::size_t index = 0; index < requests.size(); ++index) {
+
+            writing.store(index);
+            {
+                std::unique_lock<std::mutex> lock(writerMutex);
+                unitComplete.wait(lock, [&]{ return units[index].complete.load(); });
+            }
+
+            // diagnostics are logged in request order
+            if (!units[index].valid) {
+                if (units[index].error != AnalysisError::NONE)
+                    diagnostics.add(units[index].error, resolveFilename(requests[index]));
+                continue;
+            }
+
+            sink.write(units[index].xml);
+            std::string().swap(units[index].xml);
+            ++count;
+        }
+        pool.wait();
+
+        archive.endElement();
+
+        return count;
     }
-    if (request.optionLOC >= 0) {
-        unit.addAttribute("loc", std::to_string(request.optionLOC));
+}
+
+/**
+ * Generate source analysis XML based on the request
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * @param request Data that forms the request
+ * @retval Source analysis request in XML format
+ * @retval Empty string if invalid
+ */
+std::string formatAnalysisXML(const AnalysisRequestView& request) {
+
+    std::string xml;
+    formatAnalysisXMLInto(request, xml);
+
+    return xml;
+}
+
+/**
+ * Generate source analysis XML based on the request, without reporting errors
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * @param request Data that forms the request
+ * @retval Source analysis request in XML format
+ * @retval Error of an invalid request
+ */
+AnalysisResult<std::string> tryFormatAnalysisXML(const AnalysisRequestView& request) {
+
+    std::string xml;
+    const AnalysisError error = formatUnitInto(request, xml, XMLWrapper::DOCUMENT);
+    if (error != AnalysisError::NONE)
+        return error;
+
+    return xml;
+}
+
+/**
+ * Write source analysis XML based on the request to a sink, without reporting errors
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * @param request Data that forms the request
+ * @param sink Destination of the XML
+ * @retval AnalysisError::NONE Source analysis request written in XML format
+ * @retval Error of an invalid request
+ */
+AnalysisError tryFormatAnalysisXML(const AnalysisRequestView& request, OutputSink& sink) {
+
+    return formatUnit(request, sink, XMLWrapper::DOCUMENT);
+}
+
+/**
+ * Generate the source analysis XML unit for the request into a reused string,
+ * for nesting in an archive unit, without reporting errors
+ *
+ * @param request Data that forms the request
+ * @param out String the XML replaces, empty if invalid
+ * @retval AnalysisError::NONE Source analysis request generated in XML format
+ * @retval Error of an invalid request
+ */
+AnalysisError tryFormatAnalysisUnitXMLInto(const AnalysisRequestView& request, std::string& out) {
+
+    return formatUnitInto(request, out, XMLWrapper::FRAGMENT);
+}
+
+/**
+ * Generate source analysis XML based on the request, reusing the storage
+ * of its source code
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * @param request Data that forms the request
+ * @retval Source analysis request in XML format
+ * @retval Empty string if invalid
+ */
+std::string formatAnalysisXML(AnalysisRequest&& request) {
+
+    // tags with exact attributes, and the size of the escaped content
+    std::string frame;
+    FrameSink sink(frame);
+    if (!reported(formatUnit(request, sink, XMLWrapper::DOCUMENT)))
+        return std::string();
+    const std::size_t header = sink.contentPosition();
+    const std::size_t size = frame.size() + sink.contentSize();
+
+    // the unit is only measured by formatUnit(), so counted here
+    CODEANALYSIS_METRIC_ADD(UNITS, 1);
+    CODEANALYSIS_METRIC_ADD(CONTENT_BYTES_IN, request.sourceCode.size());
+    CODEANALYSIS_METRIC_ADD(CONTENT_BYTES_OUT, sink.contentSize());
+    CODEANALYSIS_METRIC_ADD(OUTPUT_BYTES, size);
+
+    // growing the buffer would copy the content, so escape it into new storage instead
+    if (request.sourceCode.capacity() < size) {
+        std::string xml;
+        xml.reserve(size);
+        xml.append(frame, 0, header);
+        StringSink(xml).writeEscaped(request.sourceCode);
+        xml.append(frame, header);
+
+        return xml;
     }
-    if (!request.optionURL.empty()) {
-        unit.addAttribute("url", request.optionURL);
+
+    std::string xml = std::move(request.sourceCode);
+    const std::size_t contentSize = xml.size();
+    xml.resize(size);
+    escapeInPlace(xml.data(), contentSize, header, sink.contentSize());
+    std::memcpy(xml.data(), frame.data(), header);
+    std::memcpy(xml.data() + header + sink.contentSize(), frame.data() + header, frame.size() - header);
+
+    return xml;
+}
+
+/**
+ * Exact size of the source analysis XML for the request,
+ * including the expansion from escaping
+ *
+ * @param request Data that forms the request
+ * @retval Number of characters formatAnalysisXML() produces
+ * @retval 0 if invalid
+ */
+std::size_t formatAnalysisXMLSize(const AnalysisRequestView& request) {
+
+    CountingSink counter;
+    if (!formatAnalysisXML(request, counter))
+        return 0;
+
+    return counter.size();
+}
+
+/**
+ * Generate source analysis XML based on the request into a reused string
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * @param request Data that forms the request
+ * @param out String the XML replaces, empty if invalid
+ * @retval true Source analysis request generated in XML format
+ * @retval false Invalid request
+ */
+bool formatAnalysisXMLInto(const AnalysisRequestView& request, std::string& out) {
+
+    return reported(formatUnitInto(request, out, XMLWrapper::DOCUMENT));
+}
+
+/**
+ * Generate the source analysis XML unit for the request into a reused string,
+ * for nesting in an archive unit
+ *
+ * @param request Data that forms the request
+ * @param out String the XML replaces, empty if invalid
+ * @retval true Source analysis request generated in XML format
+ * @retval false Invalid request
+ */
+bool formatAnalysisUnitXMLInto(const AnalysisRequestView& request, std::string& out) {
+
+    return reported(formatUnitInto(request, out, XMLWrapper::FRAGMENT));
+}
+
+/**
+ * Generate source analysis XML based on the request into a string
+ * allocated from a memory resource
+ *
+ * @param request Data that forms the request
+ * @param out String the XML replaces, empty if invalid
+ * @retval true Source analysis request generated in XML format
+ * @retval false Invalid request
+ */
+bool formatAnalysisXMLInto(const AnalysisRequestView& request, std::pmr::string& out) {
+
+    return reported(formatUnitInto(request, out, XMLWrapper::DOCUMENT));
+}
+
+/**
+ * Generate the source analysis XML unit for the request into a string
+ * allocated from a memory resource, for nesting in an archive unit
+ *
+ * @param request Data that forms the request
+ * @param out String the XML replaces, empty if invalid
+ * @retval true Source analysis request generated in XML format
+ * @retval false Invalid request
+ */
+bool formatAnalysisUnitXMLInto(const AnalysisRequestView& request, std::pmr::string& out) {
+
+    return reported(formatUnitInto(request, out, XMLWrapper::FRAGMENT));
+}
+
+/**
+ * Filename of the unit for the request, as in its filename attribute
+ *
+ * @param request Data that forms the request
+ * @retval Filename of the unit, empty for none
+ */
+std::string_view formatAnalysisFilename(const AnalysisRequestView& request) {
+
+    return resolveFilename(request);
+}
+
+/**
+ * Generate the binary unit for the request into a reused string
+ *
+ * @param request Data that forms the request
+ * @param out String the record replaces, empty if invalid
+ * @retval true Binary unit generated
+ * @retval false Invalid request
+ */
+bool formatAnalysisBinaryInto(const AnalysisRequestView& request, std::string& out) {
+
+    return reported(tryFormatAnalysisBinaryInto(request, out));
+}
+
+/**
+ * Generate the binary unit for the request into a reused string, without
+ * reporting errors
+ *
+ * @param request Data that forms the request
+ * @param out String the record replaces, empty if invalid
+ * @retval AnalysisError::NONE Binary unit generated
+ * @retval Error of an invalid request
+ */
+AnalysisError tryFormatAnalysisBinaryInto(const AnalysisRequestView& request, std::string& out) {
+
+    out.clear();
+
+    BinaryUnit unit;
+    AnalysisError error = AnalysisError::NONE;
+    unit.language = resolveLanguage(request, error);
+    if (unit.language.empty())
+        return error;
+    unit.filename = resolveFilename(request);
+    unit.url = !request.optionURL.empty() ? request.optionURL : request.sourceURL;
+    unit.timestamp = request.timestamp;
+    unit.content = request.sourceCode;
+
+    const bool computeHash = request.optionHash.empty() && request.computeHash;
+    const bool computeLOC = request.optionLOC < 0 && request.computeLOC;
+    ContentScanner metadata(computeHash, computeLOC, nullptr);
+    if (!metadata.update(request.sourceCode) || !metadata.finish()) {
+        CODEANALYSIS_METRIC_ADD(ERRORS_UTF8, 1);
+        return AnalysisError::UTF8;
     }
-    if (!request.sourceURL.empty() && request.optionURL.empty()) {
-        unit.addAttribute("url", request.sourceURL);
+    unit.hash = computeHash ? std::string_view(metadata.hash().data(), metadata.hash().size()) : request.optionHash;
+    if (request.optionLOC >= 0)
+        unit.loc = request.optionLOC;
+    else if (computeLOC)
+        unit.loc = static_cast<std::int64_t>(metadata.lines());
+
+    appendBinaryUnit(unit, out);
+
+    return AnalysisError::NONE;
+}
+
+/**
+ * Write an archive of source analysis XML for binary units to a sink
+ *
+ * @param binary Complete binary units
+ * @param sink Destination of the XML
+ * @retval Number of units written
+ * @throw std::runtime_error if the binary units are invalid
+ */
+std::size_t formatAnalysisBinaryXML(std::string_view binary, OutputSink& sink) {
+
+    const BinaryUnitReader reader(binary);
+
+    XMLWrapper archive(CODE_UNIT_DOCUMENT, sink);
+    archive.addContent("\n");
+
+    std::string xml;
+    std::size_t count = 0;
+    for (std::size_t index = 0; index < reader.size(); ++index) {
+        const BinaryUnit unit = reader[index];
+
+        // metadata is already resolved, so provided values reproduce it, except for a
+        // LOC past the range of optionLOC, which is counted again
+        AnalysisRequestView request;
+        request.sourceCode = unit.content;
+        request.diskFilename = unit.filename;
+        request.optionLanguage = unit.language;
+        request.optionURL = unit.url;
+        request.optionHash = unit.hash;
+        request.timestamp = unit.timestamp;
+        request.optionLOC = unit.loc <= INT_MAX ? static_cast<int>(unit.loc) : -1;
+        request.computeLOC = unit.loc > INT_MAX;
+        if (formatUnitInto(request, xml, XMLWrapper::FRAGMENT) != AnalysisError::NONE)
+            throw std::runtime_error("Invalid binary units");
+        sink.write(xml);
+        ++count;
+    }
+
+    archive.endElement();
+
+    return count;
+}
+
+/**
+ * Write source analysis XML based on the request to a sink
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * @param request Data that forms the request
+ * @param sink Destination of the XML
+ * @retval true Source analysis request written in XML format
+ * @retval false Invalid request
+ */
+bool formatAnalysisXML(const AnalysisRequestView& request, OutputSink& sink) {
+
+    return reported(formatUnit(request, sink, XMLWrapper::DOCUMENT));
+}
+
+/**
+ * Write source analysis XML for the request to a sink, with the content
+ * streamed from a file descriptor, e.g., stdin
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * @param request Data that forms the request, except for the sourceCode
+ * @param fd Source of the content, read until its end
+ * @param sink Destination of the XML
+ * @retval true Source analysis request written in XML format
+ * @retval false Invalid request
+ * @throw std::system_error on a failed read
+ */
+bool formatAnalysisXMLStream(const AnalysisRequestView& request, int fd, OutputSink& sink) {
+
+    return reported(formatUnit(request, sink, XMLWrapper::DOCUMENT, fd));
+}
+
+/**
+ * Write an archive of source analysis XML for the requests to a sink
+ * Each valid request forms a unit nested in an outer archive unit,
+ * in the order of the requests. Invalid requests are skipped.
+ *
+ * @param requests Data that forms each request
+ * @param sink Destination of the XML
+ * @param threads Number of threads generating units, 0 for the hardware concurrency
+ * @param diagnostics Log of invalid requests, or nullptr to report them to std::cerr once written
+ * @retval Number of units written
+ */
+std::size_t formatAnalysisArchiveXML(const std::vector<AnalysisRequest>& requests, OutputSink& sink, unsigned int threads, DiagnosticLog* diagnostics) {
+
+    BatchDiagnostics log(diagnostics);
+
+    return formatArchive(requests, sink, threads, *log);
+}
+
+/**
+ * Write an archive of source analysis XML for requests allocated from
+ * a memory resource to a sink
+ * Each valid request forms a unit nested in an outer archive unit,
+ * in the order of the requests. Invalid requests are skipped.
+ *
+ * @param requests Data that forms each request
+ * @param sink Destination of the XML
+ * @param threads Number of threads generating units, 0 for the hardware concurrency
+ * @param diagnostics Log of invalid requests, or nullptr to report them to std::cerr once written
+ * @retval Number of units written
+ */
+std::size_t formatAnalysisArchiveXML(const std::pmr::vector<PmrAnalysisRequest>& requests, OutputSink& sink, unsigned int threads, DiagnosticLog* diagnostics) {
+
+    BatchDiagnostics log(diagnostics);
+
+    return formatArchive(requests, sink, threads, *log);
+}
+
+/**
+ * Generate an archive of source analysis XML for the requests
+ * Each valid request forms a unit nested in an outer archive unit,
+ * in the order of the requests. Invalid requests are skipped.
+ *
+ * @param requests Data that forms each request
+ * @param threads Number of threads generating units, 0 for the hardware concurrency
+ * @retval Source analysis archive in XML format
+ */
+std::string formatAnalysisArchiveXML(const std::vector<AnalysisRequest>& requests, unsigned int threads) {
+
+    std::string xml;
+    StringSink sink(xml);
+    formatAnalysisArchiveXML(requests, sink, threads);
+
+    return xml;
+}
+
+/**
+ * Write an archive of source analysis XML for the source files under a directory
+ * Each file with a supported extension forms a unit nested in an outer archive unit.
+ *
+ * @param directory Root of the tree of source files
+ * @param sink Destination of the XML
+ * @param threads Number of threads walking the tree and generating units, 0 for the hardware concurrency
+ * @param diagnostics Log of unreadable and invalid files, or nullptr to report them to std::cerr once written
+ * @retval Number of units written
+ * @throw std::system_error if the directory cannot be opened
+ */
+std::size_t formatAnalysisDirectoryXML(const std::string& directory, OutputSink& sink, unsigned int threads, DiagnosticLog* diagnostics) {
+
+    BatchDiagnostics log(diagnostics);
+
+    // units are written by the thread that generates them
+    std::mutex sinkMutex;
+    std::size_t count = 0;
+    auto generate = [&](AnalysisRequest&& request) {
+
+        // reused by each file the thread generates
+        thread_local SourceFile file;
+        thread_local std::string xml;
+
+        try {
+            file.open(request.diskFilename);
+        } catch (const std::system_error& error) {
+            log->add(AnalysisError::UNREADABLE, "", error.what());
+            return;
+        }
+
+        AnalysisRequestView view(request);
+        view.sourceCode = file.content();
+        const AnalysisError error = formatUnitInto(view, xml, XMLWrapper::FRAGMENT);
+        file.close();
+        if (error != AnalysisError::NONE) {
+            log->add(error, resolveFilename(view));
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(sinkMutex);
+        sink.write(xml);
+        ++count;
+    };
+
+    ThreadPool pool(threads);
+    std::optional<XMLWrapper> archive;
+    {
+        // units wait for the start of the archive unit, written only once the root is open
+        std::lock_guard<std::mutex> lock(sinkMutex);
+        walkDirectory(directory, pool, generate, *log);
+        archive.emplace(CODE_UNIT_DOCUMENT, sink);
+        archive->addContent("\n");
     }
-    if (!request.optionHash.empty()) {
-        unit.addAttribute("hash", request.optionHash);
+    pool.wait();
+
+    archive->endElement();
+
+    return count;
+}
+
+/**
+ * Generate an archive of source analysis XML for the source files under a directory
+ * Each file with a supported extension forms a unit nested in an outer archive unit.
+ *
+ * @param directory Root of the tree of source files
+ * @param threads Number of threads walking the tree and generating units, 0 for the hardware concurrency
+ * @retval Source analysis archive in XML format
+ * @throw std::system_error if the directory cannot be opened
+ */
+std::string formatAnalysisDirectoryXML(const std::string& directory, unsigned int threads) {
+
+    std::string xml;
+    StringSink sink(xml);
+    formatAnalysisDirectoryXML(directory, sink, threads);
+
+    return xml;
+}
+
+/**
+ * Write an archive of source analysis XML for the entries of a tar archive
+ * Each regular file with a supported extension forms a unit nested in an outer archive unit.
+ *
+ * @param fd Open tar archive, optionally gzip compressed
+ * @param diskFilename Filename of the tar archive, "-" for stdin
+ * @param sink Destination of the XML
+ * @param diagnostics Log of invalid entries, or nullptr to report them to std::cerr once written
+ * @retval Number of units written
+ * @throw std::runtime_error for an invalid archive
+ * @throw std::system_error on a failed read
+ */
+std::size_t formatAnalysisTarXML(int fd, const std::string& diskFilename, OutputSink& sink, DiagnosticLog* diagnostics) {
+
+    BatchDiagnostics log(diagnostics);
+    TarReader reader(fd);
+
+    XMLWrapper archive(CODE_UNIT_DOCUMENT, sink);
+    archive.addContent("\n");
+
+    // entries are read only when their extension is supported
+    std::size_t count = 0;
+    std::string xml;
+    while (reader.next()) {
+        if (filenameToLanguage(reader.name()).empty())
+            continue;
+
+        AnalysisRequestView request;
+        request.sourceCode = reader.content();
+        request.diskFilename = diskFilename;
+        request.entryFilename = reader.name();
+        request.optionLOC = -1;
+        const AnalysisError error = formatUnitInto(request, xml, XMLWrapper::FRAGMENT);
+        if (error != AnalysisError::NONE) {
+            log->add(error, resolveFilename(request));
+            continue;
+        }
+
+        sink.write(xml);
+        ++count;
     }
 
-    // Add the source code content and end the element
-    unit.addContent(request.sourceCode);
-    unit.endElement();
+    archive.endElement();
+
+    return count;
+}
+
+/**
+ * Write the records of changed source files, for nesting in an archive unit
+ *
+ * @param changes Paths of the files, each updated or removed
+ * @param defaults Fields of every request, e.g., optionURL
+ * @param sink Destination of the XML
+ * @param threads Number of threads generating units, 0 for the hardware concurrency
+ * @param diagnostics Log of unreadable and invalid files, or nullptr to report them to std::cerr once written
+ * @retval Number of records written
+ */
+std::size_t formatAnalysisChangesXML(const std::vector<FileChange>& changes, const AnalysisRequest& defaults, OutputSink& sink,
+                                     unsigned int threads, DiagnosticLog* diagnostics) {
+
+    BatchDiagnostics log(diagnostics);
+
+    // units of a batch of the changes are held until the batch is written, so a large batch is bounded
+    constexpr std::size_t CHANGES_PER_BATCH = 256;
+    struct Record {
+        std::string xml;
+        AnalysisError error = AnalysisError::NONE;
+        std::string readError;
+        bool missing = false;
+    };
+    std::vector<Record> records(std::min(CHANGES_PER_BATCH, changes.size()));
+
+    ThreadPool pool(threads);
+    std::size_t count = 0;
+    for (std::size_t first = 0; first < changes.size(); first += CHANGES_PER_BATCH) {
+
+        const std::size_t last = std::min(first + CHANGES_PER_BATCH, changes.size());
+        for (std::size_t index = first; index < last; ++index) {
+            if (changes[index].removed)
+                continue;
+
+            pool.submit([&changes, &defaults, &record = records[index - first], index]{
+
+                // reused by each file the thread generates
+                thread_local SourceFile file;
+
+                record.error = AnalysisError::NONE;
+                record.missing = false;
+                try {
+                    // just changed, so possibly still being written
+                    file.open(changes[index].path, SourceFile::READ_ALL);
+                } catch (const std::system_error& error) {
+                    record.error = AnalysisError::UNREADABLE;
+                    record.readError = error.what();
+                    record.missing = error.code() == std::errc::no_such_file_or_directory;
+                    return;
+                }
+
+                AnalysisRequestView request(defaults);
+                request.diskFilename = changes[index].path;
+                request.sourceCode = file.content();
+                record.error = formatUnitInto(request, record.xml, XMLWrapper::FRAGMENT);
+                file.close();
+            });
+        }
+        pool.wait();
+
+        // diagnostics are logged in the order of the changes
+        for (std::size_t index = first; index < last; ++index) {
+
+            const Record& record = records[index - first];
+            if (!changes[index].removed && record.error == AnalysisError::NONE) {
+                sink.write(record.xml);
+                ++count;
+                continue;
+            }
+
+            AnalysisRequestView request(defaults);
+            request.diskFilename = changes[index].path;
+            if (!changes[index].removed && !record.missing) {
+                if (record.error == AnalysisError::UNREADABLE)
+                    log->add(record.error, "", record.readError);
+                else
+                    log->add(record.error, resolveFilename(request));
+            }
+
+            XMLWrapper tombstone("code", "http://mlcollard.net/code", sink, XMLWrapper::FRAGMENT);
+            tombstone.startElement("delete");
+            tombstone.addAttribute("filename", resolveFilename(request));
+            tombstone.endElement();
+            ++count;
+        }
+    }
 
-    return unit.xml();
-}
\ No newline at end of file
+    return count;
+}
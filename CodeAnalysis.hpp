@@ -8,7 +8,13 @@
 #define INCLUDED_CODEANALYSIS_HPP
 
 #include "AnalysisRequest.hpp"
+#include "AnalysisError.hpp"
+#include "OutputSink.hpp"
+#include "FileChange.hpp"
 #include <string_view>
+#include <cstddef>
+#include <vector>
+#include <memory_resource>
 
 /**
  * Generate source analysis XML based on the request
@@ -18,6 +24,320 @@
  * @retval Source analysis request in XML format
  * @retval Empty string if invalid
  */
-std::string formatAnalysisXML(const AnalysisRequest& request);
+std::string formatAnalysisXML(const AnalysisRequestView& request);
+
+/**
+ * Generate source analysis XML based on the request, without reporting errors
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * The functions without an error result report the error of an invalid
+ * request to std::cerr. These return it instead, so callers can tell an
+ * error from empty output, and collect errors, e.g., in a DiagnosticLog.
+ *
+ * @param request Data that forms the request
+ * @retval Source analysis request in XML format
+ * @retval Error of an invalid request
+ */
+AnalysisResult<std::string> tryFormatAnalysisXML(const AnalysisRequestView& request);
+
+/**
+ * Write source analysis XML based on the request to a sink, without reporting errors
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * Nothing is written for an invalid request. The sink is not flushed.
+ *
+ * @param request Data that forms the request
+ * @param sink Destination of the XML
+ * @retval AnalysisError::NONE Source analysis request written in XML format
+ * @retval Error of an invalid request
+ */
+AnalysisError tryFormatAnalysisXML(const AnalysisRequestView& request, OutputSink& sink);
+
+/**
+ * Generate source analysis XML based on the request, reusing the storage
+ * of its source code
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * When the capacity of the source code holds the XML, the content is
+ * escaped in place and the start tag is placed before it, so the buffer
+ * becomes the XML without another allocation, and the source code is moved
+ * from. Otherwise the XML is generated into storage allocated once at its
+ * exact size, as growing the buffer would copy the content anyway.
+ *
+ * @param request Data that forms the request
+ * @retval Source analysis request in XML format
+ * @retval Empty string if invalid
+ */
+std::string formatAnalysisXML(AnalysisRequest&& request);
+
+/**
+ * Write source analysis XML based on the request to a sink
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * Nothing is written for an invalid request. The sink is not flushed.
+ *
+ * @param request Data that forms the request
+ * @param sink Destination of the XML
+ * @retval true Source analysis request written in XML format
+ * @retval false Invalid request
+ */
+bool formatAnalysisXML(const AnalysisRequestView& request, OutputSink& sink);
+
+/**
+ * Exact size of the source analysis XML for the request,
+ * including the expansion from escaping
+ *
+ * @param request Data that forms the request
+ * @retval Number of characters formatAnalysisXML() produces
+ * @retval 0 if invalid
+ */
+std::size_t formatAnalysisXMLSize(const AnalysisRequestView& request);
+
+/**
+ * Generate source analysis XML based on the request into a reused string
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * The output replaces the contents of the string, generated in a single
+ * pass over the content. Storage is reserved for the unescaped content, so
+ * a string reused across calls stops allocating once it holds the largest unit.
+ *
+ * @param request Data that forms the request
+ * @param out String the XML replaces, empty if invalid
+ * @retval true Source analysis request generated in XML format
+ * @retval false Invalid request
+ */
+bool formatAnalysisXMLInto(const AnalysisRequestView& request, std::string& out);
+
+/**
+ * Write source analysis XML for the request to a sink, with the content
+ * streamed from a file descriptor, e.g., stdin
+ * Content is wrapped with an XML element that includes the metadata
+ *
+ * The content is read in fixed-size chunks, and each chunk is escaped into
+ * the sink before the next is read, so memory is constant for any size of
+ * input. Chunks may split UTF-8 characters. Since the content is only read
+ * once, after the start tag, it cannot have a computed hash or LOC.
+ * Content before invalid UTF-8 may already be written. The sink is not flushed.
+ *
+ * @param request Data that forms the request, except for the sourceCode
+ * @param fd Source of the content, read until its end
+ * @param sink Destination of the XML
+ * @retval true Source analysis request written in XML format
+ * @retval false Invalid request
+ * @throw std::system_error on a failed read
+ */
+bool formatAnalysisXMLStream(const AnalysisRequestView& request, int fd, OutputSink& sink);
+
+/**
+ * Generate the source analysis XML unit for the request into a reused string,
+ * for nesting in an archive unit
+ *
+ * The unit has no XML declaration, and uses the namespace declared by the
+ * archive unit, as in formatAnalysisArchiveXML().
+ *
+ * @param request Data that forms the request
+ * @param out String the XML replaces, empty if invalid
+ * @retval true Source analysis request generated in XML format
+ * @retval false Invalid request
+ */
+bool formatAnalysisUnitXMLInto(const AnalysisRequestView& request, std::string& out);
+
+/**
+ * Generate the source analysis XML unit for the request into a reused string,
+ * for nesting in an archive unit, without reporting errors
+ *
+ * @param request Data that forms the request
+ * @param out String the XML replaces, empty if invalid
+ * @retval AnalysisError::NONE Source analysis request generated in XML format
+ * @retval Error of an invalid request
+ */
+AnalysisError tryFormatAnalysisUnitXMLInto(const AnalysisRequestView& request, std::string& out);
+
+/**
+ * Generate source analysis XML based on the request into a string
+ * allocated from a memory resource
+ *
+ * A batch can allocate its requests and their output from a single
+ * monotonic arena, and release them all at once.
+ *
+ * @param request Data that forms the request
+ * @param out String the XML replaces, empty if invalid
+ * @retval true Source analysis request generated in XML format
+ * @retval false Invalid request
+ */
+bool formatAnalysisXMLInto(const AnalysisRequestView& request, std::pmr::string& out);
+
+/**
+ * Generate the source analysis XML unit for the request into a string
+ * allocated from a memory resource, for nesting in an archive unit
+ *
+ * @param request Data that forms the request
+ * @param out String the XML replaces, empty if invalid
+ * @retval true Source analysis request generated in XML format
+ * @retval false Invalid request
+ */
+bool formatAnalysisUnitXMLInto(const AnalysisRequestView& request, std::pmr::string& out);
+
+/**
+ * Filename of the unit for the request, as in its filename attribute
+ *
+ * @param request Data that forms the request
+ * @retval Filename of the unit, empty for none
+ */
+std::string_view formatAnalysisFilename(const AnalysisRequestView& request);
+
+/**
+ * Generate the binary unit for the request into a reused string,
+ * for a BinaryUnitWriter
+ *
+ * The record has the same metadata as the XML unit, with the content
+ * unescaped. See BinaryUnits.hpp for the format.
+ *
+ * @param request Data that forms the request
+ * @param out String the record replaces, empty if invalid
+ * @retval true Binary unit generated
+ * @retval false Invalid request
+ */
+bool formatAnalysisBinaryInto(const AnalysisRequestView& request, std::string& out);
+
+/**
+ * Generate the binary unit for the request into a reused string,
+ * for a BinaryUnitWriter, without reporting errors
+ *
+ * @param request Data that forms the request
+ * @param out String the record replaces, empty if invalid
+ * @retval AnalysisError::NONE Binary unit generated
+ * @retval Error of an invalid request
+ */
+AnalysisError tryFormatAnalysisBinaryInto(const AnalysisRequestView& request, std::string& out);
+
+/**
+ * Write an archive of source analysis XML for binary units to a sink
+ *
+ * The archive is the same as formatAnalysisArchiveXML() generates for
+ * the requests of the units. The sink is not flushed.
+ *
+ * @param binary Complete binary units
+ * @param sink Destination of the XML
+ * @retval Number of units written
+ * @throw std::runtime_error if the binary units are invalid
+ */
+std::size_t formatAnalysisBinaryXML(std::string_view binary, OutputSink& sink);
+
+/**
+ * Write an archive of source analysis XML for the requests to a sink
+ * Each valid request forms a unit nested in an outer archive unit,
+ * in the order of the requests. Invalid requests are skipped.
+ *
+ * Units are generated in parallel, and written in order as they complete.
+ * Diagnostics of invalid requests are added to the log in request order,
+ * or without a log, reported to std::cerr in a single write once the
+ * archive is written. The sink is not flushed.
+ *
+ * @param requests Data that forms each request
+ * @param sink Destination of the XML
+ * @param threads Number of threads generating units, 0 for the hardware concurrency
+ * @param diagnostics Log of invalid requests, or nullptr to report them to std::cerr once written
+ * @retval Number of units written
+ */
+std::size_t formatAnalysisArchiveXML(const std::vector<AnalysisRequest>& requests, OutputSink& sink, unsigned int threads = 0,
+                                     DiagnosticLog* diagnostics = nullptr);
+
+/**
+ * Write an archive of source analysis XML for requests allocated from
+ * a memory resource to a sink
+ * Each valid request forms a unit nested in an outer archive unit,
+ * in the order of the requests. Invalid requests are skipped.
+ *
+ * @param requests Data that forms each request
+ * @param sink Destination of the XML
+ * @param threads Number of threads generating units, 0 for the hardware concurrency
+ * @param diagnostics Log of invalid requests, or nullptr to report them to std::cerr once written
+ * @retval Number of units written
+ */
+std::size_t formatAnalysisArchiveXML(const std::pmr::vector<PmrAnalysisRequest>& requests, OutputSink& sink, unsigned int threads = 0,
+                                     DiagnosticLog* diagnostics = nullptr);
+
+/**
+ * Generate an archive of source analysis XML for the requests
+ * Each valid request forms a unit nested in an outer archive unit,
+ * in the order of the requests. Invalid requests are skipped.
+ *
+ * @param requests Data that forms each request
+ * @param threads Number of threads generating units, 0 for the hardware concurrency
+ * @retval Source analysis archive in XML format
+ */
+std::string formatAnalysisArchiveXML(const std::vector<AnalysisRequest>& requests, unsigned int threads = 0);
+
+/**
+ * Write an archive of source analysis XML for the source files under a directory
+ * Each file with a supported extension forms a unit nested in an outer archive unit.
+ *
+ * The tree is walked in parallel, and each unit is written as soon as it is
+ * generated, so units are in the order they complete. Files that cannot be
+ * read, or are invalid requests, are skipped, with their diagnostics logged
+ * as for formatAnalysisArchiveXML(). The sink is not flushed.
+ *
+ * @param directory Root of the tree of source files
+ * @param sink Destination of the XML
+ * @param threads Number of threads walking the tree and generating units, 0 for the hardware concurrency
+ * @param diagnostics Log of unreadable and invalid files, or nullptr to report them to std::cerr once written
+ * @retval Number of units written
+ * @throw std::system_error if the directory cannot be opened
+ */
+std::size_t formatAnalysisDirectoryXML(const std::string& directory, OutputSink& sink, unsigned int threads = 0,
+                                       DiagnosticLog* diagnostics = nullptr);
+
+/**
+ * Generate an archive of source analysis XML for the source files under a directory
+ * Each file with a supported extension forms a unit nested in an outer archive unit.
+ *
+ * @param directory Root of the tree of source files
+ * @param threads Number of threads walking the tree and generating units, 0 for the hardware concurrency
+ * @retval Source analysis archive in XML format
+ * @throw std::system_error if the directory cannot be opened
+ */
+std::string formatAnalysisDirectoryXML(const std::string& directory, unsigned int threads = 0);
+
+/**
+ * Write an archive of source analysis XML for the entries of a tar archive
+ * Each regular file with a supported extension forms a unit nested in an outer archive unit,
+ * in the order of the entries.
+ *
+ * The tar archive is streamed, so it may be a pipe. Entries are passed to
+ * the analysis without being extracted, and those with unsupported
+ * extensions are skipped without being read. Invalid requests are skipped,
+ * with their diagnostics logged as for formatAnalysisArchiveXML().
+ * The sink is not flushed.
+ *
+ * @param fd Open tar archive, optionally gzip compressed
+ * @param diskFilename Filename of the tar archive, "-" for stdin
+ * @param sink Destination of the XML
+ * @param diagnostics Log of invalid entries, or nullptr to report them to std::cerr once written
+ * @retval Number of units written
+ * @throw std::runtime_error for an invalid archive
+ * @throw std::system_error on a failed read
+ */
+std::size_t formatAnalysisTarXML(int fd, const std::string& diskFilename, OutputSink& sink, DiagnosticLog* diagnostics = nullptr);
+
+/**
+ * Write the records of changed source files, for nesting in an archive unit
+ *
+ * An update is the unit of the file, the same as in the archive of its
+ * directory. A removal is a tombstone, an empty code:delete element with the
+ * path of the file as its filename. A file that no longer forms a unit, e.g., that became
+ * invalid UTF-8 or was removed before it was read, is a tombstone as well.
+ * Units are generated in parallel, and the records are written in the order
+ * of the changes. The sink is not flushed.
+ *
+ * @param changes Paths of the files, each updated or removed
+ * @param defaults Fields of every request, e.g., optionURL
+ * @param sink Destination of the XML
+ * @param threads Number of threads generating units, 0 for the hardware concurrency
+ * @param diagnostics Log of unreadable and invalid files, or nullptr to report them to std::cerr once written
+ * @retval Number of records written
+ */
+std::size_t formatAnalysisChangesXML(const std::vector<FileChange>& changes, const AnalysisRequest& defaults, OutputSink& sink,
+                                     unsigned int threads = 0, DiagnosticLog* diagnostics = nullptr);
 
 #endif
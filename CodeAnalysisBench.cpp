@@ -0,0 +1,387 @@
+/*
+  @file CodeAnalysisBench.cpp
+
+  Benchmarks of code analysis, reported as JSON
+
+  Microbenchmarks cover escaping at different densities of special
+  characters, attribute-heavy requests, language lookup, small and
+  huge units, and round trips of small units to the analysis server. Corpus benchmarks run the analysis pipeline over a
+  generated repository.
+
+  Usage: CodeAnalysisBench [--filter=TEXT] [--min-time=SECONDS]
+                           [--corpus-files=N] [--corpus-bytes=N]
+*/
+
+#include "AnalysisPipeline.hpp"
+#include "AnalysisServer.hpp"
+#include "CodeAnalysis.hpp"
+#include "CPUFeatures.hpp"
+#include "FilenameToLanguage.hpp"
+#include "XMLWrapper.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+    // allocations by the process, from the replaced operator new
+    std::atomic<std::size_t> allocationCount{0};
+
+    // keeps results from being optimized away
+    volatile std::size_t resultSink = 0;
+
+    // measurements of a single benchmark
+    struct Result {
+        std::string name;
+        std::size_t operations = 0;
+        double nsPerOp = 0;
+        double bytesPerSecond = 0;
+        double allocationsPerOp = 0;
+        double p50 = 0;
+        double p99 = 0;
+    };
+
+    // settings from the command line
+    struct Settings {
+        std::string filter;
+        double minTime = 0.5;
+        std::size_t corpusFiles = 2000;
+        std::size_t corpusBytes = 64 * 1024 * 1024;
+    };
+
+    /**
+     * Time repeated calls of a benchmark, until the minimum time passes
+     *
+     * @param name Name of the benchmark
+     * @param settings Minimum time to run
+     * @param operationsPerCall Number of operations each call performs
+     * @param bytesPerCall Number of bytes of input each call processes
+     * @param call Performs the operations
+     * @retval Measurements per operation, with latency percentiles per operation
+     */
+    Result measure(const std::string& name, const Settings& settings, std::size_t operationsPerCall,
+                   std::size_t bytesPerCall, const std::function<void()>& call) {
+
+        using Clock = std::chrono::steady_clock;
+
+        // warm caches, and reused buffers
+        call();
+
+        std::vector<double> samples;
+        const std::size_t allocationsBefore = allocationCount.load();
+        const auto start = Clock::now();
+        auto now = start;
+        while (std::chrono::duration<double>(now - start).count() < settings.minTime || samples.size() < 5) {
+            const auto before = Clock::now();
+            call();
+            now = Clock::now();
+            samples.push_back(std::chrono::duration<double, std::nano>(now - before).count() / static_cast<double>(operationsPerCall));
+        }
+        const std::size_t allocations = allocationCount.load() - allocationsBefore;
+        const double seconds = std::chrono::duration<double>(now - start).count();
+
+        Result result;
+        result.name = name;
+        result.operations = samples.size() * operationsPerCall;
+        result.nsPerOp = seconds * 1e9 / static_cast<double>(result.operations);
+        result.bytesPerSecond = static_cast<double>(bytesPerCall * samples.size()) / seconds;
+        result.allocationsPerOp = static_cast<double>(allocations) / static_cast<double>(result.operations);
+
+        std::sort(samples.begin(), samples.end());
+        result.p50 = samples[samples.size() / 2];
+        result.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+
+        return result;
+    }
+
+    /**
+     * Generated source code
+     *
+     * @param size Number of bytes
+     * @param density Fraction of characters that are escaped, i.e., <, >, and &
+     * @param seed Seed of the random characters
+     */
+    std::string generateSource(std::size_t size, double density, unsigned int seed) {
+
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        const std::string_view plain = "abcdefghijklmnopqrstuvwxyz_ (){};=+-*/0123456789";
+        const std::string_view special = "<>&";
+
+        std::string source;
+        source.reserve(size);
+        while (source.size() < size) {
+            if (source.size() % 64 == 63)
+                source += '\n';
+            else if (chance(random) < density)
+                source += special[random() % special.size()];
+            else
+                source += plain[random() % plain.size()];
+        }
+
+        return source;
+    }
+
+    /**
+     * Generate a repository of source files, in directories of 100 files
+     *
+     * @param root Directory of the repository
+     * @param files Number of files
+     * @param bytes Total size of the files
+     */
+    void generateCorpus(const std::filesystem::path& root, std::size_t files, std::size_t bytes) {
+
+        const char* const extensions[] = { ".cpp", ".hpp", ".c", ".h", ".java", ".cs", ".txt" };
+        std::mt19937 random(42);
+
+        // file sizes vary around the average, as in real repositories
+        const std::size_t average = std::max<std::size_t>(bytes / std::max<std::size_t>(files, 1), 1);
+        std::uniform_int_distribution<std::size_t> sizes(average / 4, average * 7 / 4);
+
+        for (std::size_t i = 0; i < files; ++i) {
+            const std::filesystem::path directory = root / ("dir" + std::to_string(i / 100));
+            if (i % 100 == 0)
+                std::filesystem::create_directories(directory);
+            const std::string name = "file" + std::to_string(i) + extensions[random() % std::size(extensions)];
+            std::ofstream(directory / name, std::ios::binary) << generateSource(sizes(random), 0.01, static_cast<unsigned int>(i));
+        }
+    }
+
+    // request as from a typical run with all metadata
+    AnalysisRequest makeRequest(std::string sourceCode) {
+
+        AnalysisRequest request;
+        request.sourceCode      = std::move(sourceCode);
+        request.diskFilename    = "src/analysis/fragment.cpp";
+        request.sourceURL       = "https://mlcollard.net/src/analysis/fragment.cpp";
+        request.optionLOC       = -1;
+        request.timestamp       = "Thu Oct 31 12:15:00 2024";
+
+        return request;
+    }
+
+    // escape a request's content into a reused string through XMLWrapper::addContent
+    void runEscaping(const std::string& content, std::string& out) {
+
+        out.clear();
+        StringSink sink(out);
+        XMLWrapper unit("code", "http://mlcollard.net/code", sink);
+        unit.startElement("unit");
+        unit.addContent(content);
+        unit.endElement();
+        resultSink = resultSink + out.size();
+    }
+
+    // write a result as a JSON object
+    void writeJSON(std::ostream& out, const Result& result) {
+
+        out << "    {\"name\": \"" << result.name << "\""
+            << ", \"operations\": " << result.operations
+            << ", \"ns_per_op\": " << result.nsPerOp
+            << ", \"bytes_per_second\": " << result.bytesPerSecond
+            << ", \"allocations_per_op\": " << result.allocationsPerOp
+            << ", \"p50_ns\": " << result.p50
+            << ", \"p99_ns\": " << result.p99 << "}";
+    }
+}
+
+void* operator new(std::size_t size) {
+
+    ++allocationCount;
+    if (void* memory = std::malloc(size > 0 ? size : 1))
+        return memory;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+
+    std::free(memory);
+}
+
+int main(int argc, char* argv[]) {
+
+    Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        auto value = [&argument](std::string_view option) {
+            return std::string(argument.substr(option.size()));
+        };
+        if (argument.rfind("--filter=", 0) == 0) {
+            settings.filter = value("--filter=");
+        } else if (argument.rfind("--min-time=", 0) == 0) {
+            settings.minTime = std::stod(value("--min-time="));
+        } else if (argument.rfind("--corpus-files=", 0) == 0) {
+            settings.corpusFiles = std::stoul(value("--corpus-files="));
+        } else if (argument.rfind("--corpus-bytes=", 0) == 0) {
+            settings.corpusBytes = std::stoul(value("--corpus-bytes="));
+        } else {
+            std::cerr << "Usage: CodeAnalysisBench [--filter=TEXT] [--min-time=SECONDS] [--corpus-files=N] [--corpus-bytes=N]\n";
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+    auto run = [&](const std::string& name, std::size_t operationsPerCall, std::size_t bytesPerCall, const std::function<void()>& call) {
+        if (name.find(settings.filter) == std::string::npos)
+            return;
+        std::cerr << name << std::endl;
+        results.push_back(measure(name, settings, operationsPerCall, bytesPerCall, call));
+    };
+
+    // escaping at densities of special characters
+    std::string out;
+    for (const auto& [name, density] : { std::pair<const char*, double>{ "escape_density_0", 0.0 },
+                                         { "escape_density_1", 0.01 },
+                                         { "escape_density_30", 0.30 } }) {
+        const std::string content = generateSource(1024 * 1024, density, 1);
+        run(name, 1, content.size(), [&]{ runEscaping(content, out); });
+    }
+
+    // attribute-heavy requests, with all metadata for a tiny content
+    {
+        AnalysisRequest request = makeRequest("a = b;\n");
+        request.optionHash = "39dcad4f59855aa76420aa3d69af3d7ba30a91bb";
+        request.optionLOC = 1;
+        request.optionFilename = "fragment.cpp";
+        request.optionURL = "https://mlcollard.net/fragment.cpp";
+        run("attributes", 1, request.sourceCode.size(), [&]{
+            formatAnalysisXMLInto(request, out);
+            resultSink = resultSink + out.size();
+        });
+    }
+
+    // language lookup over typical filenames
+    {
+        const std::vector<std::string> filenames = { "main.cpp", "include/analysis.hpp", "src/Main.java", "kernel.c",
+                                                     "README.md", "Program.cs", "config.h", "lib/archive.tar.gz" };
+        run("language_lookup", 1000 * filenames.size(), 0, [&]{
+            for (int i = 0; i < 1000; ++i)
+                for (const auto& filename : filenames)
+                    resultSink = resultSink + filenameToLanguage(filename).size();
+        });
+    }
+
+    // small and huge units, with computed hash and LOC
+    for (const auto& [name, size] : { std::pair<const char*, std::size_t>{ "unit_small", 100 },
+                                      { "unit_huge", 64 * 1024 * 1024 } }) {
+        AnalysisRequest request = makeRequest(generateSource(size, 0.01, 2));
+        request.computeHash = true;
+        request.computeLOC = true;
+        run(name, 1, size, [&]{
+            formatAnalysisXMLInto(request, out);
+            resultSink = resultSink + out.size();
+        });
+    }
+    std::string().swap(out);
+
+    // huge unit generated from a copy of the request, or moved from it
+    {
+        const std::string sourceCode = generateSource(64 * 1024 * 1024, 0.01, 2);
+        const AnalysisRequest request = makeRequest("");
+        run("unit_huge_copied", 1, sourceCode.size(), [&]{
+            AnalysisRequest copy = request;
+            copy.sourceCode = sourceCode;
+            resultSink = resultSink + formatAnalysisXML(copy).size();
+        });
+        run("unit_huge_moved", 1, sourceCode.size(), [&]{
+            AnalysisRequest copy = request;
+            copy.sourceCode = sourceCode;
+            resultSink = resultSink + formatAnalysisXML(std::move(copy)).size();
+        });
+
+        // source code read with room for the escaped content and tags
+        run("unit_huge_in_place", 1, sourceCode.size(), [&]{
+            AnalysisRequest copy = request;
+            copy.sourceCode.reserve(sourceCode.size() + sourceCode.size() / 16);
+            copy.sourceCode = sourceCode;
+            resultSink = resultSink + formatAnalysisXML(std::move(copy)).size();
+        });
+    }
+
+    // mostly clean unit written to /dev/null, copied through a buffer or gathered in place
+    {
+        const AnalysisRequest request = makeRequest(generateSource(16 * 1024 * 1024, 0.001, 2));
+        const int fd = ::open("/dev/null", O_WRONLY);
+        run("sink_buffered", 1, request.sourceCode.size(), [&]{
+            FileDescriptorSink sink(fd);
+            formatAnalysisXML(request, sink);
+            sink.flush();
+        });
+        run("sink_writev", 1, request.sourceCode.size(), [&]{
+            WritevSink sink(fd);
+            formatAnalysisXML(request, sink);
+            sink.flush();
+        });
+        ::close(fd);
+    }
+
+    // small unit from a running server, the same work as unit_small plus a round trip
+    if (std::string("server_small").find(settings.filter) != std::string::npos) {
+        const std::string path = (std::filesystem::temp_directory_path() / ("CodeAnalysisBench." + std::to_string(::getpid()) + ".sock")).string();
+        AnalysisServer server(path);
+        std::thread serverThread([&server]{ server.run(); });
+
+        AnalysisRequest request = makeRequest(generateSource(100, 0.01, 2));
+        request.computeHash = true;
+        request.computeLOC = true;
+        {
+            AnalysisClient client(path);
+            run("server_small", 1, request.sourceCode.size(), [&]{
+                resultSink = resultSink + client.analyze(request).value().size();
+            });
+        }
+
+        server.stop();
+        serverThread.join();
+    }
+
+    // pipeline over a generated repository, written to /dev/null
+    if (std::string("corpus_pipeline").find(settings.filter) != std::string::npos) {
+        const std::filesystem::path root = std::filesystem::temp_directory_path() / ("CodeAnalysisBench." + std::to_string(::getpid()));
+        generateCorpus(root, settings.corpusFiles, settings.corpusBytes);
+
+        PipelineOptions options;
+        options.defaults.computeHash = true;
+        options.defaults.computeLOC = true;
+        const int fd = ::open("/dev/null", O_WRONLY);
+        run("corpus_pipeline", settings.corpusFiles, settings.corpusBytes, [&]{
+            FileDescriptorSink sink(fd);
+            resultSink = resultSink + runAnalysisPipeline({ root.string() }, options, sink);
+        });
+        ::close(fd);
+        std::filesystem::remove_all(root);
+    }
+
+    // machine-readable report
+    std::cout << "{\n  \"context\": {\"threads\": " << std::thread::hardware_concurrency()
+              << ", \"avx2\": " << (cpuHasAVX2() ? "true" : "false")
+              << ", \"sha1\": " << (cpuHasSHA1() ? "true" : "false") << "},\n"
+              << "  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        writeJSON(std::cout, results[i]);
+        std::cout << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    std::cout << "  ]\n}\n";
+
+    return 0;
+}
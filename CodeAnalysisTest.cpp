@@ -4,10 +4,24 @@
 */
 
 #include "CodeAnalysis.hpp"
+#include "SourceFile.hpp"
+#include "SHA1.hpp"
+#include "BinaryUnits.hpp"
 
 #include <string>
 #include <cassert>
 #include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <filesystem>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <algorithm>
+#include <vector>
+#include <memory_resource>
 
 int main() {
 
@@ -111,6 +125,17 @@ if (a &lt; b) a = b;
 )");
     }
 
+    // Test case: positional initializers set the fields in their original order
+    {
+        const AnalysisRequest request{ "a = b;\n", "main.cpp", "", "", "", "", "C++", "", "", -1, "2024-11-05T12:34:56" };
+
+        assert(formatAnalysisXML(request) ==
+            R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<code:unit xmlns:code="http://mlcollard.net/code" language="C++" filename="main.cpp" timestamp="2024-11-05T12:34:56">a = b;
+</code:unit>
+)");
+    }
+
     // Test case: include loc attribute if optionLOC is non-negative
     {
         AnalysisRequest request;
@@ -331,5 +356,780 @@ if (a &lt; b) a = b;
 )");
 }
 
+    // Test case: sink output to a stream matches the string output, even through a small buffer
+    {
+        AnalysisRequest request;
+        request.sourceCode = R"(
+if (a < b) a = b;
+)";
+        request.diskFilename    = "main.cpp";
+        request.entryFilename   = "";
+        request.optionFilename  = "";
+        request.sourceURL       = "";
+        request.optionURL       = "";
+        request.optionLanguage  = "";
+        request.defaultLanguage = "";
+        request.optionHash      = "";
+        request.optionLOC       = -1;
+        request.timestamp       = "";
+
+        std::ostringstream out;
+        {
+            StreamSink sink(out, 8);
+            assert(formatAnalysisXML(request, sink));
+        }
+        assert(out.str() == formatAnalysisXML(request));
+    }
+
+    // Test case: nothing is written to the sink for an invalid request
+    {
+        AnalysisRequest request;
+        request.sourceCode = R"(
+if (a < b) a = b;
+)";
+        request.diskFilename    = "main.txt";
+        request.entryFilename   = "";
+        request.optionFilename  = "";
+        request.sourceURL       = "";
+        request.optionURL       = "";
+        request.optionLanguage  = "";
+        request.defaultLanguage = "";
+        request.optionHash      = "";
+        request.optionLOC       = -1;
+        request.timestamp       = "";
+
+        std::string out;
+        StringSink sink(out);
+        assert(!formatAnalysisXML(request, sink));
+        assert(out.empty());
+    }
+
+    // Test case: '&' is escaped even when no '<' or '>' is present
+    {
+        AnalysisRequest request;
+        request.sourceCode = R"(
+if (a && b) a = b;
+)";
+        request.diskFilename    = "main.cpp";
+        request.entryFilename   = "";
+        request.optionFilename  = "";
+        request.sourceURL       = "";
+        request.optionURL       = "";
+        request.optionLanguage  = "";
+        request.defaultLanguage = "";
+        request.optionHash      = "";
+        request.optionLOC       = -1;
+        request.timestamp       = "";
+
+        assert(formatAnalysisXML(request) ==
+            R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<code:unit xmlns:code="http://mlcollard.net/code" language="C++" filename="main.cpp">
+if (a &amp;&amp; b) a = b;
+</code:unit>
+)");
+    }
+
+    // Test case: attribute values are escaped, including whitespace that would be normalized
+    {
+        AnalysisRequest request;
+        request.sourceCode = "a = b;\n";
+        request.diskFilename    = "dir/a\"b&<c>\td.cpp";
+        request.entryFilename   = "";
+        request.optionFilename  = "";
+        request.sourceURL       = "";
+        request.optionURL       = "https://mlcollard.net/?a=1&b=2";
+        request.optionLanguage  = "";
+        request.defaultLanguage = "";
+        request.optionHash      = "";
+        request.optionLOC       = -1;
+        request.computeLOC      = true;
+        request.timestamp       = "";
+
+        const std::string expected = R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<code:unit xmlns:code="http://mlcollard.net/code" language="C++" filename="dir/a&quot;b&amp;&lt;c&gt;&#9;d.cpp" loc="1" url="https://mlcollard.net/?a=1&amp;b=2">a = b;
+</code:unit>
+)";
+        assert(formatAnalysisXML(request) == expected);
+
+        std::ostringstream out;
+        StreamSink sink(out, 16);
+        assert(formatAnalysisXML(request, sink));
+        sink.flush();
+        assert(out.str() == expected);
+    }
+
+    // Test case: exact size matches the generated XML, and a reused string is not reallocated
+    {
+        AnalysisRequest request;
+        request.sourceCode = R"(
+if (a < b && b > c) a = b;
+)";
+        request.diskFilename    = "main.cpp";
+        request.entryFilename   = "";
+        request.optionFilename  = "";
+        request.sourceURL       = "http://example.com/source";
+        request.optionURL       = "";
+        request.optionLanguage  = "";
+        request.defaultLanguage = "";
+        request.optionHash      = "";
+        request.optionLOC       = 2;
+        request.timestamp       = "";
+
+        const std::string expected = formatAnalysisXML(request);
+        assert(formatAnalysisXMLSize(request) == expected.size());
+
+        std::string out;
+        assert(formatAnalysisXMLInto(request, out));
+        assert(out == expected);
+        assert(out.capacity() >= expected.size());
+
+        [[maybe_unused]] const char* storage = out.data();
+        assert(formatAnalysisXMLInto(request, out));
+        assert(out == expected);
+        assert(out.data() == storage);
+
+        request.diskFilename = "main.txt";
+        assert(formatAnalysisXMLSize(request) == 0);
+        assert(!formatAnalysisXMLInto(request, out));
+        assert(out.empty());
+    }
+
+    // Test case: archive nests units in request order and skips invalid requests
+    {
+        std::vector<AnalysisRequest> requests(3);
+        requests[0].sourceCode     = "a < b;\n";
+        requests[0].diskFilename   = "a.cpp";
+        requests[0].optionLOC      = -1;
+        requests[1].sourceCode     = "b;\n";
+        requests[1].diskFilename   = "b.txt";
+        requests[1].optionLOC      = -1;
+        requests[2].sourceCode     = "c && d;\n";
+        requests[2].diskFilename   = "c.java";
+        requests[2].optionLOC      = 1;
+
+        assert(formatAnalysisArchiveXML(requests, 4) ==
+            R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<code:unit xmlns:code="http://mlcollard.net/code">
+<code:unit language="C++" filename="a.cpp">a &lt; b;
+</code:unit>
+<code:unit language="Java" filename="c.java" loc="1">c &amp;&amp; d;
+</code:unit>
+</code:unit>
+)");
+    }
+
+    // Test case: large archive matches units generated one at a time
+    {
+        std::vector<AnalysisRequest> requests(1000);
+        const std::string xmlns = R"( xmlns:code="http://mlcollard.net/code")";
+        std::string expected = R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<code:unit xmlns:code="http://mlcollard.net/code">
+)";
+        for (std::size_t i = 0; i < requests.size(); ++i) {
+            requests[i].sourceCode   = std::string(i, '<');
+            requests[i].diskFilename = "file" + std::to_string(i) + ".c";
+            requests[i].optionLOC    = static_cast<int>(i);
+
+            // nested units have no XML declaration or namespace declaration
+            std::string unit = formatAnalysisXML(requests[i]);
+            unit.erase(0, unit.find('\n') + 1);
+            unit.erase(unit.find(xmlns), xmlns.size());
+            expected += unit;
+        }
+        expected += "</code:unit>\n";
+
+        std::ostringstream out;
+        {
+            StreamSink sink(out);
+            assert(formatAnalysisArchiveXML(requests, sink, 3) == requests.size());
+        }
+        assert(out.str() == expected);
+    }
+
+    // Test case: requests and output allocated from an arena match the std::string versions
+    {
+        // all allocations must come from the buffer
+        static char buffer[64 * 1024];
+        std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+        std::pmr::vector<PmrAnalysisRequest> requests(&arena);
+        requests.resize(2);
+        requests[0].sourceCode     = "a < b;\n";
+        requests[0].diskFilename   = "a.cpp";
+        requests[0].optionLOC      = -1;
+        requests[1].sourceCode     = "b;\n";
+        requests[1].diskFilename   = "b.txt";
+        requests[1].optionLOC      = -1;
+        // copied into the arena
+        PmrAnalysisRequest outside;
+        outside.sourceCode         = "c && d; // with a comment long enough to allocate\n";
+        outside.diskFilename       = "c.java";
+        outside.optionLOC          = 1;
+        requests.push_back(outside);
+        assert(requests[2].sourceCode.get_allocator().resource() == &arena);
+
+        std::vector<AnalysisRequest> expected(requests.size());
+        for (std::size_t i = 0; i < requests.size(); ++i) {
+            expected[i].sourceCode   = std::string(requests[i].sourceCode);
+            expected[i].diskFilename = std::string(requests[i].diskFilename);
+            expected[i].optionLOC    = requests[i].optionLOC;
+        }
+
+        std::pmr::string out(&arena);
+        assert(formatAnalysisXMLInto(requests[2], out));
+        assert(std::string_view(out) == formatAnalysisXML(expected[2]));
+        assert(!formatAnalysisXMLInto(requests[1], out));
+        assert(out.empty());
+
+        std::pmr::string archive(&arena);
+        {
+            PmrStringSink sink(archive);
+            assert(formatAnalysisArchiveXML(requests, sink, 2) == 2);
+        }
+        assert(std::string_view(archive) == formatAnalysisArchiveXML(expected, 2));
+    }
+
+    // Test case: binary units convert to the same archive as the requests
+    {
+        std::vector<AnalysisRequest> requests(4);
+        requests[0].sourceCode     = "a < b;\n";
+        requests[0].diskFilename   = "a.cpp";
+        requests[0].optionLOC      = -1;
+        requests[0].computeLOC     = true;
+        requests[0].computeHash    = true;
+        requests[1].sourceCode     = "b;\n";
+        requests[1].diskFilename   = "b.txt";
+        requests[1].optionLOC      = -1;
+        requests[2].sourceCode     = "c && d;\n";
+        requests[2].diskFilename   = "archive.tar";
+        requests[2].entryFilename  = "src/c.java";
+        requests[2].optionLOC      = 7;
+        requests[2].sourceURL      = "https://mlcollard.net";
+        requests[2].timestamp      = "2024-01-01";
+        requests[3].sourceCode     = std::string(1000, '>');
+        requests[3].diskFilename   = "d.cs";
+        requests[3].optionFilename = "renamed.cs";
+        requests[3].optionLOC      = -1;
+        requests[3].computeLOC     = true;
+        requests[3].optionHash     = "provided";
+
+        std::string binary;
+        StringSink binarySink(binary);
+        BinaryUnitWriter writer(binarySink);
+        std::string record;
+        for (const auto& request : requests) {
+            if (formatAnalysisBinaryInto(request, record))
+                writer.add(record);
+            else
+                assert(record.empty());
+        }
+        [[maybe_unused]] const std::size_t units = writer.finish();
+        assert(units == 3);
+
+        const BinaryUnitReader reader(binary);
+        assert(reader.size() == 3);
+        assert(reader[1].language == "Java" && reader[1].filename == "src/c.java");
+        assert(reader[1].url == "https://mlcollard.net" && reader[1].loc == 7);
+        assert(reader[0].hash == std::string_view(sha1Hex(requests[0].sourceCode).data(), SHA1::HEX_SIZE));
+        assert(reader[0].loc == 1);
+        assert(reader[2].content == requests[3].sourceCode);
+
+        std::string xml;
+        StringSink sink(xml);
+        assert(formatAnalysisBinaryXML(binary, sink) == 3);
+        assert(xml == formatAnalysisArchiveXML(requests));
+    }
+
+    // Test case: stdin without a declared language is invalid
+    {
+        AnalysisRequest request;
+        request.sourceCode = R"(
+if (a < b) a = b;
+)";
+        request.diskFilename    = "-";
+        request.entryFilename   = "data";
+        request.optionFilename  = "";
+        request.sourceURL       = "";
+        request.optionURL       = "";
+        request.optionLanguage  = "";
+        request.defaultLanguage = "";
+        request.optionHash      = "";
+        request.optionLOC       = -1;
+        request.timestamp       = "";
+
+        assert(formatAnalysisXML(request) == "");
+    }
+
+    // Test case: compute the hash of the source code when requested and no hash is provided
+    {
+        AnalysisRequest request;
+        request.sourceCode = R"(
+if (a < b)
+    a = b;
+)";
+        request.diskFilename    = "fragment.cpp";
+        request.entryFilename   = "";
+        request.optionFilename  = "";
+        request.sourceURL       = "";
+        request.optionURL       = "";
+        request.optionLanguage  = "";
+        request.defaultLanguage = "";
+        request.optionHash      = "";
+        request.computeHash     = true;
+        request.optionLOC       = -1;
+        request.timestamp       = "";
+
+        assert(formatAnalysisXML(request) ==
+            R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<code:unit xmlns:code="http://mlcollard.net/code" language="C++" filename="fragment.cpp" hash="39dcad4f59855aa76420aa3d69af3d7ba30a91bb">
+if (a &lt; b)
+    a = b;
+</code:unit>
+)");
+
+        // provided hash has priority
+        request.optionHash = "abc123";
+        assert(formatAnalysisXML(request).find(R"(hash="abc123")") != std::string::npos);
+    }
+
+    // Test case: count the lines of the source code when requested and no LOC is provided
+    {
+        AnalysisRequest request;
+        request.sourceCode = R"(
+if (a < b)
+    a = b;
+)";
+        request.diskFilename    = "fragment.cpp";
+        request.entryFilename   = "";
+        request.optionFilename  = "";
+        request.sourceURL       = "";
+        request.optionURL       = "";
+        request.optionLanguage  = "";
+        request.defaultLanguage = "";
+        request.optionHash      = "";
+        request.optionLOC       = -1;
+        request.computeLOC      = true;
+        request.timestamp       = "";
+
+        assert(formatAnalysisXML(request) ==
+            R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<code:unit xmlns:code="http://mlcollard.net/code" language="C++" filename="fragment.cpp" loc="3">
+if (a &lt; b)
+    a = b;
+</code:unit>
+)");
+
+        // every sink is given the same exact attribute
+        std::ostringstream stream;
+        StreamSink sink(stream);
+        assert(formatAnalysisXML(request, sink));
+        sink.flush();
+        assert(stream.str() == formatAnalysisXML(request));
+
+        // hash and LOC computed in the same pass
+        request.computeHash = true;
+        const std::string both = formatAnalysisXML(request);
+        assert(both.find(R"( filename="fragment.cpp" loc="3" hash="39dcad4f59855aa76420aa3d69af3d7ba30a91bb">)") != std::string::npos);
+        assert(both.size() == formatAnalysisXMLSize(request));
+
+        // provided LOC has priority
+        request.optionLOC = 10;
+        assert(formatAnalysisXML(request).find(R"(filename="fragment.cpp" loc="10")") != std::string::npos);
+    }
+
+    // Test case: source code that is not valid UTF-8
+    {
+        AnalysisRequest request;
+        request.sourceCode      = "a = \"\xFF\";\n";
+        request.diskFilename    = "invalid.cpp";
+        request.entryFilename   = "";
+        request.optionFilename  = "";
+        request.sourceURL       = "";
+        request.optionURL       = "";
+        request.optionLanguage  = "";
+        request.defaultLanguage = "";
+        request.optionHash      = "";
+        request.optionLOC       = 1;
+        request.timestamp       = "";
+
+        assert(formatAnalysisXML(request).empty());
+        assert(formatAnalysisXMLSize(request) == 0);
+
+        // nothing is written to a sink, without computed attributes
+        std::ostringstream stream;
+        StreamSink sink(stream);
+        assert(!formatAnalysisXML(request, sink));
+        sink.flush();
+        assert(stream.str().empty());
+
+        // truncated multi-byte character
+        request.sourceCode = "a = \"\xE2\x82";
+        assert(formatAnalysisXML(request).empty());
+    }
+
+    // Test case: computed LOC and hash backpatched into the start tag, for content of any size
+    {
+        std::string large;
+        while (large.size() <= 2 * 1024 * 1024)
+            large += "if (a < b)\n" + std::string(large.size() % 3000, 'x');
+
+        AnalysisRequest request;
+        request.diskFilename    = "main.cpp";
+        request.optionLOC       = -1;
+        request.computeLOC      = true;
+        request.computeHash     = true;
+        for (const std::string& content : { std::string(), std::string("a"), std::string(1000, '\n'), std::string(1000, 'y'), large }) {
+            request.sourceCode = content;
+            const std::string xml = formatAnalysisXML(request);
+            [[maybe_unused]] const SHA1::HexDigest hash = sha1Hex(content);
+            [[maybe_unused]] const std::size_t lines = std::count(content.begin(), content.end(), '\n') + (!content.empty() && content.back() != '\n');
+            assert(xml.find(" loc=\"" + std::to_string(lines) + "\" hash=\"" + std::string(hash.data(), hash.size()) + "\">") != std::string::npos);
+            assert(xml.size() == formatAnalysisXMLSize(request));
+
+            // the same output when scanned before it is written
+            std::ostringstream stream;
+            StreamSink sink(stream);
+            assert(formatAnalysisXML(request, sink));
+            sink.flush();
+            assert(stream.str() == xml);
+        }
+
+        // nothing is written for invalid content over the staging limit
+        request.sourceCode = large + "\xFF";
+        std::ostringstream stream;
+        StreamSink sink(stream);
+        assert(!formatAnalysisXML(request, sink));
+        sink.flush();
+        assert(stream.str().empty());
+    }
+
+    // Test case: request view of a memory-mapped source file
+    {
+        std::string sourceCode;
+        while (sourceCode.size() < SourceFile::MAP_THRESHOLD)
+            sourceCode += "if (a < b)\n    a = b;\n";
+        std::ofstream("CodeAnalysisTest.mapped.cpp", std::ios::binary) << sourceCode;
+
+        SourceFile file("CodeAnalysisTest.mapped.cpp");
+        assert(file.mapped());
+
+        AnalysisRequestView view;
+        view.sourceCode   = file.content();
+        view.diskFilename = "mapped.cpp";
+        view.optionLOC    = -1;
+        view.computeLOC   = true;
+        view.computeHash  = true;
+
+        AnalysisRequest request;
+        request.sourceCode   = sourceCode;
+        request.diskFilename = "mapped.cpp";
+        request.optionLOC    = -1;
+        request.computeLOC   = true;
+        request.computeHash  = true;
+
+        assert(formatAnalysisXML(view) == formatAnalysisXML(request));
+        assert(formatAnalysisXML(view).find(R"(filename="mapped.cpp")") != std::string::npos);
+        std::remove("CodeAnalysisTest.mapped.cpp");
+    }
+
+    // Test case: archive of the source files under a directory
+    {
+        const std::filesystem::path root = "CodeAnalysisTest.tree";
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root / "src");
+        std::ofstream(root / "main.cpp") << "a = b;\n";
+        std::ofstream(root / "notes.txt") << "c < d\n";
+        std::ofstream(root / "src" / "A.java") << "c && d;\n";
+
+        const std::string archive = formatAnalysisDirectoryXML(root.string(), 2);
+        assert(archive.find(R"(<code:unit language="C++" filename="CodeAnalysisTest.tree/main.cpp">a = b;
+</code:unit>
+)") != std::string::npos);
+        assert(archive.find(R"(<code:unit language="Java" filename="CodeAnalysisTest.tree/src/A.java">c &amp;&amp; d;
+</code:unit>
+)") != std::string::npos);
+        assert(archive.find("notes.txt") == std::string::npos);
+        assert(archive.rfind("</code:unit>\n</code:unit>\n") == archive.size() - 26);
+
+        std::ostringstream out;
+        StreamSink sink(out);
+        assert(formatAnalysisDirectoryXML(root.string(), sink, 1) == 2);
+        std::filesystem::remove_all(root);
+    }
+
+    // Test case: records of changed files are units and tombstones, in the order of the changes
+    {
+        const std::filesystem::path root = "CodeAnalysisTest.changes";
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+        std::ofstream(root / "main.cpp") << "a < b;\n";
+        std::ofstream(root / "invalid.cpp") << "invalid \xFF\n";
+        const std::string top = root.string();
+
+        AnalysisRequest defaults;
+        defaults.optionLOC = -1;
+        defaults.computeLOC = true;
+        const std::vector<FileChange> changes = { { top + "/invalid.cpp", false },
+                                                  { top + "/main.cpp", false },
+                                                  { top + "/missing.cpp", false },
+                                                  { top + "/removed&.cpp", true } };
+
+        std::string xml;
+        StringSink sink(xml);
+        DiagnosticLog log;
+        assert(formatAnalysisChangesXML(changes, defaults, sink, 2, &log) == 4);
+        assert(xml == "<code:delete filename=\"" + top + "/invalid.cpp\"></code:delete>\n"
+                      "<code:unit language=\"C++\" filename=\"" + top + "/main.cpp\" loc=\"1\">a &lt; b;\n</code:unit>\n"
+                      "<code:delete filename=\"" + top + "/missing.cpp\"></code:delete>\n"
+                      "<code:delete filename=\"" + top + "/removed&amp;.cpp\"></code:delete>\n");
+
+        // a file removed before it is read is not a diagnostic
+        assert(log.size() == 1);
+        assert(log.count(AnalysisError::UTF8) == 1);
+
+        // units are the same as in the archive of the directory
+        const std::string archive = formatAnalysisDirectoryXML(top, 1);
+        assert(archive.find(R"(<code:unit language="C++" filename="CodeAnalysisTest.changes/main.cpp">a &lt; b;)") != std::string::npos);
+
+        // tombstones name the file as its unit does
+        defaults.optionFilename = "renamed.cpp";
+        std::string renamed;
+        StringSink renamedSink(renamed);
+        [[maybe_unused]] const std::size_t records = formatAnalysisChangesXML(changes, defaults, renamedSink, 2, &log);
+        assert(records == 4);
+        assert(renamed == "<code:delete filename=\"renamed.cpp\"></code:delete>\n"
+                          "<code:unit language=\"C++\" filename=\"renamed.cpp\" loc=\"1\">a &lt; b;\n</code:unit>\n"
+                          "<code:delete filename=\"renamed.cpp\"></code:delete>\n"
+                          "<code:delete filename=\"renamed.cpp\"></code:delete>\n");
+
+        std::filesystem::remove_all(root);
+    }
+
+    // Test case: language of an archive entry from the entry filename
+    {
+        AnalysisRequest request;
+        request.sourceCode      = "a = b;\n";
+        request.diskFilename    = "project.tar.gz";
+        request.entryFilename   = "src/main.cpp";
+        request.optionLOC       = -1;
+
+        assert(formatAnalysisXML(request) ==
+            R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<code:unit xmlns:code="http://mlcollard.net/code" language="C++" filename="src/main.cpp">a = b;
+</code:unit>
+)");
+    }
+
+    // Test case: archive of the entries of a tar archive
+    {
+        // ustar entry with the content padded to whole blocks
+        auto tarEntry = [](const std::string& name, const std::string& content) {
+            char header[512] = {};
+            std::memcpy(header, name.data(), name.size());
+            std::snprintf(header + 124, 12, "%011o", static_cast<unsigned int>(content.size()));
+            header[156] = '0';
+            std::memcpy(header + 257, "ustar", 6);
+            std::memset(header + 148, ' ', 8);
+            unsigned int sum = 0;
+            for (const char byte : header)
+                sum += static_cast<unsigned char>(byte);
+            std::snprintf(header + 148, 8, "%06o", sum);
+            return std::string(header, sizeof(header)) + content + std::string((512 - content.size() % 512) % 512, '\0');
+        };
+        std::ofstream("CodeAnalysisTest.tar", std::ios::binary) << tarEntry("main.cpp", "a = b;\n")
+                                                                << tarEntry("notes.txt", "c < d\n")
+                                                                << tarEntry("src/A.java", "c && d;\n")
+                                                                << std::string(1024, '\0');
+
+        const int fd = ::open("CodeAnalysisTest.tar", O_RDONLY);
+        std::string archive;
+        StringSink sink(archive);
+        assert(formatAnalysisTarXML(fd, "CodeAnalysisTest.tar", sink) == 2);
+        ::close(fd);
+        std::remove("CodeAnalysisTest.tar");
+
+        assert(archive ==
+            R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<code:unit xmlns:code="http://mlcollard.net/code">
+<code:unit language="C++" filename="main.cpp">a = b;
+</code:unit>
+<code:unit language="Java" filename="src/A.java">c &amp;&amp; d;
+</code:unit>
+</code:unit>
+)");
+    }
+
+    // Test case: errors returned instead of reported
+    {
+        AnalysisRequest request;
+        request.sourceCode      = "a < b;\n";
+        request.diskFilename    = "notes.txt";
+        request.optionLOC       = -1;
+
+        const AnalysisResult<std::string> unsupported = tryFormatAnalysisXML(request);
+        assert(!unsupported && unsupported.error() == AnalysisError::EXTENSION);
+        assert(unsupported.message() == "Extension not supported");
+
+        request.diskFilename = "-";
+        assert(tryFormatAnalysisXML(request).error() == AnalysisError::STDIN_LANGUAGE);
+
+        request.optionLanguage = "C++";
+        const AnalysisResult<std::string> valid = tryFormatAnalysisXML(request);
+        assert(valid && *valid == formatAnalysisXML(request));
+
+        request.sourceCode = "\xFF";
+        std::string out;
+        StringSink sink(out);
+        assert(tryFormatAnalysisXML(request, sink) == AnalysisError::UTF8);
+        assert(tryFormatAnalysisUnitXMLInto(request, out) == AnalysisError::UTF8 && out.empty());
+        assert(tryFormatAnalysisBinaryInto(request, out) == AnalysisError::UTF8 && out.empty());
+    }
+
+    // Test case: request moved into the XML, with the content escaped in place
+    {
+        std::string sourceCode;
+        while (sourceCode.size() < 100000)
+            sourceCode += "if (a < b) \"\xC3\xA9\" && c > d;\n" + std::string(sourceCode.size() % 5000, 'x');
+
+        AnalysisRequest request;
+        request.entryFilename   = "main.cpp";
+        request.optionLanguage  = "C++";
+        request.optionLOC       = -1;
+        request.computeHash     = true;
+        request.computeLOC      = true;
+        for (const std::string& content : { sourceCode, std::string(), std::string("&"), std::string(40000, 'y') }) {
+            request.sourceCode = content;
+            const std::string expected = formatAnalysisXML(request);
+            AnalysisRequest moved = request;
+            assert(formatAnalysisXML(std::move(moved)) == expected);
+
+            // with room for the XML, escaped in place in the same storage
+            AnalysisRequest spare = request;
+            spare.sourceCode.reserve(expected.size());
+            [[maybe_unused]] const char* storage = spare.sourceCode.data();
+            const std::string xml = formatAnalysisXML(std::move(spare));
+            assert(xml == expected);
+            assert(xml.data() == storage);
+        }
+
+        // invalid requests leave the source code
+        AnalysisRequest invalid = request;
+        invalid.sourceCode = "a\xFF";
+        assert(formatAnalysisXML(std::move(invalid)).empty());
+        assert(invalid.sourceCode == "a\xFF");
+    }
+
+    // Test case: output gathered with writev, with long clean runs referenced in place
+    {
+        std::string sourceCode;
+        while (sourceCode.size() < 200000) {
+            sourceCode += "a = b;\n";
+            sourceCode.append(sourceCode.size() % 7 * 100, 'x');
+            sourceCode += " && c > d;\n";
+        }
+
+        AnalysisRequest request;
+        request.sourceCode      = sourceCode;
+        request.entryFilename   = "main.cpp";
+        request.optionLanguage  = "C++";
+        request.optionLOC       = -1;
+
+        // small capacity so the buffer fills between entities
+        std::FILE* file = std::tmpfile();
+        assert(file);
+        {
+            WritevSink sink(::fileno(file), 100);
+            formatAnalysisXML(request, sink);
+            sink.write(std::string(300, 'y'));
+            sink.writeEscaped("<");
+            sink.flush();
+        }
+        std::rewind(file);
+        std::string written;
+        char part[4096];
+        for (std::size_t count; (count = std::fread(part, 1, sizeof(part), file)) > 0;)
+            written.append(part, count);
+        std::fclose(file);
+        assert(written == formatAnalysisXML(request) + std::string(300, 'y') + "&lt;");
+
+        // runs and entities larger than a tiny buffer are written through
+        for (const std::size_t capacity : { 1, 3, 16 }) {
+            std::FILE* tiny = std::tmpfile();
+            assert(tiny);
+            {
+                WritevSink sink(::fileno(tiny), capacity);
+                sink.writeEscaped(std::string(200, 'a') + "<" + std::string(10, 'b') + "&");
+                sink.write("done");
+                formatAnalysisXML(request, sink);
+            }
+            std::rewind(tiny);
+            std::string tinyWritten;
+            for (std::size_t count; (count = std::fread(part, 1, sizeof(part), tiny)) > 0;)
+                tinyWritten.append(part, count);
+            std::fclose(tiny);
+            assert(tinyWritten == std::string(200, 'a') + "&lt;" + std::string(10, 'b') + "&amp;done" + formatAnalysisXML(request));
+        }
+    }
+
+    // Test case: content streamed from stdin in chunks
+    {
+        std::string sourceCode;
+        while (sourceCode.size() < 300000)
+            sourceCode += "if (a < b) \"\xC3\xA9\xE2\x82\xAC\" && c > d;\n";
+
+        AnalysisRequest request;
+        request.sourceCode      = sourceCode;
+        request.diskFilename    = "-";
+        request.entryFilename   = "data";
+        request.optionLanguage  = "C++";
+        request.optionLOC       = -1;
+
+        // stream of the source code written through a pipe in uneven pieces
+        [[maybe_unused]] auto stream = [&](OutputSink& sink) {
+            int fds[2];
+            [[maybe_unused]] const int piped = ::pipe(fds);
+            assert(piped == 0);
+            std::thread writer([&]{
+                for (std::size_t pos = 0; pos < sourceCode.size(); pos += 4099) {
+                    [[maybe_unused]] const ssize_t written = ::write(fds[1], sourceCode.data() + pos, std::min<std::size_t>(4099, sourceCode.size() - pos));
+                    assert(written >= 0);
+                }
+                ::close(fds[1]);
+            });
+            AnalysisRequestView view(request);
+            view.sourceCode = "";
+            const bool valid = formatAnalysisXMLStream(view, fds[0], sink);
+            char rest[4096];
+            while (::read(fds[0], rest, sizeof(rest)) > 0) {}
+            writer.join();
+            ::close(fds[0]);
+            return valid;
+        };
+
+        std::ostringstream out;
+        StreamSink sink(out);
+        [[maybe_unused]] bool streamed = stream(sink);
+        assert(streamed);
+        sink.flush();
+        assert(out.str() == formatAnalysisXML(request));
+
+        // computed attributes precede the content, so streamed content cannot have them
+        request.computeHash = true;
+        std::string computed;
+        StringSink computedSink(computed);
+        streamed = stream(computedSink);
+        assert(!streamed);
+        assert(computed.empty());
+
+        // stdin still requires a declared language
+        request.computeHash = false;
+        request.optionLanguage = "";
+        std::string undeclared;
+        StringSink undeclaredSink(undeclared);
+        streamed = formatAnalysisXMLStream(request, 0, undeclaredSink);
+        assert(!streamed);
+        assert(undeclared.empty());
+    }
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,128 @@
+/*
+  @file ContentScanner.cpp
+
+  Implementation of the single pass over source code
+*/
+
+#include "ContentScanner.hpp"
+#include "LineCount.hpp"
+#include "UTF8.hpp"
+#include "XMLEscape.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @param hash Compute the SHA-1 hash of the content
+ * @param lines Count the lines of the content
+ * @param sink Destination of the escaped content, or nullptr for none
+ * @param validate Check the content is valid UTF-8, false for content already checked
+ */
+ContentScanner::ContentScanner(bool hash, bool lines, OutputSink* sink, bool validate)
+    : hashing(hash), counting(lines), sink(sink), validating(validate) {}
+
+/**
+ * Scan the next part of the content
+ *
+ * @param content Next bytes of the content
+ * @retval false Content is not valid UTF-8
+ */
+bool ContentScanner::update(std::string_view content) {
+
+    // checked content is processed in blocks as is, since no character can be invalid
+    if (!validating) {
+        for (; !content.empty(); content.remove_prefix(std::min(content.size(), BLOCK_SIZE)))
+            process(content.substr(0, BLOCK_SIZE));
+        return true;
+    }
+
+    // complete the character cut off by the previous update
+    if (partialSize > 0) {
+        const std::size_t count = std::min(content.size(), sizeof(partial) - partialSize);
+        std::memcpy(partial + partialSize, content.data(), count);
+
+        const std::string_view character(partial, partialSize + count);
+        const std::size_t missing = incompleteUTF8Suffix(character);
+        if (missing == character.size()) {
+            partialSize = character.size();
+            return true;
+        }
+
+        // valid bytes must include the whole saved character
+        const std::size_t size = findInvalidUTF8(character.substr(0, character.size() - missing));
+        if (size <= partialSize)
+            return false;
+
+        process(character.substr(0, size));
+        content.remove_prefix(size - partialSize);
+        partialSize = 0;
+    }
+
+    while (!content.empty()) {
+
+        // block of whole characters, with a cut off character saved for later
+        std::string_view block = content.substr(0, BLOCK_SIZE);
+        const std::size_t incomplete = incompleteUTF8Suffix(block);
+        if (incomplete == block.size() && block.size() == content.size()) {
+            std::memcpy(partial, block.data(), block.size());
+            partialSize = block.size();
+            return true;
+        }
+        block.remove_suffix(incomplete);
+
+        if (findInvalidUTF8(block) != block.size())
+            return false;
+
+        process(block);
+        content.remove_prefix(block.size());
+    }
+
+    return true;
+}
+
+/**
+ * Complete the scan
+ *
+ * @retval false Content ends in an incomplete UTF-8 character
+ */
+bool ContentScanner::finish() {
+
+    if (partialSize > 0)
+        return false;
+
+    if (hashing)
+        digest = sha1.finish();
+
+    return true;
+}
+
+/**
+ * Process a block of whole, valid characters while it is in cache
+ *
+ * @param block Next bytes of the content
+ */
+void ContentScanner::process(std::string_view block) {
+
+    if (block.empty())
+        return;
+
+    if (hashing)
+        sha1.update(block);
+
+    if (counting) {
+        newlines += countNewlines(block);
+        unterminated = block.back() != '\n';
+    }
+
+    if (sink)
+        sink->writeEscaped(block);
+
+#if defined(CODEANALYSIS_METRICS)
+    if (sink && !sink->measuring()) {
+        const std::size_t escaped = escapedSize(block);
+        addMetric(MetricCounter::CONTENT_BYTES_IN, block.size());
+        addMetric(MetricCounter::CONTENT_BYTES_OUT, escaped);
+        addMetric(MetricCounter::OUTPUT_BYTES, escaped);
+    }
+#endif
+}
@@ -0,0 +1,86 @@
+/*
+  @file ContentScanner.hpp
+
+  Single pass over source code for its hash, lines, UTF-8 validation, and escaped output
+*/
+
+#ifndef INCLUDED_CONTENTSCANNER_HPP
+#define INCLUDED_CONTENTSCANNER_HPP
+
+#include "SHA1.hpp"
+#include "OutputSink.hpp"
+#include <string_view>
+#include <cstddef>
+
+/**
+ * Scans source code in cache-sized blocks, so each byte is read from
+ * memory once, while each block is hashed, counted, validated, and escaped
+ *
+ * Content may be split across calls to update() at any byte, including
+ * within a UTF-8 character.
+ */
+class ContentScanner {
+public:
+
+    /** Size of the blocks each step processes */
+    static constexpr std::size_t BLOCK_SIZE = 16 * 1024;
+
+    /**
+     * @param hash Compute the SHA-1 hash of the content
+     * @param lines Count the lines of the content
+     * @param sink Destination of the escaped content, or nullptr for none
+     * @param validate Check the content is valid UTF-8, false for content already checked
+     */
+    ContentScanner(bool hash, bool lines, OutputSink* sink, bool validate = true);
+
+    /**
+     * Scan the next part of the content
+     *
+     * Content before an invalid UTF-8 character may already be written.
+     *
+     * @param content Next bytes of the content
+     * @retval false Content is not valid UTF-8
+     */
+    bool update(std::string_view content);
+
+    /**
+     * Complete the scan
+     *
+     * @retval false Content ends in an incomplete UTF-8 character
+     */
+    bool finish();
+
+    /**
+     * SHA-1 hash of the content, when requested
+     *
+     * @pre finish() was called
+     */
+    const SHA1::HexDigest& hash() const { return digest; }
+
+    /**
+     * Number of lines in the content, when requested
+     *
+     * @pre finish() was called
+     */
+    std::size_t lines() const { return newlines + unterminated; }
+
+private:
+
+    // process a block of whole, valid characters
+    void process(std::string_view block);
+
+    bool hashing;
+    bool counting;
+    OutputSink* sink;
+    bool validating;
+    SHA1 sha1;
+    SHA1::HexDigest digest{};
+    std::size_t newlines = 0;
+    bool unterminated = false;
+
+    // incomplete character from the end of the previous update()
+    char partial[4];
+    std::size_t partialSize = 0;
+};
+
+#endif
@@ -0,0 +1,43 @@
+/*
+  @file DirectoryEntry.cpp
+
+  Implementation of the classification of directory entries
+*/
+
+#include "DirectoryEntry.hpp"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/**
+ * Kind of an entry of an open directory
+ *
+ * @param directoryFd Open directory of the entry
+ * @param name Name of the entry
+ * @param type d_type of the entry, DT_UNKNOWN when not provided
+ * @retval Kind of the entry
+ */
+EntryType entryType(int directoryFd, const char* name, unsigned char type) {
+
+    if (type == DT_REG)
+        return EntryType::FILE;
+    if (type == DT_DIR)
+        return EntryType::DIRECTORY;
+    if (type != DT_UNKNOWN && type != DT_LNK)
+        return EntryType::OTHER;
+
+    // the target of a symbolic link decides, as for any other entry
+    struct stat status;
+    if (::fstatat(directoryFd, name, &status, 0) < 0)
+        return EntryType::OTHER;
+    if (S_ISREG(status.st_mode))
+        return EntryType::FILE;
+    if (!S_ISDIR(status.st_mode) || type == DT_LNK)
+        return EntryType::OTHER;
+
+    // a directory of unknown type is only followed when it is not a symbolic link
+    if (::fstatat(directoryFd, name, &status, AT_SYMLINK_NOFOLLOW) < 0 || S_ISLNK(status.st_mode))
+        return EntryType::OTHER;
+
+    return EntryType::DIRECTORY;
+}
@@ -0,0 +1,31 @@
+/*
+  @file DirectoryEntry.hpp
+
+  Classification of directory entries for walks of a tree
+*/
+
+#ifndef INCLUDED_DIRECTORYENTRY_HPP
+#define INCLUDED_DIRECTORYENTRY_HPP
+
+/** Kind of a directory entry, as a walk of a tree treats it */
+enum class EntryType {
+    FILE,       // regular file, or symbolic link to one
+    DIRECTORY,  // directory, but not a symbolic link to one
+    OTHER       // anything else, including a broken symbolic link
+};
+
+/**
+ * Kind of an entry of an open directory
+ *
+ * Symbolic links to files are files, and symbolic links to directories are
+ * not followed. The type from the directory entry is used when the file system
+ * provides it, so only a symbolic link or an unknown type needs a stat.
+ *
+ * @param directoryFd Open directory of the entry
+ * @param name Name of the entry
+ * @param type d_type of the entry, DT_UNKNOWN when not provided
+ * @retval Kind of the entry
+ */
+EntryType entryType(int directoryFd, const char* name, unsigned char type);
+
+#endif
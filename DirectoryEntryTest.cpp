@@ -0,0 +1,48 @@
+/*
+  @file DirectoryEntryTest.cpp
+
+  Test program for entryType()
+*/
+
+#include "DirectoryEntry.hpp"
+#include <filesystem>
+#include <fstream>
+#include <cassert>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+int main() {
+
+    const std::filesystem::path root = "DirectoryEntryTest.tree";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "sub");
+    std::ofstream(root / "main.cpp") << "int a;\n";
+    std::filesystem::create_symlink("main.cpp", root / "link.cpp");
+    std::filesystem::create_symlink("sub", root / "linkdir");
+    std::filesystem::create_symlink("missing.cpp", root / "broken.cpp");
+
+    const int fd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    assert(fd >= 0);
+
+    // types from the directory entry
+    assert(entryType(fd, "main.cpp", DT_REG) == EntryType::FILE);
+    assert(entryType(fd, "sub", DT_DIR) == EntryType::DIRECTORY);
+    assert(entryType(fd, "link.cpp", DT_LNK) == EntryType::FILE);
+    assert(entryType(fd, "linkdir", DT_LNK) == EntryType::OTHER);
+    assert(entryType(fd, "broken.cpp", DT_LNK) == EntryType::OTHER);
+    assert(entryType(fd, "main.cpp", DT_FIFO) == EntryType::OTHER);
+
+    // the same types when the file system does not provide them
+    assert(entryType(fd, "main.cpp", DT_UNKNOWN) == EntryType::FILE);
+    assert(entryType(fd, "sub", DT_UNKNOWN) == EntryType::DIRECTORY);
+    assert(entryType(fd, "link.cpp", DT_UNKNOWN) == EntryType::FILE);
+    assert(entryType(fd, "linkdir", DT_UNKNOWN) == EntryType::OTHER);
+    assert(entryType(fd, "broken.cpp", DT_UNKNOWN) == EntryType::OTHER);
+    assert(entryType(fd, "missing.cpp", DT_UNKNOWN) == EntryType::OTHER);
+
+    ::close(fd);
+    std::filesystem::remove_all(root);
+
+    return 0;
+}
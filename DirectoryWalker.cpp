@@ -0,0 +1,123 @@
+/*
+  @file DirectoryWalker.cpp
+
+  Implementation of the parallel walk of a directory tree
+*/
+
+#include "DirectoryWalker.hpp"
+#include "DirectoryEntry.hpp"
+#include "FilenameToLanguage.hpp"
+#include <memory>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+    using Visit = std::function<void(AnalysisRequest&&)>;
+
+    // open a directory for listing
+    int openDirectory(const std::string& path) {
+
+        int fd;
+        do {
+            fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        } while (fd < 0 && errno == EINTR);
+
+        return fd;
+    }
+
+    // path of an entry of the directory
+    std::string joinPath(const std::string& directory, std::string_view name) {
+
+        std::string path;
+        path.reserve(directory.size() + 1 + name.size());
+        path += directory;
+        if (path.empty() || path.back() != '/')
+            path += '/';
+        path += name;
+
+        return path;
+    }
+
+    /**
+     * List an open directory, submitting each subdirectory and visiting each supported file
+     *
+     * @param fd Open directory, closed when listed
+     * @param path Path of the directory
+     * @param pool Threads that walk the tree
+     * @param visit Called with the request for each file
+     * @param diagnostics Log of directories that cannot be listed
+     */
+    void walk(int fd, const std::string& path, ThreadPool& pool, const std::shared_ptr<const Visit>& visit, DiagnosticLog& diagnostics) {
+
+        DIR* directory = ::fdopendir(fd);
+        if (!directory) {
+            diagnostics.add(AnalysisError::UNREADABLE, path, std::system_category().message(errno));
+            ::close(fd);
+            return;
+        }
+        const std::unique_ptr<DIR, int (*)(DIR*)> closer(directory, ::closedir);
+
+        // names of regular files, classified together once listed
+        std::vector<std::string> files;
+        while (const dirent* entry = ::readdir(directory)) {
+
+            const std::string_view name = entry->d_name;
+            if (name == "." || name == "..")
+                continue;
+
+            const EntryType type = entryType(fd, entry->d_name, entry->d_type);
+            if (type == EntryType::DIRECTORY) {
+                // opened by the task, so queued directories do not hold descriptors
+                pool.submit([subpath = joinPath(path, name), &pool, visit, &diagnostics]{
+                    const int subfd = openDirectory(subpath);
+                    if (subfd < 0) {
+                        diagnostics.add(AnalysisError::UNREADABLE, subpath, std::system_category().message(errno));
+                        return;
+                    }
+                    walk(subfd, subpath, pool, visit, diagnostics);
+                });
+            } else if (type == EntryType::FILE) {
+                files.emplace_back(name);
+            }
+        }
+
+        // only files with a supported extension are visited
+        std::vector<std::string_view> names(files.begin(), files.end());
+        std::vector<std::string_view> languages(names.size());
+        classifyFilenames(names.data(), names.size(), languages.data());
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            if (languages[i].empty())
+                continue;
+
+            AnalysisRequest request;
+            request.diskFilename = joinPath(path, files[i]);
+            request.optionLOC = -1;
+            (*visit)(std::move(request));
+        }
+    }
+}
+
+/**
+ * Walk a directory tree in parallel, visiting each file with a supported extension
+ *
+ * @param directory Root of the tree
+ * @param pool Threads that walk the tree and visit the files
+ * @param visit Called with the request for each file
+ * @param diagnostics Log of subdirectories that cannot be listed
+ * @throw std::system_error if the root cannot be opened
+ */
+void walkDirectory(const std::string& directory, ThreadPool& pool, std::function<void(AnalysisRequest&&)> visit, DiagnosticLog& diagnostics) {
+
+    const int fd = openDirectory(directory);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), directory);
+
+    auto shared = std::make_shared<const Visit>(std::move(visit));
+    pool.submit([fd, directory, &pool, shared, &diagnostics]{ walk(fd, directory, pool, shared, diagnostics); });
+}
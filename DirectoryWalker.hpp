@@ -0,0 +1,38 @@
+/*
+  @file DirectoryWalker.hpp
+
+  Parallel walk of a directory tree for source-code files
+*/
+
+#ifndef INCLUDED_DIRECTORYWALKER_HPP
+#define INCLUDED_DIRECTORYWALKER_HPP
+
+#include "AnalysisError.hpp"
+#include "AnalysisRequest.hpp"
+#include "ThreadPool.hpp"
+#include <functional>
+#include <string>
+
+/**
+ * Walk a directory tree in parallel, visiting each file with a supported extension
+ *
+ * Each directory is a task on the pool, so subdirectories are listed while
+ * files already found are visited. Files are filtered by their extension
+ * before they are opened. Symbolic links to files are visited, but symbolic
+ * links to directories are not followed.
+ *
+ * The visit is called on pool threads, concurrently, with a request whose
+ * diskFilename is the path of the file, with an empty sourceCode and no LOC.
+ * Returns once the walk is started, so wait on the pool for it to complete.
+ * Subdirectories that cannot be listed are added to the log of the batch,
+ * which must outlive the walk.
+ *
+ * @param directory Root of the tree
+ * @param pool Threads that walk the tree and visit the files
+ * @param visit Called with the request for each file
+ * @param diagnostics Log of subdirectories that cannot be listed
+ * @throw std::system_error if the root cannot be opened
+ */
+void walkDirectory(const std::string& directory, ThreadPool& pool, std::function<void(AnalysisRequest&&)> visit, DiagnosticLog& diagnostics);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+  @file DirectoryWalkerTest.cpp
+
+  Test program for walkDirectory()
+*/
+
+#include "DirectoryWalker.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <cassert>
+#include <unistd.h>
+
+int main() {
+
+    // tree of supported and unsupported files
+    const std::filesystem::path root = "DirectoryWalkerTest.tree";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "src" / "detail");
+    std::filesystem::create_directories(root / "empty");
+    std::ofstream(root / "main.cpp") << "int main() {}\n";
+    std::ofstream(root / "README.md") << "# Tree\n";
+    std::ofstream(root / "src" / "A.java") << "class A {}\n";
+    std::ofstream(root / "src" / "notes.txt") << "notes\n";
+    std::ofstream(root / "src" / "detail" / "a.hpp") << "int a;\n";
+    std::ofstream(root / "src" / "detail" / "b.h") << "int b;\n";
+
+    // all supported files, on any number of threads
+    for (unsigned int threads = 1; threads <= 4; ++threads) {
+
+        std::mutex mutex;
+        std::vector<std::string> files;
+        DiagnosticLog diagnostics;
+        ThreadPool pool(threads);
+        walkDirectory(root.string(), pool, [&](AnalysisRequest&& request) {
+            assert(request.sourceCode.empty());
+            assert(request.optionLOC < 0);
+            std::lock_guard<std::mutex> lock(mutex);
+            files.push_back(request.diskFilename);
+        }, diagnostics);
+        pool.wait();
+        assert(diagnostics.empty());
+
+        std::sort(files.begin(), files.end());
+        assert(files == std::vector<std::string>({
+            "DirectoryWalkerTest.tree/main.cpp",
+            "DirectoryWalkerTest.tree/src/A.java",
+            "DirectoryWalkerTest.tree/src/detail/a.hpp",
+            "DirectoryWalkerTest.tree/src/detail/b.h",
+        }));
+    }
+
+    // subdirectories that cannot be listed are logged, when permissions apply to the user
+    {
+        const std::filesystem::path locked = root / "locked";
+        std::filesystem::create_directories(locked);
+        std::ofstream(locked / "hidden.cpp") << "int h;\n";
+        std::filesystem::permissions(locked, std::filesystem::perms::none);
+        if (::access(locked.c_str(), R_OK) != 0) {
+            DiagnosticLog diagnostics;
+            ThreadPool pool(2);
+            walkDirectory(root.string(), pool, []([[maybe_unused]] AnalysisRequest&& request) {
+                assert(request.diskFilename.find("hidden.cpp") == std::string::npos);
+            }, diagnostics);
+            pool.wait();
+            assert(diagnostics.count(AnalysisError::UNREADABLE) == 1);
+            assert(diagnostics.diagnostics()[0].source == locked.string());
+        }
+        std::filesystem::permissions(locked, std::filesystem::perms::owner_all);
+    }
+
+    // missing root
+    {
+        DiagnosticLog diagnostics;
+        ThreadPool pool(1);
+        [[maybe_unused]] bool thrown = false;
+        try {
+            walkDirectory("DirectoryWalkerTest.missing", pool, [](AnalysisRequest&&) { assert(false); }, diagnostics);
+        } catch (const std::system_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+
+    std::filesystem::remove_all(root);
+
+    return 0;
+}
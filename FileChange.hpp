@@ -0,0 +1,18 @@
+/*
+  @file FileChange.hpp
+
+  Change to a source file of a watched tree
+*/
+
+#ifndef INCLUDED_FILECHANGE_HPP
+#define INCLUDED_FILECHANGE_HPP
+
+#include <string>
+
+/** Change to a source file, keyed by its path */
+struct FileChange {
+    std::string path;
+    bool removed = false;   // deleted, moved out, or no longer a supported file, instead of created or modified
+};
+
+#endif
@@ -1,40 +1,75 @@
 /*
   @file FilenameToLanguage.cpp
 
-  Implementation of filenameToLanguage()
+  Implementation of filenameToLanguage() and classifyFilenames()
 */
 
 #include "FilenameToLanguage.hpp"
-#include <unordered_map>
+#include <cstdint>
 #include <string>
 #include <string_view>
 
 namespace {
 
-    // mapping from file extension to programming language
-    const std::unordered_map<std::string_view, std::string_view> extensionToLanguage {
-
-        { ".c", "C" },
-        { ".h", "C" },
-        { ".i", "C" },
-        { ".cpp", "C++" },
-        { ".CPP", "C++" },
-        { ".cp", "C++" },
-        { ".hpp", "C++" },
-        { ".cxx", "C++" },
-        { ".hxx", "C++" },
-        { ".cc", "C++" },
-        { ".hh", "C++" },
-        { ".c++", "C++" },
-        { ".h++", "C++" },
-        { ".C", "C++" },
-        { ".H", "C++" },
-        { ".tcc", "C++" },
-        { ".ii", "C++" },
-        { ".java", "Java" },
-        { ".aj", "AspectJ" },
-        { ".cs", "C#" },
-    };
+    // longest extension that can be packed, including the '.'
+    constexpr std::size_t MAX_EXTENSION_LENGTH = 7;
+
+    // extension packed with its length into an integer that is
+    // unique for each extension up to MAX_EXTENSION_LENGTH
+    constexpr std::uint64_t packExtension(std::string_view extension) {
+
+        std::uint64_t packed = extension.size();
+        for (std::size_t i = 0; i < extension.size(); ++i)
+            packed |= static_cast<std::uint64_t>(static_cast<unsigned char>(extension[i])) << (8 * (i + 1));
+
+        return packed;
+    }
+
+    // mapping from file extension to programming language, as
+    // a switch on the packed extension resolved at compile time
+    constexpr std::string_view extensionToLanguage(std::string_view extension) {
+
+        if (extension.size() > MAX_EXTENSION_LENGTH)
+            return "";
+
+        switch (packExtension(extension)) {
+
+            case packExtension(".c"):
+            case packExtension(".h"):
+            case packExtension(".i"):
+                return "C";
+
+            case packExtension(".cpp"):
+            case packExtension(".CPP"):
+            case packExtension(".cp"):
+            case packExtension(".hpp"):
+            case packExtension(".cxx"):
+            case packExtension(".hxx"):
+            case packExtension(".cc"):
+            case packExtension(".hh"):
+            case packExtension(".c++"):
+            case packExtension(".h++"):
+            case packExtension(".C"):
+            case packExtension(".H"):
+            case packExtension(".tcc"):
+            case packExtension(".ii"):
+                return "C++";
+
+            case packExtension(".java"):
+                return "Java";
+
+            case packExtension(".aj"):
+                return "AspectJ";
+
+            case packExtension(".cs"):
+                return "C#";
+
+            default:
+                return "";
+        }
+    }
+
+    static_assert(extensionToLanguage(".cpp") == "C++", "Extension lookup must be constant");
 }
 
 /**
@@ -51,11 +86,19 @@ std::string_view filenameToLanguage(std::string_view filename) {
         return "";
     std::string_view extension(filename.substr(extensionPosition));
 
-    // find the extension in the map
-    const auto extensionEntry = extensionToLanguage.find(extension);
-    if (extensionEntry == extensionToLanguage.end())
-        return "";
+    // language for this extension
+    return extensionToLanguage(extension);
+}
+
+/**
+ * Language for each of a list of filenames
+ *
+ * @param filenames Names of source-code files
+ * @param count Number of filenames
+ * @param languages Programming language of each filename, empty string if no associated language
+ */
+void classifyFilenames(const std::string_view* filenames, std::size_t count, std::string_view* languages) {
 
-    // language for this extension from the map
-    return extensionEntry->second;
+    for (std::size_t i = 0; i < count; ++i)
+        languages[i] = filenameToLanguage(filenames[i]);
 }
@@ -1,13 +1,14 @@
 /*
   @file FilenameToLanguage.hpp
 
-  Declaration of filenameToLanguage()
+  Declaration of filenameToLanguage() and classifyFilenames()
 */
 
 #ifndef INCLUDED_FILENAMETOLANGUAGE_HPP
 #define INCLUDED_FILENAMETOLANGUAGE_HPP
 
 #include <string_view>
+#include <cstddef>
 
 /**
  * Language based on the filename
@@ -17,4 +18,14 @@
  */
 std::string_view filenameToLanguage(std::string_view filename);
 
+/**
+ * Language for each of a list of filenames, e.g., from a directory scan
+ *
+ * @param filenames Names of source-code files
+ * @param count Number of filenames
+ * @param languages Programming language of each filename, empty string if no associated language.
+ *                  Room for count languages.
+ */
+void classifyFilenames(const std::string_view* filenames, std::size_t count, std::string_view* languages);
+
 #endif
@@ -59,5 +59,23 @@ int main() {
     assert(filenameToLanguage(".aj")   == "AspectJ");
     assert(filenameToLanguage(".cs")   == "C#");
 
+    // paths, multiple extensions, and extensions too long to be languages
+    assert(filenameToLanguage("src/dir.d/file.cpp") == "C++");
+    assert(filenameToLanguage("file.txt.java")      == "Java");
+    assert(filenameToLanguage("file.java.txt")      == "");
+    assert(filenameToLanguage("file")               == "");
+    assert(filenameToLanguage("file.")              == "");
+    assert(filenameToLanguage("file.javajava")      == "");
+    assert(filenameToLanguage(std::string_view("file.c\0", 7)) == "");
+
+    // list of filenames
+    const std::string_view filenames[] = { "a.c", "b.txt", "c.hpp", "d.cs" };
+    std::string_view languages[4];
+    classifyFilenames(filenames, 4, languages);
+    assert(languages[0] == "C");
+    assert(languages[1] == "");
+    assert(languages[2] == "C++");
+    assert(languages[3] == "C#");
+
     return 0;
 }
@@ -0,0 +1,124 @@
+/*
+  @file LineCount.cpp
+
+  Implementation of counting lines of source code
+*/
+
+#include "LineCount.hpp"
+#include "CPUFeatures.hpp"
+
+#if defined(CODEANALYSIS_X86_64)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+    // number of newline characters
+    using CountNewlines = std::size_t (*)(const char* data, std::size_t size);
+
+    std::size_t countNewlinesScalar(const char* data, std::size_t size) {
+
+        std::size_t count = 0;
+        for (std::size_t pos = 0; pos < size; ++pos)
+            count += data[pos] == '\n';
+
+        return count;
+    }
+
+#if defined(CODEANALYSIS_X86_64)
+
+    // matches are accumulated as bytes, which hold at most 255 blocks
+    constexpr std::size_t MAX_BYTE_BLOCKS = 255;
+
+    std::size_t countNewlinesSSE2(const char* data, std::size_t size) {
+
+        const __m128i newline = _mm_set1_epi8('\n');
+
+        std::size_t count = 0;
+        std::size_t pos = 0;
+        while (size - pos >= 16) {
+
+            // each match subtracts -1 from its byte counter
+            __m128i counters = _mm_setzero_si128();
+            for (std::size_t block = 0; block < MAX_BYTE_BLOCKS && size - pos >= 16; ++block, pos += 16) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+                counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(bytes, newline));
+            }
+
+            // horizontal sum of the byte counters
+            const __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+            count += static_cast<std::size_t>(_mm_cvtsi128_si64(sums))
+                   + static_cast<std::size_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums)));
+        }
+
+        return count + countNewlinesScalar(data + pos, size - pos);
+    }
+
+#if defined(__GNUC__)
+    __attribute__((target("avx2")))
+#endif
+    std::size_t countNewlinesAVX2(const char* data, std::size_t size) {
+
+        const __m256i newline = _mm256_set1_epi8('\n');
+
+        std::size_t count = 0;
+        std::size_t pos = 0;
+        while (size - pos >= 32) {
+
+            // each match subtracts -1 from its byte counter
+            __m256i counters = _mm256_setzero_si256();
+            for (std::size_t block = 0; block < MAX_BYTE_BLOCKS && size - pos >= 32; ++block, pos += 32) {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+                counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(bytes, newline));
+            }
+
+            // horizontal sum of the byte counters
+            const __m256i sums = _mm256_sad_epu8(counters, _mm256_setzero_si256());
+            count += static_cast<std::size_t>(_mm256_extract_epi64(sums, 0)) + static_cast<std::size_t>(_mm256_extract_epi64(sums, 1))
+                   + static_cast<std::size_t>(_mm256_extract_epi64(sums, 2)) + static_cast<std::size_t>(_mm256_extract_epi64(sums, 3));
+        }
+
+        return count + countNewlinesSSE2(data + pos, size - pos);
+    }
+
+#endif
+
+    CountNewlines selectCountNewlines() {
+
+#if defined(CODEANALYSIS_X86_64)
+        if (cpuHasAVX2())
+            return countNewlinesAVX2;
+
+        return countNewlinesSSE2;
+#else
+        return countNewlinesScalar;
+#endif
+    }
+}
+
+/**
+ * Number of newline characters in the data
+ *
+ * @param data Source code, or any part of it
+ * @retval Number of '\n' characters
+ */
+std::size_t countNewlines(std::string_view data) {
+
+    static const CountNewlines countNewlinesKernel = selectCountNewlines();
+
+    return countNewlinesKernel(data.data(), data.size());
+}
+
+/**
+ * Number of lines in the source code
+ *
+ * @param sourceCode Complete source code
+ * @retval Number of lines
+ */
+std::size_t countLines(std::string_view sourceCode) {
+
+    // final line without a newline
+    const bool unterminated = !sourceCode.empty() && sourceCode.back() != '\n';
+
+    return countNewlines(sourceCode) + unterminated;
+}
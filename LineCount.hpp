@@ -0,0 +1,34 @@
+/*
+  @file LineCount.hpp
+
+  Counting lines of source code
+*/
+
+#ifndef INCLUDED_LINECOUNT_HPP
+#define INCLUDED_LINECOUNT_HPP
+
+#include <string_view>
+#include <cstddef>
+
+/**
+ * Number of newline characters in the data
+ *
+ * Uses the widest vector instructions the processor supports.
+ *
+ * @param data Source code, or any part of it
+ * @retval Number of '\n' characters
+ */
+std::size_t countNewlines(std::string_view data);
+
+/**
+ * Number of lines in the source code
+ *
+ * A final line without a newline is counted. Lines ending in
+ * CRLF are counted once.
+ *
+ * @param sourceCode Complete source code
+ * @retval Number of lines
+ */
+std::size_t countLines(std::string_view sourceCode);
+
+#endif
@@ -0,0 +1,46 @@
+/*
+  @file LineCountTest.cpp
+
+  Test program for countNewlines() and countLines()
+*/
+
+#include "LineCount.hpp"
+#include <string>
+#include <cassert>
+
+int main() {
+
+    // lines
+    assert(countLines("") == 0);
+    assert(countLines("\n") == 1);
+    assert(countLines("a = b;") == 1);
+    assert(countLines("a = b;\n") == 1);
+    assert(countLines("a = b;\nb = c;") == 2);
+    assert(countLines("\nif (a < b)\n    a = b;\n") == 3);
+
+    // CRLF and blank lines
+    assert(countLines("a = b;\r\nb = c;\r\n") == 2);
+    assert(countLines("a = b;\r\nb = c;") == 2);
+    assert(countLines("\r\n\r\n") == 2);
+    assert(countLines("\n\n\n") == 3);
+
+    // every position and length across vector blocks and tails
+    for (std::size_t size = 1; size <= 100; ++size) {
+        for (std::size_t pos = 0; pos < size; ++pos) {
+            std::string data(size, 'x');
+            data[pos] = '\n';
+            assert(countNewlines(data) == 1);
+        }
+        assert(countNewlines(std::string(size, '\n')) == size);
+    }
+
+    // more blocks than the byte counters hold
+    assert(countNewlines(std::string(100000, '\n')) == 100000);
+    std::string lines;
+    for (int i = 0; i < 20000; ++i)
+        lines += "line\n";
+    assert(countLines(lines) == 20000);
+    assert(countLines(lines + "last") == 20001);
+
+    return 0;
+}
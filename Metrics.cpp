@@ -0,0 +1,214 @@
+/*
+  @file Metrics.cpp
+
+  Implementation of the instrumentation of the stages of code analysis
+*/
+
+#include "Metrics.hpp"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+    constexpr std::size_t STAGES = static_cast<std::size_t>(MetricStage::COUNT);
+    constexpr std::size_t COUNTERS = static_cast<std::size_t>(MetricCounter::COUNT);
+
+    // histogram buckets, with bucket i for durations up to 2^i nanoseconds
+    constexpr std::size_t BUCKETS = 40;
+
+    constexpr const char* STAGE_NAMES[STAGES] = { "unit", "language", "filename", "attributes", "content" };
+
+    constexpr const char* COUNTER_NAMES[COUNTERS] = { "units", "content_bytes_in", "content_bytes_out", "output_bytes",
+                                                      "errors_extension", "errors_stdin_language", "errors_utf8" };
+
+    // metrics of a single thread, only written by that thread, so updates need no lock
+    struct ThreadMetrics {
+        std::array<std::atomic<std::uint64_t>, COUNTERS> counters{};
+        std::array<std::array<std::atomic<std::uint64_t>, BUCKETS>, STAGES> buckets{};
+        std::array<std::atomic<std::uint64_t>, STAGES> sums{};
+    };
+
+    // totals over all threads
+    struct Totals {
+        std::array<std::uint64_t, COUNTERS> counters{};
+        std::array<std::array<std::uint64_t, BUCKETS>, STAGES> buckets{};
+        std::array<std::uint64_t, STAGES> sums{};
+        std::array<std::uint64_t, STAGES> counts{};
+    };
+
+    // metrics of every thread that recorded any, kept after the thread exits
+    std::mutex registryMutex;
+    std::vector<std::shared_ptr<ThreadMetrics>>& registry() {
+
+        static std::vector<std::shared_ptr<ThreadMetrics>> threads;
+        return threads;
+    }
+
+    ThreadMetrics& threadMetrics() {
+
+        thread_local const std::shared_ptr<ThreadMetrics> metrics = []{
+            auto metrics = std::make_shared<ThreadMetrics>();
+            std::lock_guard<std::mutex> lock(registryMutex);
+            registry().push_back(metrics);
+            return metrics;
+        }();
+
+        return *metrics;
+    }
+
+    // increment by the single writer, without a locked instruction
+    inline void increment(std::atomic<std::uint64_t>& value, std::uint64_t amount) {
+
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    // histogram bucket of a duration
+    std::size_t bucketOf(std::uint64_t nanoseconds) {
+
+        std::size_t bucket = 0;
+        while (bucket + 1 < BUCKETS && (std::uint64_t(1) << bucket) < nanoseconds)
+            ++bucket;
+
+        return bucket;
+    }
+
+    Totals collect() {
+
+        Totals totals;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& metrics : registry()) {
+            for (std::size_t i = 0; i < COUNTERS; ++i)
+                totals.counters[i] += metrics->counters[i].load(std::memory_order_relaxed);
+            for (std::size_t stage = 0; stage < STAGES; ++stage) {
+                totals.sums[stage] += metrics->sums[stage].load(std::memory_order_relaxed);
+                for (std::size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+                    const std::uint64_t count = metrics->buckets[stage][bucket].load(std::memory_order_relaxed);
+                    totals.buckets[stage][bucket] += count;
+                    totals.counts[stage] += count;
+                }
+            }
+        }
+
+        return totals;
+    }
+
+    // ratio of escaped to unescaped content
+    double expansionRatio(const Totals& totals) {
+
+        const auto in = totals.counters[static_cast<std::size_t>(MetricCounter::CONTENT_BYTES_IN)];
+        const auto out = totals.counters[static_cast<std::size_t>(MetricCounter::CONTENT_BYTES_OUT)];
+
+        return in > 0 ? static_cast<double>(out) / static_cast<double>(in) : 1.0;
+    }
+}
+
+/**
+ * Add to a counter of the current thread
+ *
+ * @param counter Counter to add to
+ * @param value Amount to add
+ */
+void addMetric(MetricCounter counter, std::uint64_t value) {
+
+    increment(threadMetrics().counters[static_cast<std::size_t>(counter)], value);
+}
+
+/**
+ * Record the duration of a stage for the current thread
+ *
+ * @param stage Stage that ran
+ * @param nanoseconds Duration of the stage
+ */
+void recordMetric(MetricStage stage, std::uint64_t nanoseconds) {
+
+    ThreadMetrics& metrics = threadMetrics();
+    const auto index = static_cast<std::size_t>(stage);
+    increment(metrics.buckets[index][bucketOf(nanoseconds)], 1);
+    increment(metrics.sums[index], nanoseconds);
+}
+
+/**
+ * Metrics of all threads as JSON, with counters, the escape expansion ratio,
+ * and a latency histogram for each stage
+ */
+std::string metricsJSON() {
+
+    const Totals totals = collect();
+
+    std::ostringstream out;
+    out << "{\"enabled\": " << (METRICS_ENABLED ? "true" : "false") << ", \"counters\": {";
+    for (std::size_t i = 0; i < COUNTERS; ++i)
+        out << (i ? ", " : "") << '"' << COUNTER_NAMES[i] << "\": " << totals.counters[i];
+    out << "}, \"escape_expansion_ratio\": " << expansionRatio(totals) << ", \"stages\": {";
+    for (std::size_t stage = 0; stage < STAGES; ++stage) {
+        out << (stage ? ", " : "") << '"' << STAGE_NAMES[stage] << "\": {\"count\": " << totals.counts[stage]
+            << ", \"sum_ns\": " << totals.sums[stage] << ", \"buckets\": [";
+
+        // only buckets up to the longest duration
+        std::size_t last = BUCKETS;
+        while (last > 0 && totals.buckets[stage][last - 1] == 0)
+            --last;
+        for (std::size_t bucket = 0; bucket < last; ++bucket)
+            out << (bucket ? ", " : "") << "{\"le_ns\": " << (std::uint64_t(1) << bucket) << ", \"count\": " << totals.buckets[stage][bucket] << '}';
+        out << "]}";
+    }
+    out << "}}\n";
+
+    return out.str();
+}
+
+/**
+ * Metrics of all threads in the Prometheus text exposition format
+ */
+std::string metricsPrometheus() {
+
+    const Totals totals = collect();
+
+    std::ostringstream out;
+    for (std::size_t i = 0; i < COUNTERS; ++i) {
+        out << "# TYPE codeanalysis_" << COUNTER_NAMES[i] << "_total counter\n"
+            << "codeanalysis_" << COUNTER_NAMES[i] << "_total " << totals.counters[i] << '\n';
+    }
+
+    out << "# TYPE codeanalysis_escape_expansion_ratio gauge\n"
+        << "codeanalysis_escape_expansion_ratio " << expansionRatio(totals) << '\n';
+
+    // cumulative buckets in seconds
+    out << "# TYPE codeanalysis_stage_duration_seconds histogram\n";
+    for (std::size_t stage = 0; stage < STAGES; ++stage) {
+        std::uint64_t cumulative = 0;
+        for (std::size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+            cumulative += totals.buckets[stage][bucket];
+            out << "codeanalysis_stage_duration_seconds_bucket{stage=\"" << STAGE_NAMES[stage] << "\",le=\""
+                << static_cast<double>(std::uint64_t(1) << bucket) * 1e-9 << "\"} " << cumulative << '\n';
+        }
+        out << "codeanalysis_stage_duration_seconds_bucket{stage=\"" << STAGE_NAMES[stage] << "\",le=\"+Inf\"} " << totals.counts[stage] << '\n'
+            << "codeanalysis_stage_duration_seconds_sum{stage=\"" << STAGE_NAMES[stage] << "\"} " << static_cast<double>(totals.sums[stage]) * 1e-9 << '\n'
+            << "codeanalysis_stage_duration_seconds_count{stage=\"" << STAGE_NAMES[stage] << "\"} " << totals.counts[stage] << '\n';
+    }
+
+    return out.str();
+}
+
+/**
+ * Clear the metrics of all threads
+ *
+ * @pre No analysis is running
+ */
+void resetMetrics() {
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& metrics : registry()) {
+        for (auto& counter : metrics->counters)
+            counter.store(0, std::memory_order_relaxed);
+        for (auto& stage : metrics->buckets)
+            for (auto& bucket : stage)
+                bucket.store(0, std::memory_order_relaxed);
+        for (auto& sum : metrics->sums)
+            sum.store(0, std::memory_order_relaxed);
+    }
+}
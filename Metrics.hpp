@@ -0,0 +1,113 @@
+/*
+  @file Metrics.hpp
+
+  Optional instrumentation of the stages of code analysis
+
+  Enabled by defining CODEANALYSIS_METRICS. Otherwise, the instrumentation
+  macros expand to nothing, so the analysis has no overhead.
+*/
+
+#ifndef INCLUDED_METRICS_HPP
+#define INCLUDED_METRICS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/** Timed stages of the analysis */
+enum class MetricStage {
+    UNIT,           // generation of a whole unit
+    LANGUAGE,       // language detection
+    FILENAME,       // filename resolution
+    ATTRIBUTES,     // start tag and attributes
+    CONTENT,        // escaping, hashing, and counting the content
+    COUNT
+};
+
+/** Counted events and sizes of the analysis */
+enum class MetricCounter {
+    UNITS,                  // units generated
+    CONTENT_BYTES_IN,       // content before escaping
+    CONTENT_BYTES_OUT,      // content after escaping
+    OUTPUT_BYTES,           // XML generated
+    ERRORS_EXTENSION,       // "Extension not supported"
+    ERRORS_STDIN_LANGUAGE,  // "Using stdin requires a declared language"
+    ERRORS_UTF8,            // "Content is not valid UTF-8"
+    COUNT
+};
+
+/** Whether the analysis is instrumented */
+#if defined(CODEANALYSIS_METRICS)
+constexpr bool METRICS_ENABLED = true;
+#else
+constexpr bool METRICS_ENABLED = false;
+#endif
+
+/**
+ * Add to a counter of the current thread
+ *
+ * @param counter Counter to add to
+ * @param value Amount to add
+ */
+void addMetric(MetricCounter counter, std::uint64_t value);
+
+/**
+ * Record the duration of a stage for the current thread
+ *
+ * @param stage Stage that ran
+ * @param nanoseconds Duration of the stage
+ */
+void recordMetric(MetricStage stage, std::uint64_t nanoseconds);
+
+/**
+ * Records the time from construction to destruction as a stage
+ */
+class MetricTimer {
+public:
+
+    explicit MetricTimer(MetricStage stage) : stage(stage), start(std::chrono::steady_clock::now()) {}
+
+    ~MetricTimer() {
+
+        const auto duration = std::chrono::steady_clock::now() - start;
+        recordMetric(stage, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+    }
+
+    MetricTimer(const MetricTimer&) = delete;
+    MetricTimer& operator=(const MetricTimer&) = delete;
+
+private:
+    MetricStage stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * Metrics of all threads as JSON, with counters, the escape expansion ratio,
+ * and a latency histogram for each stage
+ */
+std::string metricsJSON();
+
+/**
+ * Metrics of all threads in the Prometheus text exposition format
+ */
+std::string metricsPrometheus();
+
+/**
+ * Clear the metrics of all threads
+ *
+ * @pre No analysis is running
+ */
+void resetMetrics();
+
+#if defined(CODEANALYSIS_METRICS)
+#define CODEANALYSIS_METRIC_CONCAT(a, b) a##b
+#define CODEANALYSIS_METRIC_NAME(line) CODEANALYSIS_METRIC_CONCAT(metricTimer, line)
+#define CODEANALYSIS_METRIC_TIMER(stage) const MetricTimer CODEANALYSIS_METRIC_NAME(__LINE__)(MetricStage::stage)
+#define CODEANALYSIS_METRIC_ADD(counter, value) addMetric(MetricCounter::counter, (value))
+#else
+#define CODEANALYSIS_METRIC_TIMER(stage) static_cast<void>(0)
+#define CODEANALYSIS_METRIC_ADD(counter, value) static_cast<void>(0)
+#endif
+
+#endif
@@ -0,0 +1,72 @@
+/*
+  @file MetricsTest.cpp
+
+  Test program for the metrics of code analysis, built with CODEANALYSIS_METRICS
+*/
+
+#include "Metrics.hpp"
+#include "CodeAnalysis.hpp"
+#include <string>
+#include <thread>
+#include <cassert>
+
+int main() {
+
+    static_assert(METRICS_ENABLED, "Test requires CODEANALYSIS_METRICS");
+
+    // counters and stages from different threads are combined
+    {
+        resetMetrics();
+        addMetric(MetricCounter::UNITS, 2);
+        std::thread other([]{
+            addMetric(MetricCounter::UNITS, 3);
+            recordMetric(MetricStage::LANGUAGE, 100);
+        });
+        other.join();
+        recordMetric(MetricStage::LANGUAGE, 1);
+
+        const std::string json = metricsJSON();
+        assert(json.find(R"("enabled": true)") != std::string::npos);
+        assert(json.find(R"("units": 5)") != std::string::npos);
+        assert(json.find(R"("language": {"count": 2, "sum_ns": 101, "buckets": [{"le_ns": 1, "count": 1})") != std::string::npos);
+        assert(json.find(R"({"le_ns": 128, "count": 1}]})") != std::string::npos);
+
+        const std::string prometheus = metricsPrometheus();
+        assert(prometheus.find("codeanalysis_units_total 5\n") != std::string::npos);
+        assert(prometheus.find(R"(codeanalysis_stage_duration_seconds_bucket{stage="language",le="1e-09"} 1)") != std::string::npos);
+        assert(prometheus.find(R"(codeanalysis_stage_duration_seconds_bucket{stage="language",le="+Inf"} 2)") != std::string::npos);
+        assert(prometheus.find(R"(codeanalysis_stage_duration_seconds_count{stage="language"} 2)") != std::string::npos);
+
+        resetMetrics();
+        assert(metricsJSON().find(R"("units": 0)") != std::string::npos);
+    }
+
+    // analysis stages, sizes, and errors
+    {
+        AnalysisRequest request;
+        request.sourceCode   = "a < b;\n";
+        request.diskFilename = "main.cpp";
+        formatAnalysisXML(request);
+
+        request.diskFilename = "main.txt";
+        formatAnalysisXML(request);
+
+        request.diskFilename = "-";
+        request.entryFilename = "data";
+        formatAnalysisXML(request);
+
+        const std::string json = metricsJSON();
+        assert(json.find(R"("units": 1)") != std::string::npos);
+        assert(json.find(R"("content_bytes_in": 7)") != std::string::npos);
+        assert(json.find(R"("content_bytes_out": 10)") != std::string::npos);
+        assert(json.find(R"("errors_extension": 1)") != std::string::npos);
+        assert(json.find(R"("errors_stdin_language": 1)") != std::string::npos);
+        assert(json.find(R"("unit": {"count": 3)") != std::string::npos);
+        assert(json.find(R"("content": {"count": 1)") != std::string::npos);
+
+        const std::string xml = [&]{ request.diskFilename = "main.cpp"; request.entryFilename = ""; return formatAnalysisXML(request); }();
+        assert(metricsJSON().find(R"("output_bytes": )" + std::to_string(2 * xml.size())) != std::string::npos);
+    }
+
+    return 0;
+}
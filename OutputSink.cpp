@@ -0,0 +1,307 @@
+/*
+  @file OutputSink.cpp
+
+  Implementation of destinations for generated XML
+*/
+
+#include "OutputSink.hpp"
+#include "XMLEscape.hpp"
+#include <stdexcept>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+
+namespace {
+
+    // most pieces a single writev() accepts
+    constexpr std::size_t MAX_PIECES = IOV_MAX;
+}
+
+/**
+ * Append content escaped for XML, writing unescaped runs whole
+ *
+ * @param content Non-element content
+ */
+void OutputSink::writeEscaped(std::string_view content) {
+
+    while (!content.empty()) {
+
+        const auto pos = findEscape(content);
+        write(content.substr(0, pos));
+        if (pos == content.size())
+            break;
+
+        write(escapeEntity(content[pos]));
+        content.remove_prefix(pos + 1);
+    }
+}
+
+/**
+ * Measure content escaped for XML without producing it
+ *
+ * @param content Non-element content
+ */
+void CountingSink::writeEscaped(std::string_view content) {
+
+    count += escapedSize(content);
+}
+
+/**
+ * Append data to the string
+ *
+ * @param data Bytes to append
+ */
+template<typename String>
+void BasicStringSink<String>::write(std::string_view data) {
+
+    out.append(data);
+}
+
+template class BasicStringSink<std::string>;
+template class BasicStringSink<std::pmr::string>;
+
+/**
+ * @param capacity Size of the internal buffer, non-zero
+ */
+BufferedSink::BufferedSink(std::size_t capacity)
+    : buffer(new char[capacity]), capacity(capacity) {
+
+    if (capacity == 0)
+        throw std::invalid_argument("Requires non-zero buffer capacity");
+}
+
+/**
+ * Append data to the buffer, passing full buffers on to the destination
+ *
+ * @param data Bytes to append
+ */
+void BufferedSink::write(std::string_view data) {
+
+    // room in the buffer
+    if (data.size() <= capacity - used) {
+        std::memcpy(buffer.get() + used, data.data(), data.size());
+        used += data.size();
+        return;
+    }
+
+    flush();
+
+    // too large to be worth buffering
+    if (data.size() >= capacity) {
+        writeThrough(data);
+        return;
+    }
+
+    std::memcpy(buffer.get(), data.data(), data.size());
+    used = data.size();
+}
+
+/**
+ * Pass buffered output on to the destination
+ */
+void BufferedSink::flush() {
+
+    if (used == 0)
+        return;
+
+    // reset first so a failed write does not repeat the data
+    const std::size_t size = used;
+    used = 0;
+    writeThrough(std::string_view(buffer.get(), size));
+}
+
+StreamSink::~StreamSink() {
+
+    try {
+        flush();
+        out.flush();
+    } catch (...) {}
+}
+
+/**
+ * Write data directly to the stream
+ *
+ * @param data Bytes to write
+ */
+void StreamSink::writeThrough(std::string_view data) {
+
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+FileDescriptorSink::~FileDescriptorSink() {
+
+    try {
+        flush();
+    } catch (...) {}
+}
+
+/**
+ * Write data directly to the file descriptor, completing partial writes
+ *
+ * @param data Bytes to write
+ * @throw std::system_error on a failed write
+ */
+void FileDescriptorSink::writeThrough(std::string_view data) {
+
+    while (!data.empty()) {
+        const ssize_t count = ::write(fd, data.data(), data.size());
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::generic_category(), "write");
+        }
+        data.remove_prefix(static_cast<std::size_t>(count));
+    }
+}
+
+/**
+ * @param fd Open file descriptor
+ * @param capacity Size of the internal buffer, non-zero
+ */
+WritevSink::WritevSink(int fd, std::size_t capacity)
+    : fd(fd), buffer(new char[capacity]), capacity(capacity) {
+
+    if (capacity == 0)
+        throw std::invalid_argument("Requires non-zero buffer capacity");
+
+    pieces.reserve(MAX_PIECES);
+}
+
+WritevSink::~WritevSink() {
+
+    try {
+        flush();
+    } catch (...) {}
+}
+
+/**
+ * Append data, referencing data too large to be worth buffering
+ *
+ * @param data Bytes to append
+ * @throw std::system_error on a failed write
+ */
+void WritevSink::write(std::string_view data) {
+
+    if (data.size() < capacity) {
+        copy(data);
+        return;
+    }
+
+    // written with the buffered output in a single call
+    reference(data);
+    writePieces();
+}
+
+/**
+ * Append content escaped for XML, referencing long unescaped runs
+ *
+ * @param content Non-element content
+ * @throw std::system_error on a failed write
+ */
+void WritevSink::writeEscaped(std::string_view content) {
+
+    bool referenced = false;
+    while (!content.empty()) {
+
+        const auto pos = findEscape(content);
+        const auto run = content.substr(0, pos);
+        if (run.size() >= MIN_REFERENCED) {
+            reference(run);
+            referenced = true;
+        } else {
+            copy(run);
+        }
+        if (pos == content.size())
+            break;
+
+        // an entity is shorter than its piece
+        copy(escapeEntity(content[pos]));
+        content.remove_prefix(pos + 1);
+    }
+
+    // content is not valid after the call
+    if (referenced)
+        writePieces();
+}
+
+/**
+ * Write all pieces to the file descriptor
+ *
+ * @throw std::system_error on a failed write
+ */
+void WritevSink::flush() {
+
+    writePieces();
+}
+
+// append data to the buffer as a piece
+void WritevSink::copy(std::string_view data) {
+
+    if (data.empty())
+        return;
+
+    if (data.size() > capacity - used || pieces.size() == MAX_PIECES)
+        writePieces();
+
+    // larger than the whole buffer, e.g., a short run with a small capacity
+    if (data.size() > capacity) {
+        reference(data);
+        writePieces();
+        return;
+    }
+
+    char* const start = buffer.get() + used;
+    std::memcpy(start, data.data(), data.size());
+    used += data.size();
+
+    // extend the previous piece when it ends where the data starts
+    if (!pieces.empty() && static_cast<char*>(pieces.back().iov_base) + pieces.back().iov_len == start)
+        pieces.back().iov_len += data.size();
+    else
+        pieces.push_back({ start, data.size() });
+}
+
+// append data in place as a piece
+void WritevSink::reference(std::string_view data) {
+
+    if (pieces.size() == MAX_PIECES)
+        writePieces();
+
+    pieces.push_back({ const_cast<char*>(data.data()), data.size() });
+}
+
+// write all pieces, completing partial writes, and empty the buffer
+void WritevSink::writePieces() {
+
+    std::size_t first = 0;
+    while (first < pieces.size()) {
+
+        const ssize_t count = ::writev(fd, pieces.data() + first, static_cast<int>(pieces.size() - first));
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+
+            // reset so a failed write does not repeat the data
+            const int error = errno;
+            pieces.clear();
+            used = 0;
+            throw std::system_error(error, std::generic_category(), "write");
+        }
+
+        // skip the pieces written, and trim a partially written piece
+        auto written = static_cast<std::size_t>(count);
+        while (first < pieces.size() && written >= pieces[first].iov_len) {
+            written -= pieces[first].iov_len;
+            ++first;
+        }
+        if (written > 0) {
+            pieces[first].iov_base = static_cast<char*>(pieces[first].iov_base) + written;
+            pieces[first].iov_len -= written;
+        }
+    }
+
+    pieces.clear();
+    used = 0;
+}
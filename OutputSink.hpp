@@ -0,0 +1,254 @@
+/*
+  @file OutputSink.hpp
+
+  Destinations for generated XML
+*/
+
+#ifndef INCLUDED_OUTPUTSINK_HPP
+#define INCLUDED_OUTPUTSINK_HPP
+
+#include <string>
+#include <string_view>
+#include <memory_resource>
+#include <ostream>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <sys/uio.h>
+
+/**
+ * Destination for generated output
+ *
+ * Writers only append. Any buffered output reaches the destination
+ * after flush().
+ */
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+
+    /**
+     * Append data to the output
+     *
+     * @param data Bytes to append
+     */
+    virtual void write(std::string_view data) = 0;
+
+    /**
+     * Append content escaped for XML
+     *
+     * By default, unescaped runs and entities are passed to write().
+     *
+     * @param content Non-element content
+     */
+    virtual void writeEscaped(std::string_view content);
+
+    /**
+     * Deliver any buffered output to the destination
+     */
+    virtual void flush() {}
+
+    /**
+     * Whether output is only measured, so values written do not matter
+     */
+    virtual bool measuring() const { return false; }
+};
+
+/**
+ * Output that is only measured
+ */
+class CountingSink : public OutputSink {
+public:
+
+    void write(std::string_view data) override { count += data.size(); }
+
+    void writeEscaped(std::string_view content) override;
+
+    bool measuring() const override { return true; }
+
+    /**
+     * Number of bytes written
+     */
+    std::size_t size() const { return count; }
+
+private:
+    std::size_t count = 0;
+};
+
+/**
+ * Output appended to a caller-owned string
+ *
+ * Instantiated for std::string, and std::pmr::string so a batch can keep its
+ * output in a memory resource, e.g., a monotonic arena released in one reset.
+ */
+template<typename String>
+class BasicStringSink : public OutputSink {
+public:
+
+    /**
+     * @param out String the output is appended to. Must outlive the sink.
+     */
+    explicit BasicStringSink(String& out) : out(out) {}
+
+    void write(std::string_view data) override;
+
+private:
+    String& out;
+};
+
+extern template class BasicStringSink<std::string>;
+extern template class BasicStringSink<std::pmr::string>;
+
+using StringSink = BasicStringSink<std::string>;
+using PmrStringSink = BasicStringSink<std::pmr::string>;
+
+/**
+ * Output collected in a bounded internal buffer, and passed
+ * on to the destination whenever the buffer fills
+ *
+ * Writes larger than the buffer bypass it.
+ */
+class BufferedSink : public OutputSink {
+public:
+
+    /** Default size of the internal buffer */
+    static constexpr std::size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    /**
+     * @param capacity Size of the internal buffer, non-zero
+     */
+    explicit BufferedSink(std::size_t capacity = DEFAULT_CAPACITY);
+
+    void write(std::string_view data) override;
+
+    void flush() override;
+
+protected:
+
+    /**
+     * Write data directly to the destination
+     *
+     * @param data Bytes to write
+     */
+    virtual void writeThrough(std::string_view data) = 0;
+
+private:
+    std::unique_ptr<char[]> buffer;
+    std::size_t capacity;
+    std::size_t used = 0;
+};
+
+/**
+ * Output to a std::ostream
+ */
+class StreamSink : public BufferedSink {
+public:
+
+    /**
+     * @param out Output stream. Must outlive the sink.
+     * @param capacity Size of the internal buffer
+     */
+    explicit StreamSink(std::ostream& out, std::size_t capacity = DEFAULT_CAPACITY)
+        : BufferedSink(capacity), out(out) {}
+
+    /** Flushes any remaining output, ignoring errors */
+    ~StreamSink() override;
+
+protected:
+    void writeThrough(std::string_view data) override;
+
+private:
+    std::ostream& out;
+};
+
+/**
+ * Output to a raw POSIX file descriptor
+ *
+ * The file descriptor is not closed by the sink.
+ */
+class FileDescriptorSink : public BufferedSink {
+public:
+
+    /**
+     * @param fd Open file descriptor
+     * @param capacity Size of the internal buffer
+     */
+    explicit FileDescriptorSink(int fd, std::size_t capacity = DEFAULT_CAPACITY)
+        : BufferedSink(capacity), fd(fd) {}
+
+    /** Flushes any remaining output, ignoring errors */
+    ~FileDescriptorSink() override;
+
+protected:
+
+    /**
+     * @throw std::system_error on a failed write
+     */
+    void writeThrough(std::string_view data) override;
+
+private:
+    int fd;
+};
+
+/**
+ * Output to a raw POSIX file descriptor, gathered with writev()
+ *
+ * Markup and short runs are copied into an internal buffer, while long runs
+ * of content that need no escaping are referenced in place, so mostly
+ * clean source code reaches the destination without a copy in user space.
+ * Referenced runs are written before writeEscaped() returns, as the content
+ * is only valid for the call.
+ *
+ * The file descriptor is not closed by the sink.
+ */
+class WritevSink : public OutputSink {
+public:
+
+    /** Default size of the internal buffer */
+    static constexpr std::size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    /** Size of the shortest unescaped run referenced instead of copied */
+    static constexpr std::size_t MIN_REFERENCED = 256;
+
+    /**
+     * @param fd Open file descriptor
+     * @param capacity Size of the internal buffer, non-zero
+     */
+    explicit WritevSink(int fd, std::size_t capacity = DEFAULT_CAPACITY);
+
+    /** Flushes any remaining output, ignoring errors */
+    ~WritevSink() override;
+
+    /**
+     * @throw std::system_error on a failed write
+     */
+    void write(std::string_view data) override;
+
+    /**
+     * @throw std::system_error on a failed write
+     */
+    void writeEscaped(std::string_view content) override;
+
+    /**
+     * @throw std::system_error on a failed write
+     */
+    void flush() override;
+
+private:
+
+    // append data to the buffer as a piece
+    void copy(std::string_view data);
+
+    // append data in place as a piece
+    void reference(std::string_view data);
+
+    // write all pieces, and empty the buffer
+    void writePieces();
+
+    int fd;
+    std::unique_ptr<char[]> buffer;
+    std::size_t capacity;
+    std::size_t used = 0;
+    std::vector<iovec> pieces;
+};
+
+#endif
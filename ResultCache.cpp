@@ -0,0 +1,335 @@
+/*
+  @file ResultCache.cpp
+
+  Implementation of the persistent cache of generated units
+*/
+
+#include "ResultCache.hpp"
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <cerrno>
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+    // changes whenever the generated units change for the same request
+    constexpr std::string_view FORMAT_VERSION = "codeanalysis-unit-3";
+
+    // distinguishes temporary files of concurrent stores
+    std::atomic<unsigned long> temporaryCount{0};
+
+    // create the directory unless it exists
+    void makeDirectory(const std::string& path) {
+
+        if (::mkdir(path.c_str(), 0777) < 0 && errno != EEXIST)
+            throw std::system_error(errno, std::generic_category(), path);
+    }
+
+    // add a field to the key, prefixed by its size so fields cannot run together
+    void addField(SHA1& hash, std::string_view field) {
+
+        const std::string size = std::to_string(field.size()) + ':';
+        hash.update(size);
+        hash.update(field);
+    }
+
+    // write all the data to the file descriptor
+    bool writeAll(int fd, std::string_view data) {
+
+        while (!data.empty()) {
+            const ssize_t count = ::write(fd, data.data(), data.size());
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            data.remove_prefix(static_cast<std::size_t>(count));
+        }
+
+        return true;
+    }
+}
+
+/**
+ * Open the cache, creating the directory when needed
+ *
+ * @param directory Directory of the cache
+ * @throw std::system_error if the directory cannot be created
+ */
+ResultCache::ResultCache(const std::string& directory)
+    : directory(directory) {
+
+    makeDirectory(directory);
+    makeDirectory(directory + "/units");
+
+    // a missing or damaged manifest only means files are read again
+    std::ifstream in(directory + "/manifest");
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        FileStatus status;
+        std::string hash;
+        if (!(fields >> status.size >> status.seconds >> status.nanoseconds >> status.inode >> hash))
+            continue;
+        if (hash.size() != SHA1::HEX_SIZE || fields.get() != ' ')
+            continue;
+
+        std::string path;
+        std::getline(fields, path);
+        if (path.empty())
+            continue;
+
+        hash.copy(status.contentHash.data(), SHA1::HEX_SIZE);
+        manifest[path] = status;
+    }
+}
+
+/** Saves the manifest */
+ResultCache::~ResultCache() {
+
+    try {
+        save();
+    } catch (const std::system_error&) {
+        // files are read again on the next run
+    }
+}
+
+/**
+ * Key of the unit for the request
+ *
+ * @param request Data that forms the request, except for the sourceCode
+ * @param contentHash SHA-1 of the sourceCode
+ * @retval Key of the unit
+ */
+ResultCache::Key ResultCache::key(const AnalysisRequestView& request, const SHA1::HexDigest& contentHash) {
+
+    SHA1 hash;
+    addField(hash, FORMAT_VERSION);
+    addField(hash, std::string_view(contentHash.data(), contentHash.size()));
+    addField(hash, request.diskFilename);
+    addField(hash, request.entryFilename);
+    addField(hash, request.optionFilename);
+    addField(hash, request.sourceURL);
+    addField(hash, request.optionURL);
+    addField(hash, request.optionLanguage);
+    addField(hash, request.defaultLanguage);
+    addField(hash, request.optionHash);
+    addField(hash, request.computeHash ? "1" : "0");
+    addField(hash, std::to_string(request.optionLOC));
+    addField(hash, request.computeLOC ? "1" : "0");
+    addField(hash, request.timestamp);
+
+    return hash.finish();
+}
+
+/**
+ * SHA-1 of the content of a file that is unchanged since it was recorded
+ *
+ * @param path Path of the file
+ * @param status Current status of the file
+ * @param contentHash SHA-1 of the content, when unchanged
+ * @retval true File is unchanged
+ */
+bool ResultCache::unchanged(const std::string& path, const struct stat& status, SHA1::HexDigest& contentHash) const {
+
+    std::lock_guard<std::mutex> lock(manifestMutex);
+
+    const auto entry = manifest.find(path);
+    if (entry == manifest.end())
+        return false;
+
+    const FileStatus& recorded = entry->second;
+    if (recorded.size != static_cast<std::uint64_t>(status.st_size)
+        || recorded.seconds != static_cast<std::int64_t>(status.st_mtim.tv_sec)
+        || recorded.nanoseconds != static_cast<std::int64_t>(status.st_mtim.tv_nsec)
+        || recorded.inode != static_cast<std::uint64_t>(status.st_ino))
+        return false;
+
+    contentHash = recorded.contentHash;
+    usedPaths.insert(path);
+
+    return true;
+}
+
+/**
+ * Record the SHA-1 of the content of a file
+ *
+ * @param path Path of the file
+ * @param status Status of the file before it was read
+ * @param contentHash SHA-1 of the content
+ */
+void ResultCache::record(const std::string& path, const struct stat& status, const SHA1::HexDigest& contentHash) {
+
+    // manifest lines end at a newline
+    if (path.empty() || path.find('\n') != std::string::npos)
+        return;
+
+    FileStatus recorded;
+    recorded.size = static_cast<std::uint64_t>(status.st_size);
+    recorded.seconds = static_cast<std::int64_t>(status.st_mtim.tv_sec);
+    recorded.nanoseconds = static_cast<std::int64_t>(status.st_mtim.tv_nsec);
+    recorded.inode = static_cast<std::uint64_t>(status.st_ino);
+    recorded.contentHash = contentHash;
+
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    manifest[path] = recorded;
+    usedPaths.insert(path);
+    modified = true;
+}
+
+/**
+ * Map in a stored unit
+ *
+ * @param key Key of the unit
+ * @param unit File the unit is loaded into
+ * @retval true Unit found
+ */
+bool ResultCache::load(const Key& key, SourceFile& unit) const {
+
+    try {
+        unit.open(unitPath(key));
+    } catch (const std::system_error&) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    usedKeys.emplace(key.data(), key.size());
+
+    return true;
+}
+
+/**
+ * Store a unit
+ *
+ * Written to a temporary file that is renamed, so a unit is never seen partially written.
+ *
+ * @param key Key of the unit
+ * @param unit Generated unit
+ */
+void ResultCache::store(const Key& key, std::string_view unit) {
+
+    const std::string path = unitPath(key);
+    const std::string temporary = path + '.' + std::to_string(::getpid()) + '.' + std::to_string(temporaryCount++);
+
+    const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd < 0)
+        return;
+
+    const bool written = writeAll(fd, unit);
+    if (::close(fd) < 0 || !written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        ::unlink(temporary.c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    usedKeys.emplace(key.data(), key.size());
+}
+
+/**
+ * Remove the manifest entries and units not used since the cache was opened
+ *
+ * Only units named by a key are removed, so temporary files of a concurrent store are kept.
+ *
+ * @retval Number of units removed
+ */
+std::size_t ResultCache::prune() {
+
+    std::lock_guard<std::mutex> lock(manifestMutex);
+
+    for (auto entry = manifest.begin(); entry != manifest.end(); ) {
+        if (usedPaths.count(entry->first)) {
+            ++entry;
+            continue;
+        }
+        entry = manifest.erase(entry);
+        modified = true;
+    }
+
+    const std::string units = directory + "/units";
+    DIR* listing = ::opendir(units.c_str());
+    if (!listing)
+        return 0;
+
+    std::size_t removed = 0;
+    while (const dirent* entry = ::readdir(listing)) {
+        const std::string_view name = entry->d_name;
+        if (name.size() != SHA1::HEX_SIZE || name.find('.') != std::string_view::npos)
+            continue;
+        if (usedKeys.count(std::string(name)))
+            continue;
+        if (::unlink((units + '/' + entry->d_name).c_str()) == 0)
+            ++removed;
+    }
+    ::closedir(listing);
+
+    return removed;
+}
+
+/**
+ * Write the manifest, replacing the previous one
+ *
+ * @throw std::system_error if the manifest cannot be written
+ */
+void ResultCache::save() {
+
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    if (!modified)
+        return;
+
+    std::string text;
+    for (const auto& [path, status] : manifest) {
+        text += std::to_string(status.size);
+        text += ' ';
+        text += std::to_string(status.seconds);
+        text += ' ';
+        text += std::to_string(status.nanoseconds);
+        text += ' ';
+        text += std::to_string(status.inode);
+        text += ' ';
+        text.append(status.contentHash.data(), status.contentHash.size());
+        text += ' ';
+        text += path;
+        text += '\n';
+    }
+
+    const std::string path = directory + "/manifest";
+    const std::string temporary = path + '.' + std::to_string(::getpid());
+    const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), temporary);
+
+    // remove the partial manifest, keeping the error of the failed call
+    auto fail = [&temporary](const std::string& what) {
+        const int error = errno;
+        ::unlink(temporary.c_str());
+        throw std::system_error(error, std::generic_category(), what);
+    };
+
+    if (!writeAll(fd, text)) {
+        const int error = errno;
+        ::close(fd);
+        errno = error;
+        fail(temporary);
+    }
+    if (::close(fd) < 0)
+        fail(temporary);
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        fail(path);
+
+    modified = false;
+}
+
+// path of the stored unit
+std::string ResultCache::unitPath(const Key& key) const {
+
+    std::string path = directory;
+    path += "/units/";
+    path.append(key.data(), key.size());
+
+    return path;
+}
@@ -0,0 +1,148 @@
+/*
+  @file ResultCache.hpp
+
+  Persistent cache of generated units for incremental re-analysis
+*/
+
+#ifndef INCLUDED_RESULTCACHE_HPP
+#define INCLUDED_RESULTCACHE_HPP
+
+#include "AnalysisRequest.hpp"
+#include "SHA1.hpp"
+#include "SourceFile.hpp"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <sys/stat.h>
+
+/**
+ * On-disk cache of generated units, and a manifest of the files they came from
+ *
+ * Units are stored by a key formed from the SHA-1 of the content and every
+ * field of the request that affects the unit, e.g., the filenames, URLs,
+ * language, and options. The language of a unit is resolved from these fields,
+ * so the key covers it. A hit maps the stored unit back in with a SourceFile.
+ *
+ * The manifest records the size, modification time, and inode of each file
+ * with the SHA-1 of its content, so an unchanged file is found in the cache
+ * without being read.
+ *
+ * Layout of the directory:
+ *   manifest      Lines of "size mtime-seconds mtime-nanoseconds inode hash path"
+ *   units/<key>   Generated unit, with the key as 40 hex characters
+ *
+ * Entries of files that no longer exist, and units of old content or options,
+ * are kept until pruned. After a run over the whole tree, prune() removes the
+ * manifest entries and units that the run did not use.
+ *
+ * All methods may be called from multiple threads. Failures to store are not
+ * errors, as the unit is regenerated on the next run.
+ */
+class ResultCache {
+public:
+
+    /** Key of a unit, as 40 lowercase hex characters */
+    using Key = SHA1::HexDigest;
+
+    /**
+     * Open the cache, creating the directory when needed
+     *
+     * @param directory Directory of the cache
+     * @throw std::system_error if the directory cannot be created
+     */
+    explicit ResultCache(const std::string& directory);
+
+    /** Saves the manifest */
+    ~ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    /**
+     * Key of the unit for the request
+     *
+     * @param request Data that forms the request, except for the sourceCode
+     * @param contentHash SHA-1 of the sourceCode
+     * @retval Key of the unit
+     */
+    static Key key(const AnalysisRequestView& request, const SHA1::HexDigest& contentHash);
+
+    /**
+     * SHA-1 of the content of a file that is unchanged since it was recorded
+     *
+     * @param path Path of the file
+     * @param status Current status of the file
+     * @param contentHash SHA-1 of the content, when unchanged
+     * @retval true File is unchanged
+     */
+    bool unchanged(const std::string& path, const struct stat& status, SHA1::HexDigest& contentHash) const;
+
+    /**
+     * Record the SHA-1 of the content of a file
+     *
+     * @param path Path of the file
+     * @param status Status of the file before it was read
+     * @param contentHash SHA-1 of the content
+     */
+    void record(const std::string& path, const struct stat& status, const SHA1::HexDigest& contentHash);
+
+    /**
+     * Map in a stored unit
+     *
+     * @param key Key of the unit
+     * @param unit File the unit is loaded into
+     * @retval true Unit found
+     */
+    bool load(const Key& key, SourceFile& unit) const;
+
+    /**
+     * Store a unit
+     *
+     * @param key Key of the unit
+     * @param unit Generated unit
+     */
+    void store(const Key& key, std::string_view unit);
+
+    /**
+     * Remove the manifest entries and units not used since the cache was opened
+     *
+     * Only for a run over every file of the cache, as the entries and units of
+     * any other files are removed.
+     *
+     * @retval Number of units removed
+     */
+    std::size_t prune();
+
+    /**
+     * Write the manifest, replacing the previous one
+     *
+     * @throw std::system_error if the manifest cannot be written
+     */
+    void save();
+
+private:
+
+    // status of a file when its content was hashed
+    struct FileStatus {
+        std::uint64_t size = 0;
+        std::int64_t seconds = 0;
+        std::int64_t nanoseconds = 0;
+        std::uint64_t inode = 0;
+        SHA1::HexDigest contentHash;
+    };
+
+    // path of the stored unit
+    std::string unitPath(const Key& key) const;
+
+    std::string directory;
+    std::unordered_map<std::string, FileStatus> manifest;
+    mutable std::unordered_set<std::string> usedPaths;
+    mutable std::unordered_set<std::string> usedKeys;
+    mutable std::mutex manifestMutex;
+    bool modified = false;
+};
+
+#endif
@@ -0,0 +1,140 @@
+/*
+  @file ResultCacheTest.cpp
+
+  Test program for ResultCache
+*/
+
+#include "ResultCache.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <cassert>
+
+int main() {
+
+    const std::filesystem::path root = "ResultCacheTest.cache";
+    std::filesystem::remove_all(root);
+
+    AnalysisRequest request;
+    request.diskFilename = "main.cpp";
+    request.optionLOC    = -1;
+    const SHA1::HexDigest contentHash = sha1Hex("a = b;\n");
+
+    // keys differ by content and by any field that affects the unit
+    {
+        [[maybe_unused]] const ResultCache::Key key = ResultCache::key(request, contentHash);
+        assert(ResultCache::key(request, contentHash) == key);
+        assert(ResultCache::key(request, sha1Hex("a = c;\n")) != key);
+
+        AnalysisRequest other = request;
+        other.optionURL = "https://mlcollard.net";
+        assert(ResultCache::key(other, contentHash) != key);
+
+        other = request;
+        other.computeLOC = true;
+        assert(ResultCache::key(other, contentHash) != key);
+
+        // fields cannot run together
+        other = request;
+        other.diskFilename = "main.cp";
+        other.entryFilename = "p";
+        assert(ResultCache::key(other, contentHash) != key);
+    }
+
+    // stored units are loaded, and missing units are not
+    {
+        ResultCache cache(root.string());
+        const ResultCache::Key key = ResultCache::key(request, contentHash);
+
+        SourceFile unit;
+        assert(!cache.load(key, unit));
+        cache.store(key, "<code:unit/>\n");
+        assert(cache.load(key, unit));
+        assert(unit.content() == "<code:unit/>\n");
+    }
+
+    // manifest persists, and a changed file is not unchanged
+    {
+        const std::string path = (root / "main.cpp").string();
+        std::ofstream(path) << "a = b;\n";
+        struct stat status;
+        [[maybe_unused]] const int statted = ::stat(path.c_str(), &status);
+        assert(statted == 0);
+
+        {
+            ResultCache cache(root.string());
+            [[maybe_unused]] SHA1::HexDigest hash{};
+            assert(!cache.unchanged(path, status, hash));
+            cache.record(path, status, contentHash);
+            assert(cache.unchanged(path, status, hash) && hash == contentHash);
+        }
+
+        ResultCache cache(root.string());
+        [[maybe_unused]] SHA1::HexDigest hash{};
+        assert(cache.unchanged(path, status, hash) && hash == contentHash);
+
+        struct stat changed = status;
+        changed.st_size += 1;
+        assert(!cache.unchanged(path, changed, hash));
+        changed = status;
+        changed.st_mtim.tv_nsec += 1;
+        assert(!cache.unchanged(path, changed, hash));
+        changed = status;
+        changed.st_ino += 1;
+        assert(!cache.unchanged(path, changed, hash));
+    }
+
+    // prune removes the entries and units not used since the cache was opened
+    {
+        const std::string kept = (root / "main.cpp").string();
+        const std::string removed = (root / "removed.cpp").string();
+        std::ofstream(removed) << "a = c;\n";
+        struct stat keptStatus;
+        struct stat removedStatus;
+        ::stat(kept.c_str(), &keptStatus);
+        ::stat(removed.c_str(), &removedStatus);
+
+        AnalysisRequest other = request;
+        other.diskFilename = "removed.cpp";
+        const ResultCache::Key keptKey = ResultCache::key(request, contentHash);
+        const ResultCache::Key removedKey = ResultCache::key(other, sha1Hex("a = c;\n"));
+        {
+            ResultCache cache(root.string());
+            cache.record(removed, removedStatus, sha1Hex("a = c;\n"));
+            cache.store(removedKey, "<code:unit/>\n");
+            std::ofstream(root / "units" / "temporary.0.0") << "partial";
+        }
+
+        {
+            ResultCache cache(root.string());
+            SHA1::HexDigest hash{};
+            SourceFile unit;
+            [[maybe_unused]] const bool found = cache.unchanged(kept, keptStatus, hash) && cache.load(keptKey, unit);
+            assert(found);
+            [[maybe_unused]] const std::size_t units = cache.prune();
+            assert(units == 1);
+        }
+
+        ResultCache cache(root.string());
+        [[maybe_unused]] SHA1::HexDigest hash{};
+        SourceFile unit;
+        assert(cache.unchanged(kept, keptStatus, hash));
+        assert(!cache.unchanged(removed, removedStatus, hash));
+        assert(cache.load(keptKey, unit));
+        assert(!cache.load(removedKey, unit));
+        assert(std::filesystem::exists(root / "units" / "temporary.0.0"));
+    }
+
+    // damaged manifest lines are ignored
+    {
+        std::ofstream(root / "manifest") << "garbage\n1 2 3 4 short path\n";
+        ResultCache cache(root.string());
+        [[maybe_unused]] struct stat status{};
+        [[maybe_unused]] SHA1::HexDigest hash{};
+        assert(!cache.unchanged("path", status, hash));
+    }
+
+    std::filesystem::remove_all(root);
+
+    return 0;
+}
@@ -0,0 +1,316 @@
+/*
+  @file SHA1.cpp
+
+  Implementation of the incremental SHA-1 hash
+*/
+
+#include "SHA1.hpp"
+#include "CPUFeatures.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#if defined(CODEANALYSIS_X86_64)
+#include <immintrin.h>
+#endif
+
+#if defined(CODEANALYSIS_ARM64_CRYPTO)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+    // hash state after processing whole 64-byte blocks
+    using Compress = void (*)(std::uint32_t state[5], const unsigned char* data, std::size_t blocks);
+
+    constexpr std::uint32_t INITIAL_STATE[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+    constexpr std::uint32_t ROUND_CONSTANTS[4] = { 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+
+    inline std::uint32_t rotateLeft(std::uint32_t value, int count) {
+
+        return (value << count) | (value >> (32 - count));
+    }
+
+    void compressPortable(std::uint32_t state[5], const unsigned char* data, std::size_t blocks) {
+
+        for (; blocks > 0; --blocks, data += 64) {
+
+            // message schedule, big endian words
+            std::uint32_t w[80];
+            for (int i = 0; i < 16; ++i)
+                w[i] = (std::uint32_t(data[4 * i]) << 24) | (std::uint32_t(data[4 * i + 1]) << 16)
+                     | (std::uint32_t(data[4 * i + 2]) << 8) | std::uint32_t(data[4 * i + 3]);
+            for (int i = 16; i < 80; ++i)
+                w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+            std::uint32_t a = state[0];
+            std::uint32_t b = state[1];
+            std::uint32_t c = state[2];
+            std::uint32_t d = state[3];
+            std::uint32_t e = state[4];
+            auto round = [&](std::uint32_t f, std::uint32_t k, std::uint32_t word) {
+                const std::uint32_t temp = rotateLeft(a, 5) + f + e + k + word;
+                e = d;
+                d = c;
+                c = rotateLeft(b, 30);
+                b = a;
+                a = temp;
+            };
+            for (int i = 0; i < 20; ++i)
+                round((b & c) | (~b & d), ROUND_CONSTANTS[0], w[i]);
+            for (int i = 20; i < 40; ++i)
+                round(b ^ c ^ d, ROUND_CONSTANTS[1], w[i]);
+            for (int i = 40; i < 60; ++i)
+                round((b & c) | (b & d) | (c & d), ROUND_CONSTANTS[2], w[i]);
+            for (int i = 60; i < 80; ++i)
+                round(b ^ c ^ d, ROUND_CONSTANTS[3], w[i]);
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+    }
+
+#if defined(CODEANALYSIS_X86_64)
+
+#if defined(__GNUC__)
+#define SHA1_TARGET __attribute__((target("sha,ssse3,sse4.1")))
+#else
+#define SHA1_TARGET
+#endif
+
+    // four rounds of SHA-NI, with the message schedule for later groups
+    // interleaved. msg holds the message words for groups Group to Group + 3.
+    template<int Group>
+    SHA1_TARGET inline void roundsSHANI(__m128i& abcd, __m128i (&e)[2], __m128i (&msg)[4]) {
+
+        constexpr int current = Group % 4;
+
+        // e for these rounds from the state before the previous rounds
+        if constexpr (Group == 0)
+            e[0] = _mm_add_epi32(e[0], msg[0]);
+        else
+            e[Group % 2] = _mm_sha1nexte_epu32(e[Group % 2], msg[current]);
+        e[(Group + 1) % 2] = abcd;
+
+        if constexpr (Group >= 3 && Group <= 18)
+            msg[(Group + 1) % 4] = _mm_sha1msg2_epu32(msg[(Group + 1) % 4], msg[current]);
+
+        abcd = _mm_sha1rnds4_epu32(abcd, e[Group % 2], Group / 5);
+
+        if constexpr (Group >= 1 && Group <= 16)
+            msg[(Group + 3) % 4] = _mm_sha1msg1_epu32(msg[(Group + 3) % 4], msg[current]);
+
+        if constexpr (Group >= 2 && Group <= 17)
+            msg[(Group + 2) % 4] = _mm_xor_si128(msg[(Group + 2) % 4], msg[current]);
+    }
+
+    template<int... Groups>
+    SHA1_TARGET inline void allRoundsSHANI(__m128i& abcd, __m128i (&e)[2], __m128i (&msg)[4],
+                                           std::integer_sequence<int, Groups...>) {
+
+        (roundsSHANI<Groups>(abcd, e, msg), ...);
+    }
+
+    SHA1_TARGET void compressSHANI(std::uint32_t state[5], const unsigned char* data, std::size_t blocks) {
+
+        // message words are big endian, and the instructions expect the first word in the high lane
+        const __m128i reverse = _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+
+        __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+        __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+        for (; blocks > 0; --blocks, data += 64) {
+
+            const __m128i savedABCD = abcd;
+            const __m128i savedE = e0;
+
+            __m128i msg[4];
+            for (int i = 0; i < 4; ++i)
+                msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)), reverse);
+
+            __m128i e[2] = { e0, _mm_setzero_si128() };
+            allRoundsSHANI(abcd, e, msg, std::make_integer_sequence<int, 20>());
+
+            e0 = _mm_sha1nexte_epu32(e[0], savedE);
+            abcd = _mm_add_epi32(abcd, savedABCD);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+        state[4] = static_cast<std::uint32_t>(_mm_extract_epi32(e0, 3));
+    }
+
+#undef SHA1_TARGET
+
+#endif
+
+#if defined(CODEANALYSIS_ARM64_CRYPTO)
+
+    void compressARMv8(std::uint32_t state[5], const unsigned char* data, std::size_t blocks) {
+
+        uint32x4_t abcd = vld1q_u32(state);
+        std::uint32_t e0 = state[4];
+
+        for (; blocks > 0; --blocks, data += 64) {
+
+            const uint32x4_t savedABCD = abcd;
+            const std::uint32_t savedE = e0;
+
+            // message words are big endian
+            uint32x4_t msg[4];
+            for (int i = 0; i < 4; ++i)
+                msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+
+            std::uint32_t e = e0;
+            for (int group = 0; group < 20; ++group) {
+
+                // schedule from the previous four groups of words
+                if (group >= 4)
+                    msg[group % 4] = vsha1su1q_u32(vsha1su0q_u32(msg[group % 4], msg[(group + 1) % 4], msg[(group + 2) % 4]),
+                                                   msg[(group + 3) % 4]);
+
+                const uint32x4_t words = vaddq_u32(msg[group % 4], vdupq_n_u32(ROUND_CONSTANTS[group / 5]));
+                const std::uint32_t nextE = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+                if (group < 5)
+                    abcd = vsha1cq_u32(abcd, e, words);
+                else if (group < 10 || group >= 15)
+                    abcd = vsha1pq_u32(abcd, e, words);
+                else
+                    abcd = vsha1mq_u32(abcd, e, words);
+                e = nextE;
+            }
+
+            abcd = vaddq_u32(abcd, savedABCD);
+            e0 = e + savedE;
+        }
+
+        vst1q_u32(state, abcd);
+        state[4] = e0;
+    }
+
+#endif
+
+    Compress selectCompress() {
+
+#if defined(CODEANALYSIS_X86_64)
+        if (cpuHasSHA1())
+            return compressSHANI;
+#elif defined(CODEANALYSIS_ARM64_CRYPTO)
+        if (cpuHasSHA1())
+            return compressARMv8;
+#endif
+        return compressPortable;
+    }
+
+    // kernel for the processor, selected once
+    Compress processorCompress() {
+
+        static const Compress compressKernel = selectCompress();
+
+        return compressKernel;
+    }
+}
+
+SHA1::SHA1()
+    : SHA1(processorCompress()) {}
+
+SHA1::SHA1(Compress compressBlocks)
+    : compressBlocks(compressBlocks) {
+
+    std::memcpy(state, INITIAL_STATE, sizeof(state));
+}
+
+/**
+ * Add data to the hash
+ *
+ * @param data Next bytes of the message
+ */
+void SHA1::update(std::string_view data) {
+
+    messageSize += data.size();
+
+    auto bytes = reinterpret_cast<const unsigned char*>(data.data());
+    std::size_t size = data.size();
+
+    // complete a partial block
+    if (blockSize > 0) {
+        const std::size_t count = std::min(size, sizeof(block) - blockSize);
+        std::memcpy(block + blockSize, bytes, count);
+        blockSize += count;
+        bytes += count;
+        size -= count;
+        if (blockSize < sizeof(block))
+            return;
+        compressBlocks(state, block, 1);
+        blockSize = 0;
+    }
+
+    // whole blocks directly from the data
+    compressBlocks(state, bytes, size / 64);
+    bytes += size - size % 64;
+    size %= 64;
+
+    std::memcpy(block, bytes, size);
+    blockSize = size;
+}
+
+/**
+ * Complete the hash, and reset for a new message
+ *
+ * @retval Hash of the data as 40 lowercase hex characters
+ */
+SHA1::HexDigest SHA1::finish() {
+
+    // padding of 0x80, zeros, and the message size in bits as big endian
+    const std::uint64_t bits = messageSize * 8;
+    unsigned char padding[72] = { 0x80 };
+    const std::size_t zeros = (blockSize < 56 ? 56 : 120) - blockSize;
+    for (int i = 0; i < 8; ++i)
+        padding[zeros + i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+    update(std::string_view(reinterpret_cast<const char*>(padding), zeros + 8));
+
+    HexDigest hex;
+    constexpr char digits[] = "0123456789abcdef";
+    for (int i = 0; i < 20; ++i) {
+        const unsigned int byte = (state[i / 4] >> (24 - 8 * (i % 4))) & 0xFF;
+        hex[2 * i] = digits[byte >> 4];
+        hex[2 * i + 1] = digits[byte & 0xF];
+    }
+
+    // ready for a new message
+    *this = SHA1(compressBlocks);
+
+    return hex;
+}
+
+/**
+ * SHA-1 hash of data
+ *
+ * @param data Complete message
+ * @retval Hash of the data as 40 lowercase hex characters
+ */
+SHA1::HexDigest sha1Hex(std::string_view data) {
+
+    SHA1 hash;
+    hash.update(data);
+
+    return hash.finish();
+}
+
+/**
+ * SHA-1 hash of data with the portable implementation, even when the
+ * processor has SHA-1 instructions, for testing
+ *
+ * @param data Complete message
+ * @retval Hash of the data as 40 lowercase hex characters
+ */
+SHA1::HexDigest sha1HexPortable(std::string_view data) {
+
+    SHA1 hash(compressPortable);
+    hash.update(data);
+
+    return hash.finish();
+}
@@ -0,0 +1,79 @@
+/*
+  @file SHA1.hpp
+
+  Incremental SHA-1 hash of source code
+*/
+
+#ifndef INCLUDED_SHA1_HPP
+#define INCLUDED_SHA1_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Incremental SHA-1 hash
+ *
+ * Uses the SHA-1 instructions of the processor when available,
+ * and a portable implementation otherwise.
+ */
+class SHA1 {
+public:
+
+    /** Number of hex characters in a hash */
+    static constexpr std::size_t HEX_SIZE = 40;
+
+    /** Hash as lowercase hex characters */
+    using HexDigest = std::array<char, HEX_SIZE>;
+
+    SHA1();
+
+    /**
+     * Add data to the hash
+     *
+     * @param data Next bytes of the message
+     */
+    void update(std::string_view data);
+
+    /**
+     * Complete the hash, and reset for a new message
+     *
+     * @retval Hash of the data as 40 lowercase hex characters
+     */
+    HexDigest finish();
+
+private:
+
+    // hash state after processing whole 64-byte blocks
+    using Compress = void (*)(std::uint32_t state[5], const unsigned char* data, std::size_t blocks);
+
+    explicit SHA1(Compress compressBlocks);
+
+    friend HexDigest sha1HexPortable(std::string_view data);
+
+    Compress compressBlocks;
+    std::uint32_t state[5];
+    unsigned char block[64];
+    std::size_t blockSize = 0;
+    std::uint64_t messageSize = 0;
+};
+
+/**
+ * SHA-1 hash of data
+ *
+ * @param data Complete message
+ * @retval Hash of the data as 40 lowercase hex characters
+ */
+SHA1::HexDigest sha1Hex(std::string_view data);
+
+/**
+ * SHA-1 hash of data with the portable implementation, even when the
+ * processor has SHA-1 instructions, for testing
+ *
+ * @param data Complete message
+ * @retval Hash of the data as 40 lowercase hex characters
+ */
+SHA1::HexDigest sha1HexPortable(std::string_view data);
+
+#endif
@@ -0,0 +1,70 @@
+/*
+  @file SHA1Test.cpp
+
+  Test program for SHA1
+*/
+
+#include "SHA1.hpp"
+#include <string>
+#include <string_view>
+#include <cassert>
+
+namespace {
+
+    [[maybe_unused]] std::string_view hex(const SHA1::HexDigest& digest) {
+        return std::string_view(digest.data(), digest.size());
+    }
+
+    // message and its hash
+    struct TestVector {
+        std::string message;
+        std::string_view hash;
+    };
+}
+
+int main() {
+
+    const TestVector vectors[] = {
+
+        // standard test vectors
+        { "", "da39a3ee5e6b4b0d3255bfef95601890afd80709" },
+        { "abc", "a9993e364706816aba3e25717850c26c9cd0d89d" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "84983e441c3bd26ebaae4aa1f95129e5e54670f1" },
+        { std::string(1000000, 'a'), "34aa973cd4c4daa4f61eeb2bdbad27316534016f" },
+
+        // README example
+        { "\nif (a < b)\n    a = b;\n", "39dcad4f59855aa76420aa3d69af3d7ba30a91bb" },
+
+        // padding that spills into a second block
+        { std::string(55, 'a'), "c1c8bbdc22796e28c0e15163d20899b65621d65a" },
+        { std::string(56, 'a'), "c2db330f6083854c99d4b5bfb6e8f29f201be699" },
+        { std::string(64, 'a'), "0098ba824b5c16427bd7a1122a5a442a25ec644d" },
+    };
+
+    // implementation selected for the processor, and the portable implementation on any processor
+    for ([[maybe_unused]] const auto& test : vectors) {
+        assert(hex(sha1Hex(test.message)) == test.hash);
+        assert(hex(sha1HexPortable(test.message)) == test.hash);
+    }
+
+    // incremental updates of every split match a single update
+    std::string message;
+    for (int i = 0; i < 200; ++i)
+        message += static_cast<char>('a' + i % 26);
+    [[maybe_unused]] const auto expected = sha1Hex(message);
+    for (std::size_t split = 0; split <= message.size(); ++split) {
+        SHA1 hash;
+        hash.update(std::string_view(message).substr(0, split));
+        hash.update(std::string_view(message).substr(split));
+        assert(hash.finish() == expected);
+    }
+
+    // finish() resets for a new message
+    SHA1 hash;
+    hash.update("abc");
+    hash.finish();
+    hash.update("abc");
+    assert(hex(hash.finish()) == "a9993e364706816aba3e25717850c26c9cd0d89d");
+
+    return 0;
+}
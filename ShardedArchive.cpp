@@ -0,0 +1,186 @@
+/*
+  @file ShardedArchive.cpp
+
+  Implementation of the archive of units split across standalone XML files
+*/
+
+#include "ShardedArchive.hpp"
+#include "XMLWrapper.hpp"
+#include <cstdio>
+#include <system_error>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+    // create or truncate a file for writing
+    int createFile(const std::string& path) {
+
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), path);
+
+        return fd;
+    }
+
+    // close a file, reporting errors of writes the kernel deferred
+    void closeFile(int fd, const std::string& path) {
+
+        if (::close(fd) < 0)
+            throw std::system_error(errno, std::generic_category(), path);
+    }
+
+    // append a field of the index, with separators escaped
+    void appendField(std::string& line, std::string_view field) {
+
+        for (const char c : field) {
+            switch (c) {
+            case '\t':
+                line += "\\t";
+                break;
+            case '\n':
+                line += "\\n";
+                break;
+            case '\\':
+                line += "\\\\";
+                break;
+            default:
+                line += c;
+            }
+        }
+    }
+}
+
+/**
+ * Create the index and the first shard
+ *
+ * @param prefix Path of the shards without the suffix
+ * @param maxBytes Size limit of a shard, 0 for none
+ * @param maxUnits Unit-count limit of a shard, 0 for none
+ * @throw std::system_error if the files cannot be created
+ */
+ShardedArchive::ShardedArchive(const std::string& prefix, std::uint64_t maxBytes, std::size_t maxUnits)
+    : prefix(prefix), maxBytes(maxBytes), maxUnits(maxUnits) {
+
+    // start and end of the archive unit, the same for every shard
+    std::string xml;
+    {
+        StringSink sink(xml);
+        XMLWrapper archive(CODE_UNIT_DOCUMENT, sink);
+        archive.addContent("\n");
+        header = xml;
+        archive.endElement();
+    }
+    footer = xml.substr(header.size());
+
+    indexFd = createFile(prefix + ".index");
+    index = std::make_unique<FileDescriptorSink>(indexFd);
+
+    openShard();
+}
+
+/** Closes the files, without completing the current shard */
+ShardedArchive::~ShardedArchive() {
+
+    shard.reset();
+    if (shardFd >= 0)
+        ::close(shardFd);
+    index.reset();
+    if (indexFd >= 0)
+        ::close(indexFd);
+}
+
+/**
+ * Write a unit, starting a new shard when needed
+ *
+ * @param unit Unit nested in an archive unit, as from formatAnalysisUnitXMLInto()
+ * @param filename Filename of the unit, for the index
+ * @param hash Hash of the unit, for the index
+ * @throw std::system_error on a failed write
+ */
+void ShardedArchive::add(std::string_view unit, std::string_view filename, std::string_view hash) {
+
+    const bool full = (maxUnits > 0 && shardUnits >= maxUnits)
+                   || (maxBytes > 0 && shardUnits > 0 && shardBytes + unit.size() + footer.size() > maxBytes);
+    if (full) {
+        closeShard();
+        openShard();
+    }
+
+    line.clear();
+    line += shardName;
+    line += '\t';
+    line += std::to_string(shardBytes);
+    line += '\t';
+    line += std::to_string(unit.size());
+    line += '\t';
+    appendField(line, filename);
+    line += '\t';
+    appendField(line, hash);
+    line += '\n';
+    index->write(line);
+
+    shard->write(unit);
+    shardBytes += unit.size();
+    ++shardUnits;
+}
+
+/**
+ * Complete the current shard, and flush the index
+ *
+ * @retval Number of shards
+ * @throw std::system_error on a failed write
+ */
+std::size_t ShardedArchive::finish() {
+
+    closeShard();
+
+    index->flush();
+    index.reset();
+    const int fd = indexFd;
+    indexFd = -1;
+    closeFile(fd, prefix + ".index");
+
+    return shardCount;
+}
+
+/**
+ * Path of a shard
+ *
+ * @param prefix Path of the shards without the suffix
+ * @param shard Number of the shard, from 0
+ * @retval Path of the shard
+ */
+std::string ShardedArchive::shardPath(const std::string& prefix, std::size_t shard) {
+
+    char number[32];
+    std::snprintf(number, sizeof(number), "-%05zu.xml", shard);
+
+    return prefix + number;
+}
+
+// start the next shard
+void ShardedArchive::openShard() {
+
+    const std::string path = shardPath(prefix, shardCount);
+    shardFd = createFile(path);
+    shard = std::make_unique<FileDescriptorSink>(shardFd);
+    shardName = path.substr(path.find_last_of('/') + 1);
+    ++shardCount;
+
+    shard->write(header);
+    shardBytes = header.size();
+    shardUnits = 0;
+}
+
+// complete the current shard
+void ShardedArchive::closeShard() {
+
+    shard->write(footer);
+    shard->flush();
+    shard.reset();
+    const int fd = shardFd;
+    shardFd = -1;
+    closeFile(fd, shardPath(prefix, shardCount - 1));
+}
@@ -0,0 +1,106 @@
+/*
+  @file ShardedArchive.hpp
+
+  Archive of units split across standalone XML files, with an index of the units
+*/
+
+#ifndef INCLUDED_SHARDEDARCHIVE_HPP
+#define INCLUDED_SHARDEDARCHIVE_HPP
+
+#include "OutputSink.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * Writer of units to a sequence of shards, each a complete archive unit
+ *
+ * Shards are named <prefix>-00000.xml, <prefix>-00001.xml, and so on. A new shard
+ * starts once the current one would pass the size or unit-count limit. A shard
+ * always holds at least one unit, so a unit larger than the size limit forms
+ * its own shard.
+ *
+ * The index <prefix>.index has a line for each unit, with tab-separated fields:
+ *   shard     Name of the shard file, relative to the index
+ *   offset    Byte offset of the unit in the shard
+ *   length    Number of bytes of the unit, including its trailing newline
+ *   filename  Filename of the unit, with tab, newline, and backslash as \t, \n, and \\
+ *   hash      Hash of the unit, empty for none
+ */
+class ShardedArchive {
+public:
+
+    /**
+     * Create the index and the first shard
+     *
+     * @param prefix Path of the shards without the suffix
+     * @param maxBytes Size limit of a shard, 0 for none
+     * @param maxUnits Unit-count limit of a shard, 0 for none
+     * @throw std::system_error if the files cannot be created
+     */
+    explicit ShardedArchive(const std::string& prefix, std::uint64_t maxBytes = 0, std::size_t maxUnits = 0);
+
+    /** Closes the files, without completing the current shard */
+    ~ShardedArchive();
+
+    ShardedArchive(const ShardedArchive&) = delete;
+    ShardedArchive& operator=(const ShardedArchive&) = delete;
+
+    /**
+     * Write a unit, starting a new shard when needed
+     *
+     * @param unit Unit nested in an archive unit, as from formatAnalysisUnitXMLInto()
+     * @param filename Filename of the unit, for the index
+     * @param hash Hash of the unit, for the index
+     * @throw std::system_error on a failed write
+     */
+    void add(std::string_view unit, std::string_view filename, std::string_view hash);
+
+    /**
+     * Complete the current shard, and flush the index
+     *
+     * @retval Number of shards
+     * @throw std::system_error on a failed write
+     */
+    std::size_t finish();
+
+    /**
+     * Path of a shard
+     *
+     * @param prefix Path of the shards without the suffix
+     * @param shard Number of the shard, from 0
+     * @retval Path of the shard
+     */
+    static std::string shardPath(const std::string& prefix, std::size_t shard);
+
+private:
+
+    // start the next shard
+    void openShard();
+
+    // complete the current shard
+    void closeShard();
+
+    std::string prefix;
+    std::uint64_t maxBytes;
+    std::size_t maxUnits;
+
+    // start and end of each shard
+    std::string header;
+    std::string footer;
+
+    int shardFd = -1;
+    std::unique_ptr<FileDescriptorSink> shard;
+    std::string shardName;
+    std::size_t shardCount = 0;
+    std::uint64_t shardBytes = 0;
+    std::size_t shardUnits = 0;
+
+    int indexFd = -1;
+    std::unique_ptr<FileDescriptorSink> index;
+    std::string line;
+};
+
+#endif
@@ -0,0 +1,90 @@
+/*
+  @file ShardedArchiveTest.cpp
+
+  Test program for ShardedArchive
+*/
+
+#include "ShardedArchive.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cassert>
+
+namespace {
+
+    std::string readFile(const std::filesystem::path& path) {
+
+        std::ifstream in(path, std::ios::binary);
+        std::ostringstream content;
+        content << in.rdbuf();
+
+        return content.str();
+    }
+
+    const std::string HEADER = R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<code:unit xmlns:code="http://mlcollard.net/code">
+)";
+    const std::string FOOTER = "</code:unit>\n";
+}
+
+int main() {
+
+    const std::filesystem::path root = "ShardedArchiveTest.shards";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    const std::string prefix = (root / "out").string();
+
+    // units roll over by count, and each shard is a complete archive
+    {
+        ShardedArchive shards(prefix, 0, 2);
+        shards.add("<code:unit>a</code:unit>\n", "a.cpp", "");
+        shards.add("<code:unit>b</code:unit>\n", "b\tc.cpp", "0123");
+        shards.add("<code:unit>c</code:unit>\n", "c.cpp", "");
+        [[maybe_unused]] const std::size_t count = shards.finish();
+        assert(count == 2);
+
+        assert(readFile(prefix + "-00000.xml") == HEADER + "<code:unit>a</code:unit>\n<code:unit>b</code:unit>\n" + FOOTER);
+        assert(readFile(prefix + "-00001.xml") == HEADER + "<code:unit>c</code:unit>\n" + FOOTER);
+
+        const std::string offset = std::to_string(HEADER.size());
+        const std::string second = std::to_string(HEADER.size() + 25);
+        assert(readFile(prefix + ".index") ==
+            "out-00000.xml\t" + offset + "\t25\ta.cpp\t\n"
+            "out-00000.xml\t" + second + "\t25\tb\\tc.cpp\t0123\n"
+            "out-00001.xml\t" + offset + "\t25\tc.cpp\t\n");
+
+        // offsets locate the units
+        const std::string shard = readFile(prefix + "-00000.xml");
+        assert(shard.substr(HEADER.size() + 25, 25) == "<code:unit>b</code:unit>\n");
+    }
+
+    // units roll over by size, with a unit larger than the limit in its own shard
+    {
+        const std::string large(200, 'x');
+        ShardedArchive shards(prefix, HEADER.size() + FOOTER.size() + 60, 0);
+        shards.add("<code:unit>a</code:unit>\n", "a.cpp", "");
+        shards.add("<code:unit>b</code:unit>\n", "b.cpp", "");
+        shards.add(large, "large.cpp", "");
+        shards.add("<code:unit>c</code:unit>\n", "c.cpp", "");
+        [[maybe_unused]] const std::size_t count = shards.finish();
+        assert(count == 3);
+
+        assert(readFile(prefix + "-00001.xml") == HEADER + large + FOOTER);
+        assert(readFile(prefix + "-00002.xml") == HEADER + "<code:unit>c</code:unit>\n" + FOOTER);
+    }
+
+    // no units is a single empty archive
+    {
+        ShardedArchive shards(prefix);
+        [[maybe_unused]] const std::size_t count = shards.finish();
+        assert(count == 1);
+        assert(readFile(prefix + "-00000.xml") == HEADER + FOOTER);
+        assert(readFile(prefix + ".index").empty());
+    }
+
+    std::filesystem::remove_all(root);
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+/*
+  @file SourceFile.cpp
+
+  Implementation of the contents of a source file
+*/
+
+#include "SourceFile.hpp"
+#include <system_error>
+#include <utility>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    // closes the file descriptor on all paths
+    struct FileDescriptor {
+        int fd;
+        ~FileDescriptor() { ::close(fd); }
+    };
+
+    // read up to size bytes, or until the end when the size is not known
+    void readFile(int fd, std::size_t size, std::string& buffer) {
+
+        buffer.resize(size > 0 ? size : 4096);
+        std::size_t total = 0;
+        while (size == 0 || total < size) {
+            if (total == buffer.size())
+                buffer.resize(buffer.size() * 2);
+
+            const ssize_t count = size > 0 ? ::pread(fd, &buffer[total], size - total, static_cast<off_t>(total))
+                                           : ::read(fd, &buffer[total], buffer.size() - total);
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::system_error(errno, std::generic_category(), "read");
+            }
+            if (count == 0)
+                break;
+            total += static_cast<std::size_t>(count);
+        }
+        buffer.resize(total);
+    }
+}
+
+/**
+ * @param path Path of the file to open
+ * @param access How the contents are loaded
+ * @throw std::system_error if the file cannot be read
+ */
+SourceFile::SourceFile(const std::string& path, Access access) {
+
+    open(path, access);
+}
+
+SourceFile::~SourceFile() {
+
+    close();
+}
+
+SourceFile::SourceFile(SourceFile&& other) noexcept
+    : data(std::exchange(other.data, std::string_view())), mapping(std::exchange(other.mapping, nullptr)),
+      mappingSize(std::exchange(other.mappingSize, 0)), buffer(std::move(other.buffer)) {
+
+    // a small-string buffer moves its characters
+    if (!mapping)
+        data = buffer;
+}
+
+SourceFile& SourceFile::operator=(SourceFile&& other) noexcept {
+
+    if (this != &other) {
+        close();
+        mapping = std::exchange(other.mapping, nullptr);
+        mappingSize = std::exchange(other.mappingSize, 0);
+        buffer = std::move(other.buffer);
+        data = mapping ? std::exchange(other.data, std::string_view()) : std::string_view(buffer);
+        other.data = std::string_view();
+    }
+
+    return *this;
+}
+
+/**
+ * Replace the contents with those of another file
+ *
+ * @param path Path of the file to open
+ * @param access How the contents are loaded
+ * @throw std::system_error if the file cannot be read
+ */
+void SourceFile::open(const std::string& path, Access access) {
+
+    close();
+
+    int fd;
+    do {
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), path);
+    const FileDescriptor file{fd};
+
+    struct stat status;
+    if (::fstat(fd, &status) < 0)
+        throw std::system_error(errno, std::generic_category(), path);
+
+    // pipes and devices have no size, and are read until the end
+    const std::size_t size = S_ISREG(status.st_mode) ? static_cast<std::size_t>(status.st_size) : 0;
+    if (access == MAP_LARGE && size >= MAP_THRESHOLD) {
+        void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            ::madvise(address, size, MADV_SEQUENTIAL);
+            mapping = address;
+            mappingSize = size;
+            data = std::string_view(static_cast<const char*>(address), size);
+            return;
+        }
+    }
+
+    readFile(fd, size, buffer);
+    data = buffer;
+}
+
+/**
+ * Release the contents
+ */
+void SourceFile::close() {
+
+    if (mapping)
+        ::munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+    data = std::string_view();
+    buffer.clear();
+}
@@ -0,0 +1,85 @@
+/*
+  @file SourceFile.hpp
+
+  Contents of a source file without copying large files
+*/
+
+#ifndef INCLUDED_SOURCEFILE_HPP
+#define INCLUDED_SOURCEFILE_HPP
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+/**
+ * Contents of a source file, for the sourceCode of an AnalysisRequestView
+ *
+ * Large files are memory mapped for sequential access, so the content is
+ * the page cache itself. Small files, where mapping costs more than
+ * copying, are read into a buffer that is reused by each open().
+ *
+ * The content is valid until the next open(), close(), or destruction.
+ */
+class SourceFile {
+public:
+
+    /** Smallest file that is memory mapped */
+    static constexpr std::size_t MAP_THRESHOLD = 64 * 1024;
+
+    /** How the contents are loaded */
+    enum Access {
+        MAP_LARGE,  // files of at least MAP_THRESHOLD are memory mapped
+        READ_ALL    // read into the buffer, for files that may be truncated while in use,
+                    // where access to a mapping past the new end raises SIGBUS
+    };
+
+    SourceFile() = default;
+
+    /**
+     * @param path Path of the file to open
+     * @param access How the contents are loaded
+     * @throw std::system_error if the file cannot be read
+     */
+    explicit SourceFile(const std::string& path, Access access = MAP_LARGE);
+
+    /** Unmaps the file */
+    ~SourceFile();
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    SourceFile(SourceFile&& other) noexcept;
+    SourceFile& operator=(SourceFile&& other) noexcept;
+
+    /**
+     * Replace the contents with those of another file
+     *
+     * @param path Path of the file to open
+     * @param access How the contents are loaded
+     * @throw std::system_error if the file cannot be read
+     */
+    void open(const std::string& path, Access access = MAP_LARGE);
+
+    /**
+     * Release the contents
+     */
+    void close();
+
+    /**
+     * Contents of the file
+     */
+    std::string_view content() const { return data; }
+
+    /**
+     * Whether the contents are memory mapped
+     */
+    bool mapped() const { return mapping != nullptr; }
+
+private:
+    std::string_view data;
+    void* mapping = nullptr;
+    std::size_t mappingSize = 0;
+    std::string buffer;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+  @file SourceFileTest.cpp
+
+  Test program for SourceFile
+*/
+
+#include "SourceFile.hpp"
+#include <string>
+#include <fstream>
+#include <system_error>
+#include <utility>
+#include <cstdio>
+#include <cassert>
+
+namespace {
+
+    // write a temporary file with the content
+    std::string writeFile(const std::string& name, const std::string& content) {
+
+        const std::string path = "SourceFileTest." + name;
+        std::ofstream(path, std::ios::binary) << content;
+
+        return path;
+    }
+}
+
+int main() {
+
+    // small files are read
+    {
+        const std::string path = writeFile("small.cpp", "a = b;\n");
+        SourceFile file(path);
+        assert(file.content() == "a = b;\n");
+        assert(!file.mapped());
+
+        // moved content refers to the new file
+        SourceFile moved(std::move(file));
+        assert(moved.content() == "a = b;\n");
+        assert(file.content().empty());
+        std::remove(path.c_str());
+    }
+
+    // empty files
+    {
+        const std::string path = writeFile("empty.cpp", "");
+        SourceFile file(path);
+        assert(file.content().empty());
+        std::remove(path.c_str());
+    }
+
+    // large files are mapped
+    {
+        std::string content;
+        while (content.size() < SourceFile::MAP_THRESHOLD)
+            content += "if (a < b)\n    a = b;\n";
+        const std::string path = writeFile("large.cpp", content);
+        SourceFile file(path);
+        assert(file.content() == content);
+        assert(file.mapped());
+
+        SourceFile moved;
+        moved = std::move(file);
+        assert(moved.content() == content);
+        assert(!file.mapped());
+
+        // reopened with a small file
+        const std::string small = writeFile("small.cpp", "c = d;\n");
+        moved.open(small);
+        assert(moved.content() == "c = d;\n");
+        assert(!moved.mapped());
+
+        // large files read whole when they may be truncated while in use
+        moved.open(path, SourceFile::READ_ALL);
+        assert(moved.content() == content);
+        assert(!moved.mapped());
+        std::remove(path.c_str());
+        std::remove(small.c_str());
+    }
+
+    // missing files
+    {
+        [[maybe_unused]] bool thrown = false;
+        try {
+            SourceFile file("SourceFileTest.missing.cpp");
+        } catch (const std::system_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+
+    return 0;
+}
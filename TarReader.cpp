@@ -0,0 +1,372 @@
+/*
+  @file TarReader.cpp
+
+  Implementation of the streaming reader of tar archives
+*/
+
+#include "TarReader.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+
+#if defined(CODEANALYSIS_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace {
+
+    // size of tar headers, and the unit content is padded to
+    constexpr std::size_t BLOCK_SIZE = 512;
+
+    // size of reads from the archive file
+    constexpr std::size_t INPUT_SIZE = 64 * 1024;
+
+    // largest pax extended header or GNU long name, far beyond any real path
+    constexpr std::uint64_t MAX_EXTENDED_SIZE = 1024 * 1024;
+
+    // size padded to whole blocks
+    std::uint64_t padded(std::uint64_t size) {
+
+        return (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    }
+
+    // value of a numeric header field, in octal, or base-256 for large values
+    std::uint64_t parseNumber(const char* field, std::size_t size) {
+
+        std::uint64_t value = 0;
+        if (static_cast<unsigned char>(field[0]) & 0x80) {
+            for (std::size_t i = 1; i < size; ++i)
+                value = (value << 8) | static_cast<unsigned char>(field[i]);
+            return value;
+        }
+
+        std::size_t i = 0;
+        while (i < size && field[i] == ' ')
+            ++i;
+        for (; i < size && field[i] >= '0' && field[i] <= '7'; ++i)
+            value = value * 8 + static_cast<std::uint64_t>(field[i] - '0');
+
+        return value;
+    }
+
+    // text of a header field, up to the first null
+    std::string_view parseText(const char* field, std::size_t size) {
+
+        return std::string_view(field, static_cast<std::size_t>(std::find(field, field + size, '\0') - field));
+    }
+
+    // checksum of the header is the sum of its bytes, with the checksum field as spaces
+    bool validChecksum(const char* header) {
+
+        const std::uint64_t expected = parseNumber(header + 148, 8);
+        std::uint64_t unsignedSum = 0;
+        std::int64_t signedSum = 0;
+        for (std::size_t i = 0; i < BLOCK_SIZE; ++i) {
+            const char byte = i >= 148 && i < 156 ? ' ' : header[i];
+            unsignedSum += static_cast<unsigned char>(byte);
+            signedSum += static_cast<signed char>(byte);
+        }
+
+        // some older archivers sum signed bytes
+        return expected == unsignedSum || static_cast<std::int64_t>(expected) == signedSum;
+    }
+
+    // apply the path and size records of a pax extended header
+    void parsePax(std::string_view records, std::string& path, std::uint64_t& size, bool& hasSize) {
+
+        while (!records.empty()) {
+
+            // "<length> <key>=<value>\n", with the length including itself
+            std::size_t length = 0;
+            std::size_t i = 0;
+            for (; i < records.size() && records[i] >= '0' && records[i] <= '9' && length <= records.size(); ++i)
+                length = length * 10 + static_cast<std::size_t>(records[i] - '0');
+            if (length > records.size() || i + 1 >= length || records[i] != ' ' || records[length - 1] != '\n')
+                throw std::runtime_error("Invalid pax header");
+
+            const std::string_view record = records.substr(i + 1, length - i - 2);
+            const auto equals = record.find('=');
+            if (equals != std::string_view::npos) {
+                const std::string_view key = record.substr(0, equals);
+                const std::string_view value = record.substr(equals + 1);
+                if (key == "path") {
+                    path = value;
+                } else if (key == "size") {
+                    if (value.empty() || value.size() > 19)
+                        throw std::runtime_error("Invalid pax header");
+                    size = 0;
+                    for (const char digit : value) {
+                        if (digit < '0' || digit > '9')
+                            throw std::runtime_error("Invalid pax header");
+                        size = size * 10 + static_cast<std::uint64_t>(digit - '0');
+                    }
+                    hasSize = true;
+                }
+            }
+            records.remove_prefix(length);
+        }
+    }
+}
+
+/**
+ * Bytes of the archive file, decompressed if it starts with the gzip magic number
+ */
+class TarReader::Input {
+public:
+
+    explicit Input(int fd) : fd(fd), raw(new char[INPUT_SIZE]) {
+
+        // enough of the start to recognize compression
+        while (rawEnd < 2) {
+            const std::size_t count = readFile(raw.get() + rawEnd, INPUT_SIZE - rawEnd);
+            if (count == 0)
+                break;
+            rawEnd += count;
+        }
+        gzip = rawEnd >= 2 && static_cast<unsigned char>(raw[0]) == 0x1F && static_cast<unsigned char>(raw[1]) == 0x8B;
+
+        if (gzip) {
+#if defined(CODEANALYSIS_HAVE_ZLIB)
+            stream = z_stream();
+            stream.next_in = reinterpret_cast<Bytef*>(raw.get());
+            stream.avail_in = static_cast<uInt>(rawEnd);
+            if (inflateInit2(&stream, 15 + 16) != Z_OK)
+                throw std::runtime_error("Unable to start gzip decompression");
+#else
+            throw std::runtime_error("Compressed archives require zlib");
+#endif
+        }
+    }
+
+    ~Input() {
+
+#if defined(CODEANALYSIS_HAVE_ZLIB)
+        if (gzip)
+            inflateEnd(&stream);
+#endif
+    }
+
+    Input(const Input&) = delete;
+    Input& operator=(const Input&) = delete;
+
+    /**
+     * Read some bytes of the archive
+     *
+     * @param data Destination of the bytes
+     * @param size Maximum number of bytes
+     * @retval Number of bytes read, 0 at the end of the archive
+     */
+    std::size_t read(char* data, std::size_t size) {
+
+        if (!gzip) {
+            // bytes read when recognizing compression, then directly from the file
+            if (rawStart < rawEnd) {
+                const std::size_t count = std::min(size, rawEnd - rawStart);
+                std::memcpy(data, raw.get() + rawStart, count);
+                rawStart += count;
+                return count;
+            }
+            return readFile(data, size);
+        }
+
+#if defined(CODEANALYSIS_HAVE_ZLIB)
+        stream.next_out = reinterpret_cast<Bytef*>(data);
+        stream.avail_out = static_cast<uInt>(std::min<std::size_t>(size, INPUT_SIZE));
+        const uInt available = stream.avail_out;
+        while (stream.avail_out == available) {
+            if (stream.avail_in == 0) {
+                const std::size_t count = readFile(raw.get(), INPUT_SIZE);
+                if (count == 0) {
+                    if (!streamEnd)
+                        throw std::runtime_error("Truncated gzip archive");
+                    break;
+                }
+                stream.next_in = reinterpret_cast<Bytef*>(raw.get());
+                stream.avail_in = static_cast<uInt>(count);
+            }
+
+            // concatenated gzip members form a single archive
+            if (streamEnd) {
+                inflateReset(&stream);
+                streamEnd = false;
+            }
+
+            const int status = inflate(&stream, Z_NO_FLUSH);
+            if (status == Z_STREAM_END)
+                streamEnd = true;
+            else if (status != Z_OK && status != Z_BUF_ERROR)
+                throw std::runtime_error("Invalid gzip data");
+        }
+
+        return available - stream.avail_out;
+#else
+        return 0;
+#endif
+    }
+
+private:
+
+    // read some bytes of the file, 0 at its end
+    std::size_t readFile(char* data, std::size_t size) {
+
+        while (true) {
+            const ssize_t count = ::read(fd, data, size);
+            if (count >= 0)
+                return static_cast<std::size_t>(count);
+            if (errno != EINTR)
+                throw std::system_error(errno, std::generic_category(), "read");
+        }
+    }
+
+    int fd;
+    std::unique_ptr<char[]> raw;
+    std::size_t rawStart = 0;
+    std::size_t rawEnd = 0;
+    bool gzip = false;
+#if defined(CODEANALYSIS_HAVE_ZLIB)
+    z_stream stream;
+    bool streamEnd = false;
+#endif
+};
+
+/**
+ * @param fd Open archive, not closed by the reader
+ */
+TarReader::TarReader(int fd) : input(new Input(fd)) {}
+
+TarReader::~TarReader() = default;
+
+/**
+ * Advance to the next regular file, skipping the content of the current one
+ *
+ * @retval true At the next regular file
+ * @retval false End of the archive
+ * @throw std::runtime_error for an invalid archive
+ * @throw std::system_error on a failed read
+ */
+bool TarReader::next() {
+
+    skip(remaining);
+    remaining = 0;
+    contentSize = 0;
+    buffer.clear();
+    contentRead = false;
+
+    // path and size from extended headers for the following entry
+    std::string longPath;
+    std::uint64_t paxSize = 0;
+    bool hasPaxSize = false;
+
+    char header[BLOCK_SIZE];
+    while (!finished) {
+
+        // end of the archive is a zero block, and some archivers omit it
+        if (input->read(header, 1) == 0)
+            break;
+        read(header + 1, BLOCK_SIZE - 1);
+        if (std::all_of(header, header + BLOCK_SIZE, [](char byte) { return byte == '\0'; }))
+            break;
+
+        if (!validChecksum(header))
+            throw std::runtime_error("Invalid tar header");
+
+        // a pax size applies to the entry, not to another extended header
+        const char type = header[156];
+        const std::uint64_t headerSize = parseNumber(header + 124, 12);
+        const std::uint64_t size = hasPaxSize && type != 'x' && type != 'L' ? paxSize : headerSize;
+
+        // regular files
+        if (type == '0' || type == '\0' || type == '7') {
+            if (!longPath.empty()) {
+                path = std::move(longPath);
+            } else {
+                path.clear();
+                const std::string_view prefix = std::memcmp(header + 257, "ustar", 6) == 0 ? parseText(header + 345, 155) : std::string_view();
+                if (!prefix.empty()) {
+                    path += prefix;
+                    path += '/';
+                }
+                path += parseText(header, 100);
+            }
+            contentSize = size;
+            remaining = padded(size);
+            return true;
+        }
+
+        // pax extended header for the next entry
+        if (type == 'x') {
+            if (size > MAX_EXTENDED_SIZE)
+                throw std::runtime_error("Invalid pax header");
+            std::string records(static_cast<std::size_t>(size), '\0');
+            read(records.data(), records.size());
+            skip(padded(size) - size);
+            parsePax(records, longPath, paxSize, hasPaxSize);
+            continue;
+        }
+
+        // GNU long name for the next entry
+        if (type == 'L') {
+            if (size > MAX_EXTENDED_SIZE)
+                throw std::runtime_error("Invalid long name");
+            std::string name(static_cast<std::size_t>(size), '\0');
+            read(name.data(), name.size());
+            skip(padded(size) - size);
+            longPath = parseText(name.data(), name.size());
+            continue;
+        }
+
+        // directories, links, and global headers
+        skip(padded(size));
+        longPath.clear();
+        hasPaxSize = false;
+    }
+
+    finished = true;
+    path.clear();
+
+    return false;
+}
+
+/**
+ * Content of the current entry, valid until the next call to next()
+ *
+ * @throw std::runtime_error for a truncated archive
+ * @throw std::system_error on a failed read
+ */
+std::string_view TarReader::content() {
+
+    if (!contentRead) {
+        buffer.resize(static_cast<std::size_t>(contentSize));
+        read(buffer.data(), buffer.size());
+        remaining -= contentSize;
+        contentRead = true;
+    }
+
+    return buffer;
+}
+
+// read exactly size bytes
+void TarReader::read(char* data, std::size_t size) {
+
+    while (size > 0) {
+        const std::size_t count = input->read(data, size);
+        if (count == 0)
+            throw std::runtime_error("Truncated tar archive");
+        data += count;
+        size -= count;
+    }
+}
+
+// discard size bytes
+void TarReader::skip(std::uint64_t size) {
+
+    char discard[16 * 1024];
+    while (size > 0) {
+        const std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(size, sizeof(discard)));
+        read(discard, count);
+        size -= count;
+    }
+}
@@ -0,0 +1,86 @@
+/*
+  @file TarReader.hpp
+
+  Streaming reader of the entries of tar archives
+*/
+
+#ifndef INCLUDED_TARREADER_HPP
+#define INCLUDED_TARREADER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * Sequential reader of the regular files in a ustar, pax, or GNU tar archive,
+ * optionally gzip compressed
+ *
+ * The archive is read as a stream, e.g., from a pipe, and is never extracted.
+ * Only the content of the current entry is held, in a buffer reused by each
+ * entry, so memory is bounded by the largest entry read. Compressed archives
+ * are decompressed directly into the buffer.
+ */
+class TarReader {
+public:
+
+    /**
+     * @param fd Open archive, not closed by the reader
+     */
+    explicit TarReader(int fd);
+
+    ~TarReader();
+
+    TarReader(const TarReader&) = delete;
+    TarReader& operator=(const TarReader&) = delete;
+
+    /**
+     * Advance to the next regular file, skipping the content of the current one
+     *
+     * @retval true At the next regular file
+     * @retval false End of the archive
+     * @throw std::runtime_error for an invalid archive
+     * @throw std::system_error on a failed read
+     */
+    bool next();
+
+    /**
+     * Path of the current entry in the archive
+     */
+    const std::string& name() const { return path; }
+
+    /**
+     * Size of the content of the current entry
+     */
+    std::uint64_t size() const { return contentSize; }
+
+    /**
+     * Content of the current entry, valid until the next call to next()
+     *
+     * @throw std::runtime_error for a truncated archive
+     * @throw std::system_error on a failed read
+     */
+    std::string_view content();
+
+private:
+
+    // source of the archive bytes, raw or decompressed
+    class Input;
+
+    // read exactly size bytes
+    void read(char* data, std::size_t size);
+
+    // discard size bytes
+    void skip(std::uint64_t size);
+
+    std::unique_ptr<Input> input;
+    std::string path;
+    std::uint64_t contentSize = 0;
+    std::uint64_t remaining = 0;
+    bool contentRead = false;
+    bool finished = false;
+    std::string buffer;
+};
+
+#endif
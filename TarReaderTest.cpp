@@ -0,0 +1,246 @@
+/*
+  @file TarReaderTest.cpp
+
+  Test program for TarReader
+*/
+
+#include "TarReader.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(CODEANALYSIS_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace {
+
+    // entry of a ustar archive, with the content padded to whole blocks
+    std::string tarEntry(const std::string& name, const std::string& content, char type = '0', const std::string& prefix = "") {
+
+        char header[512] = {};
+        std::memcpy(header, name.data(), std::min<std::size_t>(name.size(), 100));
+        std::snprintf(header + 100, 8, "%07o", 0644);
+        std::snprintf(header + 124, 12, "%011o", static_cast<unsigned int>(content.size()));
+        header[156] = type;
+        std::memcpy(header + 257, "ustar", 6);
+        std::memcpy(header + 263, "00", 2);
+        std::memcpy(header + 345, prefix.data(), prefix.size());
+
+        std::memset(header + 148, ' ', 8);
+        unsigned int sum = 0;
+        for (const char byte : header)
+            sum += static_cast<unsigned char>(byte);
+        std::snprintf(header + 148, 8, "%06o", sum);
+
+        std::string entry(header, sizeof(header));
+        entry += content;
+        entry.append((512 - content.size() % 512) % 512, '\0');
+
+        return entry;
+    }
+
+    // pax record, with the length including itself
+    std::string paxRecord(const std::string& key, const std::string& value) {
+
+        const std::string record = " " + key + "=" + value + "\n";
+        std::size_t length = record.size() + 1;
+        while (std::to_string(length).size() + record.size() != length)
+            ++length;
+
+        return std::to_string(length) + record;
+    }
+
+    // end of archive
+    const std::string END(1024, '\0');
+
+    // open a temporary file with the data
+    int openData(const std::string& data) {
+
+        const char* path = "TarReaderTest.tar";
+        std::ofstream(path, std::ios::binary) << data;
+        const int fd = ::open(path, O_RDONLY);
+        std::remove(path);
+
+        return fd;
+    }
+
+#if defined(CODEANALYSIS_HAVE_ZLIB)
+    // gzip member of the data
+    std::string gzip(const std::string& data) {
+
+        z_stream stream = z_stream();
+        deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+        std::string compressed(deflateBound(&stream, static_cast<uLong>(data.size())), '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+        stream.avail_out = static_cast<uInt>(compressed.size());
+        deflate(&stream, Z_FINISH);
+        compressed.resize(stream.total_out);
+        deflateEnd(&stream);
+
+        return compressed;
+    }
+#endif
+}
+
+int main() {
+
+    const std::string large(100000, 'x');
+    const std::string archive = tarEntry("src/", "", '5')
+                              + tarEntry("main.cpp", "a = b;\n")
+                              + tarEntry("large.cpp", large)
+                              + tarEntry("A.java", "c && d;\n", '0', "src/java")
+                              + tarEntry("././@LongLink", std::string(150, 'n') + ".cpp", 'L')
+                              + tarEntry("truncated", "long name\n")
+                              + tarEntry("PaxHeader", paxRecord("path", "pax/name.cpp"), 'x')
+                              + tarEntry("short", "pax\n")
+                              + END;
+
+    // regular files, in order, with directories skipped
+    {
+        const int fd = openData(archive);
+        TarReader reader(fd);
+        assert(reader.next());
+        assert(reader.name() == "main.cpp");
+        assert(reader.size() == 7);
+        assert(reader.content() == "a = b;\n");
+        assert(reader.content() == "a = b;\n");
+        assert(reader.next());
+        assert(reader.name() == "large.cpp");
+        assert(reader.content() == large);
+        assert(reader.next());
+        assert(reader.name() == "src/java/A.java");
+        assert(reader.content() == "c && d;\n");
+        assert(reader.next());
+        assert(reader.name() == std::string(150, 'n') + ".cpp");
+        assert(reader.content() == "long name\n");
+        assert(reader.next());
+        assert(reader.name() == "pax/name.cpp");
+        assert(reader.content() == "pax\n");
+        assert(!reader.next());
+        assert(!reader.next());
+        ::close(fd);
+    }
+
+    // content not read is skipped
+    {
+        const int fd = openData(archive);
+        TarReader reader(fd);
+        assert(reader.next() && reader.name() == "main.cpp");
+        assert(reader.next() && reader.name() == "large.cpp");
+        assert(reader.next() && reader.name() == "src/java/A.java");
+        assert(reader.content() == "c && d;\n");
+        ::close(fd);
+    }
+
+    // empty archives, with and without the end blocks
+    {
+        const int fd = openData(END);
+        TarReader reader(fd);
+        assert(!reader.next());
+        ::close(fd);
+
+        const int emptyFd = openData("");
+        TarReader emptyReader(emptyFd);
+        assert(!emptyReader.next());
+        ::close(emptyFd);
+    }
+
+    // invalid archives
+    {
+        std::string corrupt = tarEntry("main.cpp", "a = b;\n");
+        corrupt[0] = 'M';
+        const int fd = openData(corrupt);
+        TarReader reader(fd);
+        [[maybe_unused]] bool thrown = false;
+        try {
+            reader.next();
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        ::close(fd);
+
+        const int truncatedFd = openData(tarEntry("large.cpp", large).substr(0, 2000));
+        TarReader truncatedReader(truncatedFd);
+        assert(truncatedReader.next());
+        thrown = false;
+        try {
+            truncatedReader.content();
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        ::close(truncatedFd);
+    }
+
+    // malformed extended headers are invalid archives, not failed allocations
+    {
+        // whether reading every entry throws std::runtime_error
+        auto invalid = [](const std::string& data) {
+            const int fd = openData(data);
+            TarReader reader(fd);
+            bool thrown = false;
+            try {
+                while (reader.next())
+                    reader.content();
+            } catch (const std::runtime_error&) {
+                thrown = true;
+            }
+            ::close(fd);
+            return thrown;
+        };
+
+        // header sizes of 8 GiB, without the content
+        for (const char type : { 'x', 'L' }) {
+            std::string huge = tarEntry("Extended", "", type);
+            std::memcpy(huge.data() + 124, "77777777777", 11);
+            std::memset(huge.data() + 148, ' ', 8);
+            unsigned int sum = 0;
+            for (std::size_t i = 0; i < 512; ++i)
+                sum += static_cast<unsigned char>(huge[i]);
+            std::snprintf(huge.data() + 148, 8, "%06o", sum);
+            [[maybe_unused]] const bool rejected = invalid(huge + END);
+            assert(rejected);
+        }
+
+        for (const std::string& records : { paxRecord("size", "12a"),
+                                            paxRecord("size", ""),
+                                            paxRecord("size", "99999999999999999999"),
+                                            std::string("11 path=a.c"),
+                                            std::string("2 11 path=a.cpp\n"),
+                                            std::string("99999999999999999999999 path=a.cpp\n") }) {
+            [[maybe_unused]] const bool rejected = invalid(tarEntry("PaxHeader", records, 'x') + tarEntry("a.cpp", "a;\n") + END);
+            assert(rejected);
+        }
+
+        // a valid size is still applied
+        [[maybe_unused]] const bool rejected = invalid(tarEntry("PaxHeader", paxRecord("size", "3"), 'x') + tarEntry("a.cpp", "a;\n") + END);
+        assert(!rejected);
+    }
+
+#if defined(CODEANALYSIS_HAVE_ZLIB)
+    // gzip compressed, including concatenated members
+    {
+        const int fd = openData(gzip(archive.substr(0, 2048)) + gzip(archive.substr(2048)));
+        TarReader reader(fd);
+        assert(reader.next() && reader.content() == "a = b;\n");
+        assert(reader.next() && reader.content() == large);
+        assert(reader.next() && reader.content() == "c && d;\n");
+        assert(reader.next() && reader.content() == "long name\n");
+        assert(reader.next() && reader.content() == "pax\n");
+        assert(!reader.next());
+        ::close(fd);
+    }
+#endif
+
+    return 0;
+}
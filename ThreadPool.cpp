@@ -0,0 +1,172 @@
+/*
+  @file ThreadPool.cpp
+
+  Implementation of the work-stealing pool of threads
+*/
+
+#include "ThreadPool.hpp"
+
+namespace {
+
+    // pool and queue index of the current thread, if it is a pool thread
+    thread_local const ThreadPool* currentPool = nullptr;
+    thread_local std::size_t currentQueue = 0;
+}
+
+/**
+ * @param threads Number of threads, 0 for the hardware concurrency
+ */
+ThreadPool::ThreadPool(unsigned int threads) {
+
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    for (unsigned int i = 0; i < threads; ++i)
+        queues.push_back(std::make_unique<TaskQueue>());
+
+    for (unsigned int i = 0; i < threads; ++i)
+        this->threads.emplace_back(&ThreadPool::work, this, i);
+}
+
+/**
+ * Waits for all submitted tasks, then stops the threads
+ */
+ThreadPool::~ThreadPool() {
+
+    try {
+        wait();
+    } catch (...) {}
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    available.notify_all();
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+/**
+ * Queue a task to run on a pool thread
+ *
+ * @param task Work to perform
+ */
+void ThreadPool::submit(std::function<void()> task) {
+
+    // own queue for pool threads, round robin otherwise
+    const std::size_t index = currentPool == this ? currentQueue
+                            : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    pending.fetch_add(1);
+    queued.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+
+    // wake a sleeping thread
+    if (sleeping.load() > 0) {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+        }
+        available.notify_one();
+    }
+}
+
+/**
+ * Wait until all submitted tasks, including tasks they submit, complete
+ *
+ * @throw The first exception thrown by a task since the last wait()
+ */
+void ThreadPool::wait() {
+
+    std::unique_lock<std::mutex> lock(stateMutex);
+    idle.wait(lock, [this]{ return pending.load() == 0; });
+
+    if (failure) {
+        std::exception_ptr error = failure;
+        failure = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+ * Take a task from the back of the queue of this thread,
+ * or steal one from the front of another queue
+ *
+ * @param self Queue index of this thread
+ * @param task Task taken
+ * @retval true Task was taken
+ */
+bool ThreadPool::take(std::size_t self, std::function<void()>& task) {
+
+    {
+        auto& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    for (std::size_t i = 1; i < queues.size(); ++i) {
+        auto& victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Run tasks until stopped
+ *
+ * @param self Queue index of this thread
+ */
+void ThreadPool::work(std::size_t self) {
+
+    currentPool = this;
+    currentQueue = self;
+
+    while (true) {
+
+        std::function<void()> task;
+        if (!take(self, task)) {
+
+            // sleep until there is work to take
+            std::unique_lock<std::mutex> lock(stateMutex);
+            sleeping.fetch_add(1);
+            available.wait(lock, [this]{ return stopping || queued.load() > 0; });
+            sleeping.fetch_sub(1);
+            if (stopping && queued.load() == 0)
+                return;
+            continue;
+        }
+
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (!failure)
+                failure = std::current_exception();
+        }
+
+        // last task wakes any waiters
+        if (pending.fetch_sub(1) == 1) {
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+            }
+            idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,95 @@
+/*
+  @file ThreadPool.hpp
+
+  Work-stealing pool of threads
+*/
+
+#ifndef INCLUDED_THREADPOOL_HPP
+#define INCLUDED_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Pool of threads that each run tasks from their own queue,
+ * and steal from the other queues when their own is empty
+ *
+ * Tasks submitted from a pool thread go to that thread's queue,
+ * so a task that splits its work keeps it local until stolen.
+ */
+class ThreadPool {
+public:
+
+    /**
+     * @param threads Number of threads, 0 for the hardware concurrency
+     */
+    explicit ThreadPool(unsigned int threads = 0);
+
+    /** Waits for all submitted tasks, then stops the threads */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Queue a task to run on a pool thread
+     *
+     * @param task Work to perform
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * Wait until all submitted tasks, including tasks they submit, complete
+     *
+     * @throw The first exception thrown by a task since the last wait()
+     */
+    void wait();
+
+    /**
+     * Number of threads in the pool
+     */
+    unsigned int size() const { return static_cast<unsigned int>(threads.size()); }
+
+private:
+
+    // tasks of a single thread, taken from the back by the owner and the front by thieves
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // take a task from the queue of this thread, or steal one
+    bool take(std::size_t self, std::function<void()>& task);
+
+    // run tasks until stopped
+    void work(std::size_t self);
+
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> threads;
+
+    // tasks in queues, and tasks submitted but not complete
+    std::atomic<std::size_t> queued{0};
+    std::atomic<std::size_t> pending{0};
+
+    // queue for tasks submitted from outside the pool
+    std::atomic<std::size_t> nextQueue{0};
+
+    // threads waiting for tasks
+    std::atomic<std::size_t> sleeping{0};
+
+    std::mutex stateMutex;
+    std::condition_variable available;
+    std::condition_variable idle;
+    bool stopping = false;
+    std::exception_ptr failure;
+};
+
+#endif
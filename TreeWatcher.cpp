@@ -0,0 +1,293 @@
+/*
+  @file TreeWatcher.cpp
+
+  Implementation of the watch of a directory tree
+*/
+
+#include "TreeWatcher.hpp"
+#include "DirectoryEntry.hpp"
+#include "FilenameToLanguage.hpp"
+#include <algorithm>
+#include <memory>
+#include <string_view>
+#include <system_error>
+#include <cerrno>
+#include <cstdint>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    // events of a watched directory that change its files or subdirectories
+    constexpr std::uint32_t WATCH_MASK = IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE
+                                       | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+    // size of the buffer of events, a whole number of the largest events
+    constexpr std::size_t EVENT_BUFFER_SIZE = 64 * 1024;
+
+    // path of an entry of the directory
+    std::string joinPath(const std::string& directory, std::string_view name) {
+
+        std::string path;
+        path.reserve(directory.size() + 1 + name.size());
+        path += directory;
+        if (path.empty() || path.back() != '/')
+            path += '/';
+        path += name;
+
+        return path;
+    }
+
+    // whether a path is of the directory or under it
+    bool isUnder(const std::string& path, const std::string& directory) {
+
+        return path.compare(0, directory.size(), directory) == 0
+            && (path.size() == directory.size() || path[directory.size()] == '/');
+    }
+
+    // whether the file has a supported extension
+    bool isSourceFile(std::string_view name) {
+
+        return !filenameToLanguage(name).empty();
+    }
+}
+
+/**
+ * Watch the tree, listing its current files
+ *
+ * @param root Root of the tree
+ * @param quiet Time without events that completes a batch
+ * @param maxDelay Longest time from the first event of a batch to its report
+ * @throw std::system_error if the root cannot be watched
+ */
+TreeWatcher::TreeWatcher(const std::string& root, std::chrono::milliseconds quiet, std::chrono::milliseconds maxDelay)
+    : root(root), quiet(quiet), maxDelay(maxDelay) {
+
+    inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0)
+        throw std::system_error(errno, std::generic_category(), "inotify_init1");
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        const int error = errno;
+        ::close(inotifyFd);
+        throw std::system_error(error, std::generic_category(), "eventfd");
+    }
+
+    // the root is checked first, so its error is reported
+    if (::inotify_add_watch(inotifyFd, root.c_str(), WATCH_MASK) < 0) {
+        const int error = errno;
+        ::close(inotifyFd);
+        ::close(wakeFd);
+        throw std::system_error(error, std::generic_category(), root);
+    }
+    watchTree(root);
+
+    known.swap(marked);
+}
+
+/** Removes the watches */
+TreeWatcher::~TreeWatcher() {
+
+    ::close(inotifyFd);
+    ::close(wakeFd);
+}
+
+/**
+ * Current files of the tree, as updates, in path order
+ */
+std::vector<FileChange> TreeWatcher::files() const {
+
+    std::vector<FileChange> changes;
+    changes.reserve(known.size());
+    for (const auto& path : known)
+        changes.push_back({ path, false });
+
+    return changes;
+}
+
+/**
+ * Wait for the next batch of changes
+ *
+ * @retval Changes in path order, empty once stopped
+ * @throw std::system_error if reading the events fails
+ */
+std::vector<FileChange> TreeWatcher::wait() {
+
+    using Clock = std::chrono::steady_clock;
+
+    pollfd descriptors[] = { { inotifyFd, POLLIN, 0 }, { wakeFd, POLLIN, 0 } };
+    Clock::time_point first;
+    while (!stopping) {
+
+        // wait without a limit for the first change, then until quiet or the batch is due
+        int timeout = -1;
+        if (!marked.empty()) {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(first + maxDelay - Clock::now());
+            timeout = static_cast<int>(std::max(std::chrono::milliseconds(0), std::min(quiet, remaining)).count());
+        }
+
+        const int count = ::poll(descriptors, 2, timeout);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::generic_category(), "poll");
+        }
+        if (stopping)
+            break;
+
+        if (count > 0 && (descriptors[0].revents & POLLIN)) {
+            const bool started = !marked.empty();
+            readEvents();
+            if (!started)
+                first = Clock::now();
+            if (marked.empty() || Clock::now() < first + maxDelay)
+                continue;
+        }
+
+        // files created and removed within the batch leave no changes
+        std::vector<FileChange> changes = collect();
+        if (!changes.empty())
+            return changes;
+    }
+
+    return std::vector<FileChange>();
+}
+
+/**
+ * End wait(). May be called from any thread, or a signal handler.
+ */
+void TreeWatcher::stop() {
+
+    stopping = true;
+    const std::uint64_t value = 1;
+    [[maybe_unused]] const ssize_t written = ::write(wakeFd, &value, sizeof(value));
+}
+
+// watch a directory and its subdirectories, marking their files as changed
+void TreeWatcher::watchTree(const std::string& directory) {
+
+    const int wd = ::inotify_add_watch(inotifyFd, directory.c_str(), WATCH_MASK);
+    if (wd < 0)
+        return;
+    directories[wd] = directory;
+
+    // entries created before the watch are listed, and later ones are events
+    DIR* listing = ::opendir(directory.c_str());
+    if (!listing)
+        return;
+    const std::unique_ptr<DIR, int (*)(DIR*)> closer(listing, ::closedir);
+
+    std::vector<std::string> subdirectories;
+    while (const dirent* entry = ::readdir(listing)) {
+        const std::string_view name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+
+        const EntryType type = entryType(::dirfd(listing), entry->d_name, entry->d_type);
+        if (type == EntryType::DIRECTORY)
+            subdirectories.push_back(joinPath(directory, name));
+        else if (type == EntryType::FILE && isSourceFile(name))
+            marked.insert(joinPath(directory, name));
+    }
+
+    for (const auto& subdirectory : subdirectories)
+        watchTree(subdirectory);
+}
+
+// remove the watches of a directory and its subdirectories, marking their files as changed
+void TreeWatcher::unwatchTree(const std::string& directory) {
+
+    for (auto it = directories.begin(); it != directories.end(); ) {
+        if (isUnder(it->second, directory)) {
+            ::inotify_rm_watch(inotifyFd, it->first);
+            it = directories.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = known.lower_bound(directory + '/'); it != known.end() && isUnder(*it, directory); ++it)
+        marked.insert(*it);
+}
+
+// read the available events, marking the changed files
+void TreeWatcher::readEvents() {
+
+    alignas(inotify_event) char buffer[EVENT_BUFFER_SIZE];
+    bool overflow = false;
+    while (true) {
+        const ssize_t size = ::read(inotifyFd, buffer, sizeof(buffer));
+        if (size < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            throw std::system_error(errno, std::generic_category(), "inotify");
+        }
+
+        for (const char* position = buffer; position < buffer + size; ) {
+            const auto* event = reinterpret_cast<const inotify_event*>(position);
+            position += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                directories.erase(event->wd);
+                continue;
+            }
+            const auto directory = directories.find(event->wd);
+            if (directory == directories.end() || event->len == 0)
+                continue;
+
+            const std::string_view name(event->name);
+            const std::string path = joinPath(directory->second, name);
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    watchTree(path);
+                else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                    unwatchTree(path);
+            } else if (isSourceFile(name)) {
+                marked.insert(path);
+            }
+        }
+    }
+
+    if (overflow)
+        rescan();
+}
+
+// list the tree again, after lost events
+void TreeWatcher::rescan() {
+
+    for (const auto& directory : directories)
+        ::inotify_rm_watch(inotifyFd, directory.first);
+    directories.clear();
+
+    marked.insert(known.begin(), known.end());
+    watchTree(root);
+}
+
+// changes of the marked files, updating the reported files
+std::vector<FileChange> TreeWatcher::collect() {
+
+    std::vector<FileChange> changes;
+    for (const auto& path : marked) {
+        struct stat status;
+        if (::stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode)) {
+            known.insert(path);
+            changes.push_back({ path, false });
+        } else if (known.erase(path) > 0) {
+            changes.push_back({ path, true });
+        }
+    }
+    marked.clear();
+
+    return changes;
+}
@@ -0,0 +1,102 @@
+/*
+  @file TreeWatcher.hpp
+
+  Changes to the source files of a directory tree, from inotify
+*/
+
+#ifndef INCLUDED_TREEWATCHER_HPP
+#define INCLUDED_TREEWATCHER_HPP
+
+#include "FileChange.hpp"
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Watch of a directory tree, reporting changes to the files with a supported
+ * extension in batches
+ *
+ * Every directory of the tree has an inotify watch, including directories
+ * created or moved in later. Events are coalesced into a batch until the tree
+ * is quiet, or the first event of the batch is maxDelay old, so a burst,
+ * e.g., a checkout, forms one batch with a single change per file. Whether a
+ * change is an update or a removal is decided from the file when the batch is
+ * complete. A file created and removed within a batch is not reported.
+ *
+ * If the kernel queue overflows, the tree is listed again, and every file
+ * is reported, as an update, or as a removal when no longer present.
+ */
+class TreeWatcher {
+public:
+
+    /**
+     * Watch the tree, listing its current files
+     *
+     * @param root Root of the tree
+     * @param quiet Time without events that completes a batch
+     * @param maxDelay Longest time from the first event of a batch to its report
+     * @throw std::system_error if the root cannot be watched
+     */
+    explicit TreeWatcher(const std::string& root,
+                         std::chrono::milliseconds quiet = std::chrono::milliseconds(50),
+                         std::chrono::milliseconds maxDelay = std::chrono::milliseconds(250));
+
+    /** Removes the watches */
+    ~TreeWatcher();
+
+    TreeWatcher(const TreeWatcher&) = delete;
+    TreeWatcher& operator=(const TreeWatcher&) = delete;
+
+    /**
+     * Current files of the tree, as updates, in path order
+     */
+    std::vector<FileChange> files() const;
+
+    /**
+     * Wait for the next batch of changes
+     *
+     * @retval Changes in path order, empty once stopped
+     * @throw std::system_error if reading the events fails
+     */
+    std::vector<FileChange> wait();
+
+    /**
+     * End wait(). May be called from any thread, or a signal handler.
+     */
+    void stop();
+
+    /** Whether stop() was called */
+    bool stopped() const { return stopping.load(); }
+
+private:
+
+    // watch a directory and its subdirectories, marking their files as changed
+    void watchTree(const std::string& directory);
+
+    // remove the watches of a directory and its subdirectories, marking their files as changed
+    void unwatchTree(const std::string& directory);
+
+    // read the available events, marking the changed files
+    void readEvents();
+
+    // list the tree again, after lost events
+    void rescan();
+
+    // changes of the marked files, updating the reported files
+    std::vector<FileChange> collect();
+
+    std::string root;
+    std::chrono::milliseconds quiet;
+    std::chrono::milliseconds maxDelay;
+    int inotifyFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> stopping{false};
+    std::unordered_map<int, std::string> directories;   // path of each watched directory
+    std::set<std::string> known;                        // files reported, or listed initially
+    std::set<std::string> marked;                       // files changed in the current batch
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*
+  @file TreeWatcherTest.cpp
+
+  Test program for TreeWatcher
+*/
+
+#include "TreeWatcher.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <cassert>
+
+namespace {
+
+    // changes as "+path" for updates and "-path" for removals
+    [[maybe_unused]] std::vector<std::string> describe(const std::vector<FileChange>& changes) {
+
+        std::vector<std::string> descriptions;
+        for (const auto& change : changes)
+            descriptions.push_back((change.removed ? "-" : "+") + change.path);
+
+        return descriptions;
+    }
+
+    using Strings = std::vector<std::string>;
+}
+
+int main() {
+
+    const std::filesystem::path root = "TreeWatcherTest.tree";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "src" / "util");
+    std::ofstream(root / "main.cpp") << "a = b;\n";
+    std::ofstream(root / "notes.txt") << "notes\n";
+    std::ofstream(root / "src" / "util" / "util.hpp") << "int f();\n";
+
+    const std::string top = root.string();
+    TreeWatcher watcher(top);
+
+    // current files with a supported extension, in path order
+    assert(describe(watcher.files()) == (Strings{ "+" + top + "/main.cpp", "+" + top + "/src/util/util.hpp" }));
+
+    // writes to a file form a single update, and unsupported files are not reported
+    {
+        std::ofstream out(root / "main.cpp");
+        out << "a = c;\n";
+        out.flush();
+        out << "d = e;\n";
+    }
+    std::ofstream(root / "main.cpp", std::ios::app) << "f = g;\n";
+    std::ofstream(root / "notes.txt") << "more notes\n";
+    std::ofstream(root / "src" / "new.java") << "class A {}\n";
+    assert(describe(watcher.wait()) == (Strings{ "+" + top + "/main.cpp", "+" + top + "/src/new.java" }));
+
+    // removals, with a file created and removed within the batch not reported
+    std::filesystem::remove(root / "main.cpp");
+    std::ofstream(root / "temporary.cpp") << "x\n";
+    std::filesystem::remove(root / "temporary.cpp");
+    assert(describe(watcher.wait()) == (Strings{ "-" + top + "/main.cpp" }));
+
+    // files of a new directory, whether written before or after its watch
+    std::filesystem::create_directories(root / "lib" / "deep");
+    std::ofstream(root / "lib" / "deep" / "a.c") << "int a;\n";
+    std::ofstream(root / "lib" / "b.h") << "int b;\n";
+    assert(describe(watcher.wait()) == (Strings{ "+" + top + "/lib/b.h", "+" + top + "/lib/deep/a.c" }));
+
+    // a renamed directory removes its old paths, and updates its new ones
+    std::filesystem::rename(root / "lib", root / "library");
+    assert(describe(watcher.wait()) == (Strings{ "-" + top + "/lib/b.h", "-" + top + "/lib/deep/a.c",
+                                                 "+" + top + "/library/b.h", "+" + top + "/library/deep/a.c" }));
+
+    // new files in the renamed directory are watched
+    std::ofstream(root / "library" / "deep" / "c.cpp") << "int c;\n";
+    assert(describe(watcher.wait()) == (Strings{ "+" + top + "/library/deep/c.cpp" }));
+
+    // a removed directory removes its files
+    std::filesystem::remove_all(root / "src");
+    assert(describe(watcher.wait()) == (Strings{ "-" + top + "/src/new.java", "-" + top + "/src/util/util.hpp" }));
+
+    // a burst is a single batch, once quiet
+    for (int i = 0; i < 100; ++i)
+        std::ofstream(root / "library" / ("burst" + std::to_string(i % 10) + ".cpp")) << i << '\n';
+    assert(watcher.wait().size() == 10);
+
+    // a stop ends a wait without changes
+    std::thread stopper([&watcher]{
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        watcher.stop();
+    });
+    assert(watcher.wait().empty());
+    assert(watcher.stopped());
+    stopper.join();
+
+    // a missing root cannot be watched
+    [[maybe_unused]] bool thrown = false;
+    try {
+        TreeWatcher missing("TreeWatcherTest.missing");
+    } catch (const std::system_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::filesystem::remove_all(root);
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+  @file UTF8.cpp
+
+  Implementation of validation of UTF-8 content
+*/
+
+#include "UTF8.hpp"
+#include "CPUFeatures.hpp"
+
+#if defined(CODEANALYSIS_X86_64)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+    // offset of the first non-ASCII byte, or size
+    using FindNonASCII = std::size_t (*)(const char* data, std::size_t size);
+
+    std::size_t findNonASCIIScalar(const char* data, std::size_t size) {
+
+        for (std::size_t pos = 0; pos < size; ++pos)
+            if (static_cast<unsigned char>(data[pos]) >= 0x80)
+                return pos;
+
+        return size;
+    }
+
+#if defined(CODEANALYSIS_X86_64)
+
+    // the high bit of each byte is the movemask bit
+    std::size_t findNonASCIISSE2(const char* data, std::size_t size) {
+
+        std::size_t pos = 0;
+        for (; pos + 16 <= size; pos += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(block));
+            if (mask)
+                return pos + lowestBit(mask);
+        }
+
+        return pos + findNonASCIIScalar(data + pos, size - pos);
+    }
+
+#if defined(__GNUC__)
+    __attribute__((target("avx2")))
+#endif
+    std::size_t findNonASCIIAVX2(const char* data, std::size_t size) {
+
+        std::size_t pos = 0;
+        for (; pos + 32 <= size; pos += 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            const unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(block));
+            if (mask)
+                return pos + lowestBit(mask);
+        }
+
+        return pos + findNonASCIISSE2(data + pos, size - pos);
+    }
+
+#endif
+
+    FindNonASCII selectFindNonASCII() {
+
+#if defined(CODEANALYSIS_X86_64)
+        if (cpuHasAVX2())
+            return findNonASCIIAVX2;
+
+        return findNonASCIISSE2;
+#else
+        return findNonASCIIScalar;
+#endif
+    }
+
+    // number of bytes in the character from its lead byte, 0 if not a lead byte
+    inline std::size_t characterSize(unsigned char lead) {
+
+        if (lead < 0x80)
+            return 1;
+        if (lead < 0xC2)
+            return 0;
+        if (lead < 0xE0)
+            return 2;
+        if (lead < 0xF0)
+            return 3;
+        if (lead < 0xF5)
+            return 4;
+        return 0;
+    }
+
+    // size of the valid multi-byte character at the start of the data, 0 if invalid
+    std::size_t validCharacter(const unsigned char* data, std::size_t size) {
+
+        const std::size_t count = characterSize(data[0]);
+        if (count == 0 || count > size)
+            return 0;
+
+        // second byte range excludes overlongs, surrogates, and past U+10FFFF
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+        if (data[0] == 0xE0)
+            low = 0xA0;
+        else if (data[0] == 0xED)
+            high = 0x9F;
+        else if (data[0] == 0xF0)
+            low = 0x90;
+        else if (data[0] == 0xF4)
+            high = 0x8F;
+        if (data[1] < low || data[1] > high)
+            return 0;
+
+        for (std::size_t i = 2; i < count; ++i)
+            if ((data[i] & 0xC0) != 0x80)
+                return 0;
+
+        return count;
+    }
+}
+
+/**
+ * Position of the first byte that is not part of a valid UTF-8 character
+ *
+ * @param data UTF-8 content
+ * @retval Offset of the first invalid byte
+ * @retval data.size() if the data is valid
+ */
+std::size_t findInvalidUTF8(std::string_view data) {
+
+    static const FindNonASCII findNonASCIIKernel = selectFindNonASCII();
+
+    const auto bytes = reinterpret_cast<const unsigned char*>(data.data());
+    std::size_t pos = 0;
+    while (true) {
+
+        // skip ASCII
+        pos += findNonASCIIKernel(data.data() + pos, data.size() - pos);
+        if (pos == data.size())
+            return pos;
+
+        const std::size_t count = validCharacter(bytes + pos, data.size() - pos);
+        if (count == 0)
+            return pos;
+        pos += count;
+    }
+}
+
+/**
+ * Number of bytes at the end of the data that start a multi-byte
+ * character that the data cuts off
+ *
+ * @param data UTF-8 content
+ * @retval Number of bytes of the incomplete character, 0 to 3
+ */
+std::size_t incompleteUTF8Suffix(std::string_view data) {
+
+    // lead byte within the last three bytes
+    for (std::size_t back = 1; back <= 3 && back <= data.size(); ++back) {
+        const auto byte = static_cast<unsigned char>(data[data.size() - back]);
+        if ((byte & 0xC0) == 0x80)
+            continue;
+
+        return characterSize(byte) > back ? back : 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,35 @@
+/*
+  @file UTF8.hpp
+
+  Validation of UTF-8 content
+*/
+
+#ifndef INCLUDED_UTF8_HPP
+#define INCLUDED_UTF8_HPP
+
+#include <string_view>
+#include <cstddef>
+
+/**
+ * Position of the first byte that is not part of a valid UTF-8 character
+ *
+ * Overlong encodings, surrogates, code points past U+10FFFF, and
+ * characters cut off at the end of the data are invalid. Runs of
+ * ASCII are skipped with the widest vector instructions the processor supports.
+ *
+ * @param data UTF-8 content
+ * @retval Offset of the first invalid byte
+ * @retval data.size() if the data is valid
+ */
+std::size_t findInvalidUTF8(std::string_view data);
+
+/**
+ * Number of bytes at the end of the data that start a multi-byte
+ * character that the data cuts off
+ *
+ * @param data UTF-8 content
+ * @retval Number of bytes of the incomplete character, 0 to 3
+ */
+std::size_t incompleteUTF8Suffix(std::string_view data);
+
+#endif
@@ -0,0 +1,60 @@
+/*
+  @file UTF8Test.cpp
+
+  Test program for findInvalidUTF8() and incompleteUTF8Suffix()
+*/
+
+#include "UTF8.hpp"
+#include <string>
+#include <cassert>
+
+int main() {
+
+    // valid
+    assert(findInvalidUTF8("") == 0);
+    assert(findInvalidUTF8("a = b;") == 6);
+    assert(findInvalidUTF8("x = \"\xC3\xA9\";") == 9);
+    assert(findInvalidUTF8("\xE2\x82\xAC") == 3);
+    assert(findInvalidUTF8("\xF0\x9F\x98\x80") == 4);
+    assert(findInvalidUTF8("\xED\x9F\xBF") == 3);
+    assert(findInvalidUTF8("\xF4\x8F\xBF\xBF") == 4);
+
+    // invalid lead and continuation bytes
+    assert(findInvalidUTF8("a\xFF") == 1);
+    assert(findInvalidUTF8("a\x80") == 1);
+    assert(findInvalidUTF8("\xC3(") == 0);
+
+    // overlong encodings, surrogates, and past U+10FFFF
+    assert(findInvalidUTF8("\xC0\xAF") == 0);
+    assert(findInvalidUTF8("\xE0\x80\xAF") == 0);
+    assert(findInvalidUTF8("\xF0\x80\x80\xAF") == 0);
+    assert(findInvalidUTF8("\xED\xA0\x80") == 0);
+    assert(findInvalidUTF8("\xF4\x90\x80\x80") == 0);
+
+    // cut off at the end
+    assert(findInvalidUTF8("ab\xE2\x82") == 2);
+
+    // every position across vector blocks and tails
+    for (std::size_t size = 1; size <= 100; ++size) {
+        for (std::size_t pos = 0; pos < size; ++pos) {
+            std::string data(size, 'x');
+            data[pos] = '\xFF';
+            assert(findInvalidUTF8(data) == pos);
+        }
+        std::string valid(size, 'x');
+        for (std::size_t pos = 0; pos + 1 < size; pos += 7)
+            valid.replace(pos, 2, "\xC3\xA9");
+        assert(findInvalidUTF8(valid) == size);
+    }
+
+    // incomplete suffix
+    assert(incompleteUTF8Suffix("") == 0);
+    assert(incompleteUTF8Suffix("abc") == 0);
+    assert(incompleteUTF8Suffix("a\xC3") == 1);
+    assert(incompleteUTF8Suffix("a\xC3\xA9") == 0);
+    assert(incompleteUTF8Suffix("a\xE2\x82") == 2);
+    assert(incompleteUTF8Suffix("a\xF0\x9F\x98") == 3);
+    assert(incompleteUTF8Suffix("a\xF0\x9F\x98\x80") == 0);
+
+    return 0;
+}
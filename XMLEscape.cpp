@@ -0,0 +1,209 @@
+/*
+  @file XMLEscape.cpp
+
+  Implementation of escaping of XML content
+*/
+
+#include "XMLEscape.hpp"
+#include "CPUFeatures.hpp"
+#include <array>
+
+#if defined(CODEANALYSIS_X86_64)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+    // offset of the first character that needs escaping, or size
+    using FindEscape = std::size_t (*)(const char* data, std::size_t size);
+
+    // size of the data after escaping
+    using EscapedSize = std::size_t (*)(const char* data, std::size_t size);
+
+    // characters of attribute values that need escaping
+    constexpr auto ATTRIBUTE_ESCAPE = [] {
+        std::array<bool, 256> table{};
+        for (unsigned char c : { '<', '>', '&', '"', '\t', '\n', '\r' })
+            table[c] = true;
+        return table;
+    }();
+
+    std::size_t findEscapeScalar(const char* data, std::size_t size) {
+
+        for (std::size_t pos = 0; pos < size; ++pos) {
+            const char c = data[pos];
+            if (c == '<' || c == '>' || c == '&')
+                return pos;
+        }
+
+        return size;
+    }
+
+    std::size_t escapedSizeScalar(const char* data, std::size_t size) {
+
+        std::size_t escaped = size;
+        for (std::size_t pos = 0; pos < size; ++pos) {
+            const char c = data[pos];
+            if (c == '<' || c == '>')
+                escaped += 3;
+            else if (c == '&')
+                escaped += 4;
+        }
+
+        return escaped;
+    }
+
+#if defined(CODEANALYSIS_X86_64)
+
+    // '<' and '>' differ only in bit 1, so one compare after setting it finds both
+    std::size_t findEscapeSSE2(const char* data, std::size_t size) {
+
+        const __m128i bit1 = _mm_set1_epi8(0x02);
+        const __m128i angle = _mm_set1_epi8('>');
+        const __m128i amp = _mm_set1_epi8('&');
+
+        std::size_t pos = 0;
+        for (; pos + 16 <= size; pos += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            const __m128i special = _mm_or_si128(_mm_cmpeq_epi8(_mm_or_si128(block, bit1), angle),
+                                                 _mm_cmpeq_epi8(block, amp));
+            const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(special));
+            if (mask)
+                return pos + lowestBit(mask);
+        }
+
+        return pos + findEscapeScalar(data + pos, size - pos);
+    }
+
+#if defined(__GNUC__)
+    __attribute__((target("avx2")))
+#endif
+    std::size_t findEscapeAVX2(const char* data, std::size_t size) {
+
+        const __m256i bit1 = _mm256_set1_epi8(0x02);
+        const __m256i angle = _mm256_set1_epi8('>');
+        const __m256i amp = _mm256_set1_epi8('&');
+
+        std::size_t pos = 0;
+        for (; pos + 32 <= size; pos += 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            const __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_or_si256(block, bit1), angle),
+                                                    _mm256_cmpeq_epi8(block, amp));
+            const unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(special));
+            if (mask)
+                return pos + lowestBit(mask);
+        }
+
+        return pos + findEscapeSSE2(data + pos, size - pos);
+    }
+
+    std::size_t escapedSizeSSE2(const char* data, std::size_t size) {
+
+        const __m128i bit1 = _mm_set1_epi8(0x02);
+        const __m128i angle = _mm_set1_epi8('>');
+        const __m128i amp = _mm_set1_epi8('&');
+
+        std::size_t escaped = size;
+        std::size_t pos = 0;
+        for (; pos + 16 <= size; pos += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            const unsigned int angles = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(block, bit1), angle)));
+            const unsigned int amps = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, amp)));
+            escaped += 3 * countBits(angles) + 4 * countBits(amps);
+        }
+
+        return escaped - (size - pos) + escapedSizeScalar(data + pos, size - pos);
+    }
+
+#if defined(__GNUC__)
+    __attribute__((target("avx2,popcnt")))
+#endif
+    std::size_t escapedSizeAVX2(const char* data, std::size_t size) {
+
+        const __m256i bit1 = _mm256_set1_epi8(0x02);
+        const __m256i angle = _mm256_set1_epi8('>');
+        const __m256i amp = _mm256_set1_epi8('&');
+
+        std::size_t escaped = size;
+        std::size_t pos = 0;
+        for (; pos + 32 <= size; pos += 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            const unsigned int angles = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_or_si256(block, bit1), angle)));
+            const unsigned int amps = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, amp)));
+            escaped += 3 * countBits(angles) + 4 * countBits(amps);
+        }
+
+        return escaped - (size - pos) + escapedSizeSSE2(data + pos, size - pos);
+    }
+
+#endif
+
+    FindEscape selectFindEscape() {
+
+#if defined(CODEANALYSIS_X86_64)
+        if (cpuHasAVX2())
+            return findEscapeAVX2;
+
+        // SSE2 is part of the x86-64 baseline
+        return findEscapeSSE2;
+#else
+        return findEscapeScalar;
+#endif
+    }
+
+    EscapedSize selectEscapedSize() {
+
+#if defined(CODEANALYSIS_X86_64)
+        if (cpuHasAVX2())
+            return escapedSizeAVX2;
+
+        return escapedSizeSSE2;
+#else
+        return escapedSizeScalar;
+#endif
+    }
+}
+
+/**
+ * Position of the first character in the content that needs escaping
+ *
+ * @param content Non-element content
+ * @retval Offset of the first '<', '>', or '&'
+ * @retval content.size() if no character needs escaping
+ */
+std::size_t findEscape(std::string_view content) {
+
+    static const FindEscape findEscapeKernel = selectFindEscape();
+
+    return findEscapeKernel(content.data(), content.size());
+}
+
+/**
+ * Size of the content after escaping
+ *
+ * @param content Non-element content
+ * @retval Number of characters in the escaped content
+ */
+std::size_t escapedSize(std::string_view content) {
+
+    static const EscapedSize escapedSizeKernel = selectEscapedSize();
+
+    return escapedSizeKernel(content.data(), content.size());
+}
+
+/**
+ * Position of the first character in an attribute value that needs escaping
+ *
+ * @param value Value of an attribute in double quotes
+ * @retval Offset of the first '<', '>', '&', '"', tab, newline, or carriage return
+ * @retval value.size() if no character needs escaping
+ */
+std::size_t findAttributeEscape(std::string_view value) {
+
+    for (std::size_t pos = 0; pos < value.size(); ++pos) {
+        if (ATTRIBUTE_ESCAPE[static_cast<unsigned char>(value[pos])])
+            return pos;
+    }
+
+    return value.size();
+}
@@ -0,0 +1,81 @@
+/*
+  @file XMLEscape.hpp
+
+  Escaping of XML content
+*/
+
+#ifndef INCLUDED_XMLESCAPE_HPP
+#define INCLUDED_XMLESCAPE_HPP
+
+#include <string_view>
+#include <cstddef>
+
+/**
+ * Position of the first character in the content that needs escaping
+ *
+ * Uses the widest vector instructions the processor supports.
+ *
+ * @param content Non-element content
+ * @retval Offset of the first '<', '>', or '&'
+ * @retval content.size() if no character needs escaping
+ */
+std::size_t findEscape(std::string_view content);
+
+/**
+ * Size of the content after escaping
+ *
+ * Uses the widest vector instructions the processor supports.
+ *
+ * @param content Non-element content
+ * @retval Number of characters in the escaped content
+ */
+std::size_t escapedSize(std::string_view content);
+
+/**
+ * Entity for a character that needs escaping
+ *
+ * @param c One of '<', '>', or '&'
+ * @retval Entity reference for the character
+ */
+constexpr std::string_view escapeEntity(char c) {
+
+    return c == '<' ? "&lt;" : c == '>' ? "&gt;" : "&amp;";
+}
+
+/**
+ * Position of the first character in an attribute value that needs escaping
+ *
+ * Values are short, e.g., filenames and URLs, so a table lookup per
+ * character is used instead of vector instructions.
+ *
+ * @param value Value of an attribute in double quotes
+ * @retval Offset of the first '<', '>', '&', '"', tab, newline, or carriage return
+ * @retval value.size() if no character needs escaping
+ */
+std::size_t findAttributeEscape(std::string_view value);
+
+/**
+ * Entity or character reference for a character of an attribute value that needs escaping
+ *
+ * Whitespace other than a space is referenced so that it is not normalized.
+ *
+ * @param c One of '<', '>', '&', '"', tab, newline, or carriage return
+ * @retval Reference for the character
+ */
+constexpr std::string_view attributeEntity(char c) {
+
+    switch (c) {
+    case '"':
+        return "&quot;";
+    case '\t':
+        return "&#9;";
+    case '\n':
+        return "&#10;";
+    case '\r':
+        return "&#13;";
+    default:
+        return escapeEntity(c);
+    }
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+  @file XMLEscapeTest.cpp
+
+  Test program for findEscape()
+*/
+
+#include "XMLEscape.hpp"
+#include <string>
+#include <cassert>
+
+int main() {
+
+    // no characters to escape
+    assert(findEscape("") == 0);
+    assert(findEscape("a = b;") == 6);
+    assert(findEscape("\"quoted\" 'text'") == 15);
+
+    // each character to escape
+    assert(findEscape("a < b") == 2);
+    assert(findEscape("a > b") == 2);
+    assert(findEscape("a && b") == 2);
+
+    // characters near '<' and '>' that do not need escaping
+    assert(findEscape("=?;:") == 4);
+
+    // escaped size
+    assert(escapedSize("") == 0);
+    assert(escapedSize("a = b;") == 6);
+    assert(escapedSize("a < b") == 8);
+    assert(escapedSize("a > b") == 8);
+    assert(escapedSize("a && b") == 14);
+
+    // entities
+    assert(escapeEntity('<') == "&lt;");
+    assert(escapeEntity('>') == "&gt;");
+    assert(escapeEntity('&') == "&amp;");
+
+    // every position and length across vector blocks and tails
+    for (std::size_t size = 1; size <= 100; ++size) {
+        for (std::size_t pos = 0; pos < size; ++pos) {
+            for (char c : { '<', '>', '&' }) {
+                std::string content(size, 'x');
+                content[pos] = c;
+                assert(findEscape(content) == pos);
+                assert(findEscape(std::string_view(content).substr(pos + 1)) == size - pos - 1);
+                assert(escapedSize(content) == size + escapeEntity(c).size() - 1);
+            }
+        }
+    }
+
+    // dense content across vector blocks
+    for (std::size_t size = 0; size <= 100; ++size) {
+        std::string content;
+        std::size_t expected = 0;
+        for (std::size_t pos = 0; pos < size; ++pos) {
+            content += "<a>&"[pos % 4];
+            expected += pos % 4 == 1 ? 1 : escapeEntity(content.back()).size();
+        }
+        assert(escapedSize(content) == expected);
+    }
+
+    // high-bit bytes are not mistaken for characters to escape
+    assert(findEscape(std::string(64, '\xBE')) == 64);
+    assert(findEscape(std::string(64, '\xA6')) == 64);
+    assert(escapedSize(std::string(64, '\xBE')) == 64);
+
+    // attribute values
+    assert(findAttributeEscape("") == 0);
+    assert(findAttributeEscape("src/main.cpp") == 12);
+    assert(findAttributeEscape("a\"b") == 1);
+    assert(findAttributeEscape("a b\tc") == 3);
+    assert(findAttributeEscape("ab\nc") == 2);
+    assert(findAttributeEscape("abc\r") == 3);
+    assert(findAttributeEscape("a&b") == 1);
+    assert(findAttributeEscape("\xA6\xBE<") == 2);
+    assert(attributeEntity('"') == "&quot;");
+    assert(attributeEntity('\t') == "&#9;");
+    assert(attributeEntity('\n') == "&#10;");
+    assert(attributeEntity('\r') == "&#13;");
+    assert(attributeEntity('<') == "&lt;");
+    assert(attributeEntity('&') == "&amp;");
+
+    return 0;
+}
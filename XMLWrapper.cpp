@@ -5,10 +5,18 @@
     * Single-include file
     * Processes in UTF-8, and only in UTF-8
     * Requires namespace prefix and uri (non-blank)
+    * Output collected in xml(), or written to an OutputSink
+    * Namespace and element names are copied, so may be temporaries
+    * Attribute values and content are escaped, so output is always well-formed
+    * Elements with fixed tags, e.g., CODE_UNIT_DOCUMENT, start with a
+      single write of a precomputed literal
 */
 
 #include "XMLWrapper.hpp"
+#include "XMLEscape.hpp"
+#include "Metrics.hpp"
 #include <stdexcept>
+#include <utility>
 
 /*
     constructor
@@ -25,10 +33,48 @@ XMLWrapper::XMLWrapper(std::string_view prefix, std::string_view uri)
     if (prefix.empty())
         throw std::invalid_argument("Requires non-default prefix for namespace");
 
-    text = R"^^^(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>)^^^";
-    text += '\n';
+    write(XML_DECLARATION);
 }
 
+/*
+    constructor for output written to a sink
+
+    @param prefix Non-empty namespace prefix
+    @param uri Non-empty namespace URI
+    @param sink Destination of the XML. Must outlive the wrapper.
+    @param scope Whether the element is a document or a nested fragment
+*/
+XMLWrapper::XMLWrapper(std::string_view prefix, std::string_view uri, OutputSink& sink, Scope scope)
+    : nsPrefix(prefix), nsUri(uri), sink(&sink), scope(scope) {
+
+    if (uri.empty())
+        throw std::invalid_argument("Requires URI for namespace");
+
+    if (prefix.empty())
+        throw std::invalid_argument("Requires non-default prefix for namespace");
+
+    // nested elements are part of an existing document
+    if (scope == FRAGMENT)
+        return;
+
+    write(XML_DECLARATION);
+}
+
+/*
+    constructor for an element with precomputed tags, written to a sink
+
+    @param tags Start and end of the element. Must outlive the wrapper.
+    @param sink Destination of the XML. Must outlive the wrapper.
+*/
+XMLWrapper::XMLWrapper(const Tags& tags, OutputSink& sink)
+    : endTag(tags.end), sink(&sink), state(STARTTAG) {
+
+    write(tags.start);
+}
+
+// precomputed document starts with the same declaration
+static_assert(CODE_UNIT_DOCUMENT.start.substr(0, XML_DECLARATION.size()) == XML_DECLARATION);
+
 /*
     Start the element
 
@@ -52,18 +98,20 @@ void XMLWrapper::startElement(std::string_view name) {
     localName = name;
 
     // start of start tag
-    text += '<';
-    text += nsPrefix;
-    text += ':';
-    text += localName;
-
-    // namespace
-    text += ' ';
-    text += "xmlns:";
-    text += nsPrefix;
-    text += "=\"";
-    text += nsUri;
-    text += '"';
+    write("<");
+    write(nsPrefix);
+    write(":");
+    write(localName);
+
+    // namespace, declared once at the document element
+    if (scope == DOCUMENT) {
+        write(" ");
+        write("xmlns:");
+        write(nsPrefix);
+        write("=\"");
+        write(nsUri);
+        write("\"");
+    }
 
     state = STARTTAG;
 }
@@ -91,11 +139,22 @@ void XMLWrapper::addAttribute(std::string_view name, std::string_view value) {
     }
 
     // attribute of the form name="value"
-    text += ' ';
-    text += name;
-    text += "=\"";
-    text += value;
-    text += '"';
+    write(" ");
+    write(name);
+    write("=\"");
+
+    // escaped value, with unescaped runs written whole
+    while (true) {
+        const auto pos = findAttributeEscape(value);
+        write(value.substr(0, pos));
+        if (pos == value.size())
+            break;
+
+        write(attributeEntity(value[pos]));
+        value.remove_prefix(pos + 1);
+    }
+
+    write("\"");
 }
 
 /*
@@ -120,14 +179,21 @@ void XMLWrapper::endElement() {
 
     // end previous start tag if not closed
     if (state == STARTTAG)
-        text += ">";
+        write(">");
+
+    // precomputed end tag
+    if (!endTag.empty()) {
+        write(endTag);
+        state = COMPLETED;
+        return;
+    }
 
     // end element tag
-    text += "</";
-    text += nsPrefix;
-    text += ":";
-    text += localName;
-    text += ">\n";
+    write("</");
+    write(nsPrefix);
+    write(":");
+    write(localName);
+    write(">\n");
 
     state = COMPLETED;
 }
@@ -153,29 +219,22 @@ void XMLWrapper::addContent(std::string_view content) {
 
     // end previous start tag if not closed
     if (state == STARTTAG)
-        text += ">";
+        write(">");
+
+#if defined(CODEANALYSIS_METRICS)
+    if (!sink || !sink->measuring()) {
+        const std::size_t escaped = escapedSize(content);
+        addMetric(MetricCounter::CONTENT_BYTES_IN, content.size());
+        addMetric(MetricCounter::CONTENT_BYTES_OUT, escaped);
+        addMetric(MetricCounter::OUTPUT_BYTES, escaped);
+    }
+#endif
 
     // insert content, escaping if needed
-    if (content.find("<") == std::string::npos &&
-        content.find(">") == std::string::npos) {
-
-        text += content;
-
-    } else {
-
-        // escape text
-        for (char c : content) {
-            if (c == '<') {
-                text += "&lt;";
-            } else if (c == '>') {
-                text += "&gt;";
-            } else if (c == '&') {
-                text += "&amp;";
-            } else {
-                text += c;
-            }
-        }
-    }
+    if (sink)
+        sink->writeEscaped(content);
+    else
+        StringSink(text).writeEscaped(content);
 
     state = CONTENT;
 }
@@ -185,9 +244,35 @@ void XMLWrapper::addContent(std::string_view content) {
 
     May be called at any point, even before completion.
 */
-std::string XMLWrapper::xml() const {
+std::string XMLWrapper::xml() const& {
 
     // xml() is allowed for any state
 
     return text;
 }
+
+/*
+    Accessor for XML of an expiring wrapper, moved instead of copied
+*/
+std::string XMLWrapper::xml() && {
+
+    return std::move(text);
+}
+
+/*
+    Append to the output
+
+    @param data Bytes to append
+*/
+void XMLWrapper::write(std::string_view data) {
+
+#if defined(CODEANALYSIS_METRICS)
+    if (!sink || !sink->measuring())
+        addMetric(MetricCounter::OUTPUT_BYTES, data.size());
+#endif
+
+    if (sink)
+        sink->write(data);
+    else
+        text += data;
+}
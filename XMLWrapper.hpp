@@ -5,14 +5,32 @@
     * Single-include file
     * Processes in UTF-8, and only in UTF-8
     * Requires namespace prefix and uri (non-blank)
+    * Output collected in xml(), or written to an OutputSink, e.g., a
+      PmrStringSink to collect it in a memory resource
+    * Namespace and element names are copied, so may be temporaries
+    * Attribute values and content are escaped, so output is always well-formed
+    * Elements with fixed tags, e.g., CODE_UNIT_DOCUMENT, start with a
+      single write of a precomputed literal
 */
 
+#include "OutputSink.hpp"
 #include <string>
 #include <string_view>
 
 class XMLWrapper {
 public:
 
+    // DOCUMENT has the XML declaration and namespace declaration,
+    // FRAGMENT is nested in an element that declares the namespace
+    enum Scope { DOCUMENT, FRAGMENT };
+
+    // start of an element up to its attributes, with any XML declaration and
+    // namespace declaration, and its end tag, as precomputed literals
+    struct Tags {
+        std::string_view start;
+        std::string_view end;
+    };
+
     /*
         constructor
 
@@ -21,6 +39,30 @@ public:
     */
     XMLWrapper(std::string_view prefix, std::string_view uri);
 
+    /*
+        constructor for output written to a sink
+
+        Output is passed to the sink as it is generated, and is not
+        available from xml(). The sink is not flushed.
+
+        @param prefix Non-empty namespace prefix
+        @param uri Non-empty namespace URI
+        @param sink Destination of the XML. Must outlive the wrapper.
+        @param scope Whether the element is a document or a nested fragment
+    */
+    XMLWrapper(std::string_view prefix, std::string_view uri, OutputSink& sink, Scope scope = DOCUMENT);
+
+    /*
+        constructor for an element with precomputed tags, written to a sink
+
+        The start of the element is written in a single write, so the element
+        is started, and startElement() is not called. The sink is not flushed.
+
+        @param tags Start and end of the element. Must outlive the wrapper.
+        @param sink Destination of the XML. Must outlive the wrapper.
+    */
+    XMLWrapper(const Tags& tags, OutputSink& sink);
+
     /*
         Start the element
 
@@ -33,7 +75,8 @@ public:
     /*
         Add attribute of the form name="value"
 
-        May be called multiple times.
+        May be called multiple times. The value is escaped, with a value that
+        needs no escaping written whole.
 
         @param name Element name
         @pre Must not be preceded by a call to addContent() or endElement()
@@ -62,13 +105,40 @@ public:
         Accessor for XML
 
         May be called at any point, even before completion.
+        Empty when output is written to a sink.
+    */
+    std::string xml() const&;
+
+    /*
+        Accessor for XML of an expiring wrapper, moved instead of copied
+
+        Empty when output is written to a sink.
     */
-    std::string xml() const;
+    std::string xml() &&;
 
 private:
+
+    // append to the output
+    void write(std::string_view data);
+
     std::string localName;
     std::string nsPrefix;
     std::string nsUri;
+    std::string_view endTag;    // precomputed end tag, empty for none
     std::string text;
+    OutputSink* sink = nullptr;
+    Scope scope = DOCUMENT;
     enum { ROOT, STARTTAG, CONTENT, COMPLETED } state = ROOT;
 };
+
+// XML declaration of a document
+constexpr std::string_view XML_DECLARATION = R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>)" "\n";
+
+// unit element of the code namespace, as a document with the namespace declaration
+constexpr XMLWrapper::Tags CODE_UNIT_DOCUMENT = {
+    R"(<?xml version="1.0" encoding="UTF-8" standalone="yes"?>)" "\n" R"(<code:unit xmlns:code="http://mlcollard.net/code")",
+    "</code:unit>\n"
+};
+
+// unit element of the code namespace, nested in a unit that declares the namespace
+constexpr XMLWrapper::Tags CODE_UNIT_FRAGMENT = { "<code:unit", "</code:unit>\n" };
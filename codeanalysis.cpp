@@ -0,0 +1,353 @@
+/*
+  @file codeanalysis.cpp
+
+  Command-line tool that generates source analysis XML for source files,
+  directories, tar archives, and stdin
+*/
+
+#include "AnalysisPipeline.hpp"
+#include "AnalysisServer.hpp"
+#include "CodeAnalysis.hpp"
+#include "Metrics.hpp"
+#include "ResultCache.hpp"
+#include "ShardedArchive.hpp"
+#include "SourceFile.hpp"
+#include "TreeWatcher.hpp"
+#include "XMLWrapper.hpp"
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    const char* const USAGE = R"(Usage: codeanalysis [options] <input>...
+
+Generate source analysis XML for source files, directories, tar archives
+(.tar, .tar.gz, .tgz), and stdin (-). A single source file or stdin forms a
+unit. Otherwise, the units are nested in an archive unit.
+
+Options:
+  --language=LANGUAGE   Language of the source code, required for stdin
+  --filename=FILENAME   Filename of the source code
+  --url=URL             URL of the source code
+  --timestamp=TIME      Timestamp of the analysis
+  --hash                Compute the SHA-1 hash of the source code
+  --loc                 Count the lines of source code
+  --output=FILE, -o     Output file, stdout by default
+  --readers=N           Threads reading files, 2 by default
+  --workers=N           Threads analyzing files, the number of cores by default
+  --queue=N             Files in the pipeline at once, 64 by default
+  --cache=DIR           Reuse units of unchanged files from earlier runs,
+                        for inputs that form an archive
+  --cache-prune         With --cache, remove the entries and units of files
+                        that are not among the inputs of this run
+  --format=FORMAT       Output as xml, or as binary units with an index
+  --convert=FILE        Convert the binary units in FILE to XML, without inputs
+  --shards=PREFIX       Output as standalone archives PREFIX-00000.xml, ...,
+                        with an index of the units in PREFIX.index
+  --shard-size=BYTES    Size limit of a shard
+  --shard-units=N       Unit-count limit of a shard
+  --watch               Write the units of a single directory, then, as its
+                        files change, their units and deletions, until
+                        interrupted
+  --serve=SOCKET        Serve requests on a Unix domain socket until
+                        interrupted, with --workers and --cache, without inputs
+  --metrics=FORMAT      Write metrics to stderr as json or prometheus,
+                        for a build with CODEANALYSIS_METRICS
+  --help                Show this message
+)";
+
+    // server or watch stopped by SIGINT and SIGTERM
+    AnalysisServer* runningServer = nullptr;
+    TreeWatcher* runningWatcher = nullptr;
+
+    void stopRunning(int) {
+
+        if (runningServer)
+            runningServer->stop();
+        if (runningWatcher)
+            runningWatcher->stop();
+    }
+
+    // stop on SIGINT and SIGTERM
+    void handleStopSignals() {
+
+        struct sigaction action{};
+        action.sa_handler = stopRunning;
+        ::sigaction(SIGINT, &action, nullptr);
+        ::sigaction(SIGTERM, &action, nullptr);
+    }
+
+    // command-line error
+    struct UsageError {
+        std::string message;
+    };
+
+    // value of an option, from "--option=value" or the next argument
+    std::string optionValue(std::string_view argument, std::string_view option, int& i, int argc, char* argv[]) {
+
+        if (argument.size() > option.size() && argument[option.size()] == '=')
+            return std::string(argument.substr(option.size() + 1));
+        if (i + 1 >= argc)
+            throw UsageError{ "Missing value for " + std::string(option) };
+
+        return argv[++i];
+    }
+
+    // numeric value of an option
+    unsigned int numberValue(const std::string& value, std::string_view option) {
+
+        char* end = nullptr;
+        errno = 0;
+        const unsigned long number = std::strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || errno != 0 || number > 1024 * 1024)
+            throw UsageError{ "Invalid value for " + std::string(option) + ": " + value };
+
+        return static_cast<unsigned int>(number);
+    }
+
+    // numeric value of a size option
+    std::uint64_t sizeValue(const std::string& value, std::string_view option) {
+
+        char* end = nullptr;
+        errno = 0;
+        const unsigned long long number = std::strtoull(value.c_str(), &end, 10);
+        if (value.empty() || value[0] == '-' || *end != '\0' || errno != 0)
+            throw UsageError{ "Invalid value for " + std::string(option) + ": " + value };
+
+        return number;
+    }
+
+    // whether the input is a single unit, instead of an archive
+    bool isSingleUnit(const std::vector<std::string>& inputs) {
+
+        if (inputs.size() != 1)
+            return false;
+        if (inputs[0] == "-")
+            return true;
+
+        const std::string& input = inputs[0];
+        for (const std::string_view suffix : { ".tar", ".tar.gz", ".tgz" })
+            if (input.size() >= suffix.size() && input.compare(input.size() - suffix.size(), suffix.size(), suffix) == 0)
+                return false;
+
+        // missing files are reported as a single unit
+        struct stat status;
+        return ::stat(input.c_str(), &status) != 0 || !S_ISDIR(status.st_mode);
+    }
+
+    // write the unit for a single source file or stdin
+    bool formatSingleUnit(const std::string& input, const AnalysisRequest& defaults, OutputSink& sink) {
+
+        AnalysisRequest request = defaults;
+        request.diskFilename = input;
+
+        // stdin is streamed, unless computed attributes need the whole content first
+        if (input == "-") {
+            request.entryFilename = "data";
+            if (!request.computeHash && !request.computeLOC)
+                return formatAnalysisXMLStream(request, STDIN_FILENO, sink);
+
+            SourceFile file("/dev/stdin");
+            AnalysisRequestView view(request);
+            view.sourceCode = file.content();
+            return formatAnalysisXML(view, sink);
+        }
+
+        SourceFile file(input);
+        AnalysisRequestView view(request);
+        view.sourceCode = file.content();
+
+        return formatAnalysisXML(view, sink);
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    PipelineOptions options;
+    std::string output;
+    std::string metrics;
+    std::string cacheDirectory;
+    std::string convert;
+    std::string shardPrefix;
+    std::string serve;
+    bool watch = false;
+    bool cachePrune = false;
+    std::uint64_t shardBytes = 0;
+    std::size_t shardUnits = 0;
+    std::vector<std::string> inputs;
+    try {
+        for (int i = 1; i < argc; ++i) {
+
+            const std::string_view argument = argv[i];
+            auto matches = [&argument](std::string_view option) {
+                return argument.substr(0, option.size()) == option
+                    && (argument.size() == option.size() || argument[option.size()] == '=');
+            };
+
+            if (argument == "--help" || argument == "-h") {
+                std::cout << USAGE;
+                return 0;
+            } else if (matches("--language")) {
+                options.defaults.optionLanguage = optionValue(argument, "--language", i, argc, argv);
+            } else if (matches("--filename")) {
+                options.defaults.optionFilename = optionValue(argument, "--filename", i, argc, argv);
+            } else if (matches("--url")) {
+                options.defaults.optionURL = optionValue(argument, "--url", i, argc, argv);
+            } else if (matches("--timestamp")) {
+                options.defaults.timestamp = optionValue(argument, "--timestamp", i, argc, argv);
+            } else if (argument == "--hash") {
+                options.defaults.computeHash = true;
+            } else if (argument == "--loc") {
+                options.defaults.computeLOC = true;
+            } else if (matches("--output") || argument == "-o") {
+                output = optionValue(argument, argument == "-o" ? "-o" : "--output", i, argc, argv);
+            } else if (matches("--readers")) {
+                options.readers = numberValue(optionValue(argument, "--readers", i, argc, argv), "--readers");
+            } else if (matches("--workers")) {
+                options.workers = numberValue(optionValue(argument, "--workers", i, argc, argv), "--workers");
+            } else if (matches("--queue")) {
+                options.capacity = numberValue(optionValue(argument, "--queue", i, argc, argv), "--queue");
+            } else if (argument == "--cache-prune") {
+                cachePrune = true;
+            } else if (matches("--cache")) {
+                cacheDirectory = optionValue(argument, "--cache", i, argc, argv);
+            } else if (matches("--format")) {
+                const std::string format = optionValue(argument, "--format", i, argc, argv);
+                if (format != "xml" && format != "binary")
+                    throw UsageError{ "Invalid value for --format: " + format };
+                options.binary = format == "binary";
+            } else if (matches("--convert")) {
+                convert = optionValue(argument, "--convert", i, argc, argv);
+            } else if (matches("--shards")) {
+                shardPrefix = optionValue(argument, "--shards", i, argc, argv);
+            } else if (matches("--shard-size")) {
+                shardBytes = sizeValue(optionValue(argument, "--shard-size", i, argc, argv), "--shard-size");
+            } else if (matches("--shard-units")) {
+                shardUnits = static_cast<std::size_t>(sizeValue(optionValue(argument, "--shard-units", i, argc, argv), "--shard-units"));
+            } else if (argument == "--watch") {
+                watch = true;
+            } else if (matches("--serve")) {
+                serve = optionValue(argument, "--serve", i, argc, argv);
+            } else if (matches("--metrics")) {
+                metrics = optionValue(argument, "--metrics", i, argc, argv);
+                if (metrics != "json" && metrics != "prometheus")
+                    throw UsageError{ "Invalid value for --metrics: " + metrics };
+            } else if (argument.size() > 1 && argument[0] == '-') {
+                throw UsageError{ "Unknown option " + std::string(argument) };
+            } else {
+                inputs.emplace_back(argument);
+            }
+        }
+        if (!serve.empty() && (!inputs.empty() || !convert.empty() || !shardPrefix.empty() || !output.empty()))
+            throw UsageError{ "--serve with inputs, --convert, --shards, or --output" };
+        if (watch && (inputs.size() != 1 || !convert.empty() || !shardPrefix.empty() || !serve.empty() || options.binary))
+            throw UsageError{ "--watch without a single directory, or with --convert, --shards, --serve, or --format=binary" };
+        if (cachePrune && (cacheDirectory.empty() || inputs.empty() || !serve.empty() || watch || options.binary))
+            throw UsageError{ "--cache-prune without --cache or inputs, or with --serve, --watch, or --format=binary" };
+        if (inputs.empty() && convert.empty() && serve.empty())
+            throw UsageError{ "No input" };
+        if (!inputs.empty() && !convert.empty())
+            throw UsageError{ "Inputs with --convert" };
+        if (!shardPrefix.empty() && (!output.empty() || !convert.empty() || options.binary))
+            throw UsageError{ "--shards with --output, --convert, or --format=binary" };
+    } catch (const UsageError& error) {
+        std::cerr << "codeanalysis: " << error.message << '\n' << USAGE;
+        return 2;
+    }
+
+    int fd = STDOUT_FILENO;
+    if (!output.empty()) {
+        fd = ::open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cerr << "codeanalysis: " << output << ": " << std::strerror(errno) << '\n';
+            return 1;
+        }
+    }
+
+    int status = 0;
+    try {
+        std::unique_ptr<ResultCache> cache;
+        if (!cacheDirectory.empty()) {
+            cache = std::make_unique<ResultCache>(cacheDirectory);
+            options.cache = cache.get();
+        }
+
+        FileDescriptorSink sink(fd);
+        if (!serve.empty()) {
+            ServerOptions serverOptions;
+            serverOptions.workers = options.workers;
+            serverOptions.cache = cache.get();
+            AnalysisServer server(serve, serverOptions);
+
+            runningServer = &server;
+            handleStopSignals();
+            server.run();
+            runningServer = nullptr;
+        } else if (watch) {
+            TreeWatcher watcher(inputs[0]);
+            runningWatcher = &watcher;
+            handleStopSignals();
+
+            // the current files, then each batch of changes as soon as it is complete
+            XMLWrapper archive(CODE_UNIT_DOCUMENT, sink);
+            archive.addContent("\n");
+            formatAnalysisChangesXML(watcher.files(), options.defaults, sink, options.workers);
+            sink.flush();
+            while (true) {
+                const std::vector<FileChange> changes = watcher.wait();
+                if (watcher.stopped())
+                    break;
+                formatAnalysisChangesXML(changes, options.defaults, sink, options.workers);
+                sink.flush();
+            }
+            archive.endElement();
+            runningWatcher = nullptr;
+        } else if (!convert.empty()) {
+            const SourceFile binary(convert);
+            formatAnalysisBinaryXML(binary.content(), sink);
+        } else if (!shardPrefix.empty()) {
+            ShardedArchive shards(shardPrefix, shardBytes, shardUnits);
+            runAnalysisPipeline(inputs, options, shards);
+            shards.finish();
+            if (cachePrune)
+                cache->prune();
+        } else if (!options.binary && isSingleUnit(inputs)) {
+            if (!formatSingleUnit(inputs[0], options.defaults, sink))
+                status = 1;
+        } else {
+            runAnalysisPipeline(inputs, options, sink);
+            if (cachePrune)
+                cache->prune();
+        }
+        if (cache)
+            cache->save();
+        sink.flush();
+    } catch (const std::exception& error) {
+        std::cerr << "codeanalysis: " << error.what() << '\n';
+        status = 1;
+    }
+
+    if (metrics == "json")
+        std::cerr << metricsJSON();
+    else if (metrics == "prometheus")
+        std::cerr << metricsPrometheus();
+
+    if (fd != STDOUT_FILENO && ::close(fd) < 0) {
+        std::cerr << "codeanalysis: " << output << ": " << std::strerror(errno) << '\n';
+        status = 1;
+    }
+
+    return status;
+}